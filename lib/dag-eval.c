@@ -0,0 +1,750 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dag-eval.h"
+
+#ifndef likely
+#define likely(x) __builtin_expect(!!(x), 1)
+#endif
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+#define ASSERT_OR_ABORT(x, mex)                                                \
+    if (unlikely(!(x))) {                                                      \
+        fprintf(stderr, "[dag ABORT] " mex "\n");                              \
+        abort();                                                               \
+    }
+
+#define DAG_INITIAL_NODES 256
+#define DAG_UNSUPPORTED 0xffffffffU
+
+static inline uint64_t __mask(uint32_t size)
+{
+    return size >= 64 ? 0xffffffffffffffffUL : (1UL << size) - 1;
+}
+
+static inline int64_t __sext(uint64_t v, uint32_t size)
+{
+    if (size >= 64)
+        return (int64_t)v;
+    uint64_t sign = 1UL << (size - 1);
+    return (int64_t)((v ^ sign) - sign);
+}
+
+// DAG_LOAD of a fixed number N of bytes, that the compiler fully unrolls
+#define DAG_LOAD_N(N)                                                          \
+    static __attribute__((always_inline)) inline uint64_t __load_##N(          \
+        dag_program_t* p, uint32_t* args, uint64_t* inputs)                    \
+    {                                                                          \
+        uint64_t res = 0;                                                      \
+        int      i;                                                            \
+        for (i = 0; i < N; ++i)                                                \
+            res = (res << 8) | (inputs[p->nodes[args[i]].param] & 0xffUL);     \
+        return res;                                                            \
+    }
+
+DAG_LOAD_N(2)
+DAG_LOAD_N(4)
+DAG_LOAD_N(8)
+
+dag_program_t* dag_create(Z3_context ctx, unsigned long n_inputs)
+{
+    dag_program_t* p = (dag_program_t*)malloc(sizeof(dag_program_t));
+    ASSERT_OR_ABORT(p != NULL, "dag_create(): malloc failed");
+
+    p->ctx        = ctx;
+    p->n_inputs   = n_inputs;
+    p->n_nodes    = 0;
+    p->max_nodes  = DAG_INITIAL_NODES;
+    p->nodes      = (dag_node_t*)malloc(sizeof(dag_node_t) * p->max_nodes);
+    p->n_args     = 0;
+    p->max_args   = DAG_INITIAL_NODES * 2;
+    p->args       = (uint32_t*)malloc(sizeof(uint32_t) * p->max_args);
+    p->map_size   = DAG_INITIAL_NODES * 2;
+    p->map_used   = 0;
+    p->map_ids    = (uint32_t*)malloc(sizeof(uint32_t) * p->map_size);
+    p->map_nodes  = (uint32_t*)malloc(sizeof(uint32_t) * p->map_size);
+    p->values     = (uint64_t*)malloc(sizeof(uint64_t) * p->max_nodes);
+    p->stamps     = (uint32_t*)calloc(p->max_nodes, sizeof(uint32_t));
+    p->generation = 0;
+    p->sigs       = (uint64_t*)malloc(sizeof(uint64_t) * p->max_nodes);
+    p->probing    = 0;
+    p->undo       = (dag_undo_t*)malloc(sizeof(dag_undo_t) * p->max_nodes);
+    p->n_undo     = 0;
+    ASSERT_OR_ABORT(p->nodes != NULL && p->args != NULL &&
+                        p->map_ids != NULL && p->map_nodes != NULL &&
+                        p->values != NULL && p->stamps != NULL &&
+                        p->sigs != NULL && p->undo != NULL,
+                    "dag_create(): malloc failed");
+
+    // ast ids are never zero
+    memset(p->map_ids, 0, sizeof(uint32_t) * p->map_size);
+    return p;
+}
+
+void dag_free(dag_program_t* p)
+{
+    free(p->nodes);
+    free(p->args);
+    free(p->map_ids);
+    free(p->map_nodes);
+    free(p->values);
+    free(p->stamps);
+    free(p->sigs);
+    free(p->undo);
+    free(p);
+}
+
+static uint32_t* __map_slot(dag_program_t* p, uint32_t id)
+{
+    uint32_t i = (id * 2654435761U) & (p->map_size - 1);
+    while (p->map_ids[i] != 0 && p->map_ids[i] != id)
+        i = (i + 1) & (p->map_size - 1);
+    return &p->map_ids[i];
+}
+
+static void __map_put(dag_program_t* p, uint32_t id, uint32_t node);
+
+static void __map_grow(dag_program_t* p)
+{
+    uint32_t* old_ids   = p->map_ids;
+    uint32_t* old_nodes = p->map_nodes;
+    uint32_t  old_size  = p->map_size;
+
+    p->map_size *= 2;
+    p->map_used  = 0;
+    p->map_ids   = (uint32_t*)calloc(p->map_size, sizeof(uint32_t));
+    p->map_nodes = (uint32_t*)malloc(sizeof(uint32_t) * p->map_size);
+    ASSERT_OR_ABORT(p->map_ids != NULL && p->map_nodes != NULL,
+                    "__map_grow(): malloc failed");
+
+    uint32_t i;
+    for (i = 0; i < old_size; ++i)
+        if (old_ids[i] != 0)
+            __map_put(p, old_ids[i], old_nodes[i]);
+    free(old_ids);
+    free(old_nodes);
+}
+
+static void __map_put(dag_program_t* p, uint32_t id, uint32_t node)
+{
+    if ((p->map_used + 1) * 2 > p->map_size)
+        __map_grow(p);
+
+    uint32_t* slot = __map_slot(p, id);
+    if (*slot == 0)
+        p->map_used++;
+    *slot                           = id;
+    p->map_nodes[slot - p->map_ids] = node;
+}
+
+static int __map_get(dag_program_t* p, uint32_t id, uint32_t* node)
+{
+    uint32_t* slot = __map_slot(p, id);
+    if (*slot == 0)
+        return 0;
+    *node = p->map_nodes[slot - p->map_ids];
+    return 1;
+}
+
+static uint32_t __new_node(dag_program_t* p, uint32_t op, uint32_t size,
+                           uint32_t n_args, uint64_t param)
+{
+    if (p->n_nodes == p->max_nodes) {
+        p->max_nodes *= 2;
+        p->nodes  = (dag_node_t*)realloc(p->nodes,
+                                        sizeof(dag_node_t) * p->max_nodes);
+        p->values = (uint64_t*)realloc(p->values,
+                                       sizeof(uint64_t) * p->max_nodes);
+        p->stamps = (uint32_t*)realloc(p->stamps,
+                                       sizeof(uint32_t) * p->max_nodes);
+        p->sigs   = (uint64_t*)realloc(p->sigs,
+                                     sizeof(uint64_t) * p->max_nodes);
+        p->undo   = (dag_undo_t*)realloc(p->undo,
+                                       sizeof(dag_undo_t) * p->max_nodes);
+        ASSERT_OR_ABORT(p->nodes != NULL && p->values != NULL &&
+                            p->stamps != NULL && p->sigs != NULL &&
+                            p->undo != NULL,
+                        "__new_node(): realloc failed");
+        memset(p->stamps + p->n_nodes, 0,
+               sizeof(uint32_t) * (p->max_nodes - p->n_nodes));
+    }
+    while (p->n_args + n_args > p->max_args) {
+        p->max_args *= 2;
+        p->args = (uint32_t*)realloc(p->args, sizeof(uint32_t) * p->max_args);
+        ASSERT_OR_ABORT(p->args != NULL, "__new_node(): realloc failed");
+    }
+
+    dag_node_t* n = &p->nodes[p->n_nodes];
+    n->op         = op;
+    n->size       = size;
+    n->n_args     = n_args;
+    n->args       = p->n_args;
+    n->param      = param;
+    p->n_args += n_args;
+    p->sigs[p->n_nodes] = 0;
+    return p->n_nodes++;
+}
+
+static int __translate_op(Z3_decl_kind kind, uint32_t* op)
+{
+    switch (kind) {
+        case Z3_OP_NOT:
+            *op = DAG_NOT;
+            break;
+        case Z3_OP_AND:
+            *op = DAG_AND;
+            break;
+        case Z3_OP_OR:
+            *op = DAG_OR;
+            break;
+        case Z3_OP_XOR:
+            *op = DAG_XOR;
+            break;
+        case Z3_OP_ITE:
+            *op = DAG_ITE;
+            break;
+        case Z3_OP_EQ:
+        case Z3_OP_IFF:
+            *op = DAG_EQ;
+            break;
+        case Z3_OP_DISTINCT:
+            *op = DAG_DISTINCT;
+            break;
+        case Z3_OP_ULT:
+            *op = DAG_ULT;
+            break;
+        case Z3_OP_ULEQ:
+            *op = DAG_ULE;
+            break;
+        case Z3_OP_UGT:
+            *op = DAG_UGT;
+            break;
+        case Z3_OP_UGEQ:
+            *op = DAG_UGE;
+            break;
+        case Z3_OP_SLT:
+            *op = DAG_SLT;
+            break;
+        case Z3_OP_SLEQ:
+            *op = DAG_SLE;
+            break;
+        case Z3_OP_SGT:
+            *op = DAG_SGT;
+            break;
+        case Z3_OP_SGEQ:
+            *op = DAG_SGE;
+            break;
+        case Z3_OP_BADD:
+            *op = DAG_BADD;
+            break;
+        case Z3_OP_BSUB:
+            *op = DAG_BSUB;
+            break;
+        case Z3_OP_BMUL:
+            *op = DAG_BMUL;
+            break;
+        case Z3_OP_BUDIV:
+        case Z3_OP_BUDIV_I:
+            *op = DAG_BUDIV;
+            break;
+        case Z3_OP_BUREM:
+        case Z3_OP_BUREM_I:
+            *op = DAG_BUREM;
+            break;
+        case Z3_OP_BSDIV:
+        case Z3_OP_BSDIV_I:
+            *op = DAG_BSDIV;
+            break;
+        case Z3_OP_BSREM:
+        case Z3_OP_BSREM_I:
+            *op = DAG_BSREM;
+            break;
+        case Z3_OP_BSMOD:
+        case Z3_OP_BSMOD_I:
+            *op = DAG_BSMOD;
+            break;
+        case Z3_OP_BAND:
+            *op = DAG_BAND;
+            break;
+        case Z3_OP_BOR:
+            *op = DAG_BOR;
+            break;
+        case Z3_OP_BXOR:
+            *op = DAG_BXOR;
+            break;
+        case Z3_OP_BNOT:
+            *op = DAG_BNOT;
+            break;
+        case Z3_OP_BNEG:
+            *op = DAG_BNEG;
+            break;
+        case Z3_OP_BSHL:
+            *op = DAG_SHL;
+            break;
+        case Z3_OP_BLSHR:
+            *op = DAG_LSHR;
+            break;
+        case Z3_OP_BASHR:
+            *op = DAG_ASHR;
+            break;
+        case Z3_OP_ROTATE_LEFT:
+            *op = DAG_ROTL;
+            break;
+        case Z3_OP_ROTATE_RIGHT:
+            *op = DAG_ROTR;
+            break;
+        case Z3_OP_EXTRACT:
+            *op = DAG_EXTRACT;
+            break;
+        case Z3_OP_CONCAT:
+            *op = DAG_CONCAT;
+            break;
+        case Z3_OP_ZERO_EXT:
+            *op = DAG_ZEXT;
+            break;
+        case Z3_OP_SIGN_EXT:
+            *op = DAG_SEXT;
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+static uint32_t __compile(dag_program_t* p, Z3_ast e)
+{
+    Z3_context ctx = p->ctx;
+    uint32_t   id  = Z3_get_ast_id(ctx, e);
+    uint32_t   node;
+    if (__map_get(p, id, &node))
+        return node;
+
+    node = DAG_UNSUPPORTED;
+
+    uint32_t size;
+    Z3_sort  sort = Z3_get_sort(ctx, e);
+    switch (Z3_get_sort_kind(ctx, sort)) {
+        case Z3_BOOL_SORT:
+            size = 1;
+            break;
+        case Z3_BV_SORT:
+            size = Z3_get_bv_sort_size(ctx, sort);
+            break;
+        default:
+            size = 0;
+            break;
+    }
+    if (size == 0 || size > 64)
+        goto OUT;
+
+    switch (Z3_get_ast_kind(ctx, e)) {
+        case Z3_NUMERAL_AST: {
+            uint64_t v;
+            if (Z3_get_numeral_uint64(ctx, e, &v))
+                node = __new_node(p, DAG_CONST, size, 0, v);
+            goto OUT;
+        }
+        case Z3_APP_AST:
+            break;
+        default:
+            goto OUT;
+    }
+
+    Z3_app       app    = Z3_to_app(ctx, e);
+    Z3_func_decl decl   = Z3_get_app_decl(ctx, app);
+    Z3_decl_kind kind   = Z3_get_decl_kind(ctx, decl);
+    unsigned     n_args = Z3_get_app_num_args(ctx, app);
+
+    uint64_t param = 0;
+    uint32_t op;
+    switch (kind) {
+        case Z3_OP_TRUE:
+        case Z3_OP_FALSE:
+            node = __new_node(p, DAG_CONST, size, 0, kind == Z3_OP_TRUE);
+            goto OUT;
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s = Z3_get_decl_name(ctx, decl);
+            if (n_args != 0 || Z3_get_symbol_kind(ctx, s) != Z3_INT_SYMBOL)
+                goto OUT;
+            int idx = Z3_get_symbol_int(ctx, s);
+            if (idx < 0 || (unsigned long)idx >= p->n_inputs)
+                goto OUT;
+            node          = __new_node(p, DAG_INPUT, size, 0, (uint64_t)idx);
+            p->sigs[node] = 1UL << (idx % 64);
+            goto OUT;
+        }
+        case Z3_OP_EXTRACT:
+            param = Z3_get_decl_int_parameter(ctx, decl, 1);
+            break;
+        case Z3_OP_ROTATE_LEFT:
+        case Z3_OP_ROTATE_RIGHT:
+            param = Z3_get_decl_int_parameter(ctx, decl, 0) % size;
+            break;
+        default:
+            break;
+    }
+    if (n_args == 0 || !__translate_op(kind, &op))
+        goto OUT;
+
+    // compile the arguments before allocating the node, so that they are
+    // contiguous in p->args
+    uint32_t  i;
+    uint32_t* args = (uint32_t*)malloc(sizeof(uint32_t) * n_args);
+    ASSERT_OR_ABORT(args != NULL, "__compile(): malloc failed");
+    for (i = 0; i < n_args; ++i) {
+        args[i] = __compile(p, Z3_get_app_arg(ctx, app, i));
+        if (args[i] == DAG_UNSUPPORTED) {
+            free(args);
+            goto OUT;
+        }
+    }
+    if (op == DAG_CONCAT) {
+        // bytes of the input, as in (concat k!3 (concat k!2 ...)): load them
+        // with a single node instead of walking the chain of concats
+        uint32_t bytes[8], n_bytes = 0, j;
+        for (i = 0; i < n_args; ++i) {
+            dag_node_t* a = &p->nodes[args[i]];
+            if (a->op == DAG_INPUT && a->size == 8)
+                bytes[n_bytes++] = args[i];
+            else if (a->op == DAG_LOAD)
+                for (j = 0; j < a->n_args; ++j)
+                    bytes[n_bytes++] = p->args[a->args + j];
+            else
+                break;
+        }
+        if (i == n_args) {
+            op     = DAG_LOAD;
+            n_args = n_bytes;
+            args   = (uint32_t*)realloc(args, sizeof(uint32_t) * n_bytes);
+            ASSERT_OR_ABORT(args != NULL, "__compile(): realloc failed");
+            memcpy(args, bytes, sizeof(uint32_t) * n_bytes);
+        }
+    }
+    node = __new_node(p, op, size, n_args, param);
+    memcpy(&p->args[p->nodes[node].args], args, sizeof(uint32_t) * n_args);
+    for (i = 0; i < n_args; ++i)
+        p->sigs[node] |= p->sigs[args[i]];
+    free(args);
+
+OUT:
+    __map_put(p, id, node);
+    return node;
+}
+
+int dag_add_root(dag_program_t* p, Z3_ast e)
+{
+    uint32_t node = __compile(p, e);
+    return node == DAG_UNSUPPORTED ? -1 : (int)node;
+}
+
+static uint64_t __eval(dag_program_t* p, uint32_t n, uint64_t* inputs)
+{
+    if (p->stamps[n] == p->generation)
+        return p->values[n];
+    if (unlikely(p->probing) && p->stamps[n] == p->base_generation &&
+        !(p->sigs[n] & p->dirty_sig))
+        return p->values[n];
+
+    dag_node_t* node = &p->nodes[n];
+    uint32_t*   args = &p->args[node->args];
+    uint32_t    size = node->size;
+    uint64_t    mask = __mask(size);
+    uint64_t    res, a, b;
+    uint32_t    i, j;
+
+    switch (node->op) {
+        case DAG_CONST:
+            res = node->param;
+            break;
+        case DAG_INPUT:
+            res = inputs[node->param] & mask;
+            break;
+        case DAG_NOT:
+            res = !__eval(p, args[0], inputs);
+            break;
+        case DAG_AND:
+            res = 1;
+            for (i = 0; i < node->n_args && res; ++i)
+                res = __eval(p, args[i], inputs);
+            break;
+        case DAG_OR:
+            res = 0;
+            for (i = 0; i < node->n_args && !res; ++i)
+                res = __eval(p, args[i], inputs);
+            break;
+        case DAG_XOR:
+            res = 0;
+            for (i = 0; i < node->n_args; ++i)
+                res ^= __eval(p, args[i], inputs);
+            break;
+        case DAG_ITE:
+            res = __eval(p, args[0], inputs) ? __eval(p, args[1], inputs)
+                                             : __eval(p, args[2], inputs);
+            break;
+        case DAG_EQ:
+            a   = __eval(p, args[0], inputs);
+            res = 1;
+            for (i = 1; i < node->n_args && res; ++i)
+                res = __eval(p, args[i], inputs) == a;
+            break;
+        case DAG_DISTINCT:
+            res = 1;
+            for (i = 0; i < node->n_args && res; ++i) {
+                a = __eval(p, args[i], inputs);
+                for (j = i + 1; j < node->n_args && res; ++j)
+                    res = __eval(p, args[j], inputs) != a;
+            }
+            break;
+        case DAG_ULT:
+            res = __eval(p, args[0], inputs) < __eval(p, args[1], inputs);
+            break;
+        case DAG_ULE:
+            res = __eval(p, args[0], inputs) <= __eval(p, args[1], inputs);
+            break;
+        case DAG_UGT:
+            res = __eval(p, args[0], inputs) > __eval(p, args[1], inputs);
+            break;
+        case DAG_UGE:
+            res = __eval(p, args[0], inputs) >= __eval(p, args[1], inputs);
+            break;
+        case DAG_SLT:
+        case DAG_SLE:
+        case DAG_SGT:
+        case DAG_SGE: {
+            uint32_t s  = p->nodes[args[0]].size;
+            int64_t  sa = __sext(__eval(p, args[0], inputs), s);
+            int64_t  sb = __sext(__eval(p, args[1], inputs), s);
+            res         = node->op == DAG_SLT   ? sa < sb
+                          : node->op == DAG_SLE ? sa <= sb
+                          : node->op == DAG_SGT ? sa > sb
+                                                : sa >= sb;
+            break;
+        }
+        case DAG_BADD:
+            res = 0;
+            for (i = 0; i < node->n_args; ++i)
+                res += __eval(p, args[i], inputs);
+            res &= mask;
+            break;
+        case DAG_BSUB:
+            res = __eval(p, args[0], inputs);
+            for (i = 1; i < node->n_args; ++i)
+                res -= __eval(p, args[i], inputs);
+            res &= mask;
+            break;
+        case DAG_BMUL:
+            res = 1;
+            for (i = 0; i < node->n_args; ++i)
+                res *= __eval(p, args[i], inputs);
+            res &= mask;
+            break;
+        case DAG_BUDIV:
+            a   = __eval(p, args[0], inputs);
+            b   = __eval(p, args[1], inputs);
+            res = b == 0 ? mask : a / b;
+            break;
+        case DAG_BUREM:
+            a   = __eval(p, args[0], inputs);
+            b   = __eval(p, args[1], inputs);
+            res = b == 0 ? a : a % b;
+            break;
+        case DAG_BSDIV:
+        case DAG_BSREM:
+        case DAG_BSMOD: {
+            int64_t sa = __sext(__eval(p, args[0], inputs), size);
+            int64_t sb = __sext(__eval(p, args[1], inputs), size);
+            if (sb == 0) {
+                // same semantics of Z3 for division by zero
+                res = node->op == DAG_BSDIV ? (sa < 0 ? 1 : mask)
+                                            : (uint64_t)sa & mask;
+                break;
+            }
+            if (sb == -1) {
+                // avoid the overflow of INT64_MIN / -1
+                res = node->op == DAG_BSDIV ? (uint64_t)(-(uint64_t)sa) & mask
+                                            : 0;
+                break;
+            }
+            int64_t r;
+            if (node->op == DAG_BSDIV)
+                r = sa / sb;
+            else {
+                r = sa % sb;
+                if (node->op == DAG_BSMOD && r != 0 && ((r < 0) != (sb < 0)))
+                    r += sb;
+            }
+            res = (uint64_t)r & mask;
+            break;
+        }
+        case DAG_BAND:
+            res = mask;
+            for (i = 0; i < node->n_args; ++i)
+                res &= __eval(p, args[i], inputs);
+            break;
+        case DAG_BOR:
+            res = 0;
+            for (i = 0; i < node->n_args; ++i)
+                res |= __eval(p, args[i], inputs);
+            break;
+        case DAG_BXOR:
+            res = 0;
+            for (i = 0; i < node->n_args; ++i)
+                res ^= __eval(p, args[i], inputs);
+            break;
+        case DAG_BNOT:
+            res = ~__eval(p, args[0], inputs) & mask;
+            break;
+        case DAG_BNEG:
+            res = -__eval(p, args[0], inputs) & mask;
+            break;
+        case DAG_SHL:
+            a   = __eval(p, args[0], inputs);
+            b   = __eval(p, args[1], inputs);
+            res = b >= size ? 0 : (a << b) & mask;
+            break;
+        case DAG_LSHR:
+            a   = __eval(p, args[0], inputs);
+            b   = __eval(p, args[1], inputs);
+            res = b >= size ? 0 : a >> b;
+            break;
+        case DAG_ASHR: {
+            int64_t sa = __sext(__eval(p, args[0], inputs), size);
+            b          = __eval(p, args[1], inputs);
+            res        = (uint64_t)(sa >> (b >= size ? size - 1 : b)) & mask;
+            break;
+        }
+        case DAG_ROTL:
+        case DAG_ROTR: {
+            uint64_t r = node->op == DAG_ROTL ? node->param
+                                              : (size - node->param) % size;
+            a          = __eval(p, args[0], inputs);
+            res        = r == 0 ? a : ((a << r) | (a >> (size - r))) & mask;
+            break;
+        }
+        case DAG_EXTRACT:
+            res = (__eval(p, args[0], inputs) >> node->param) & mask;
+            break;
+        case DAG_CONCAT:
+            res = 0;
+            for (i = 0; i < node->n_args; ++i) {
+                uint32_t s = p->nodes[args[i]].size;
+                res = (s >= 64 ? 0 : res << s) | __eval(p, args[i], inputs);
+            }
+            break;
+        case DAG_LOAD:
+            switch (node->n_args) {
+                case 2:
+                    res = __load_2(p, args, inputs);
+                    break;
+                case 4:
+                    res = __load_4(p, args, inputs);
+                    break;
+                case 8:
+                    res = __load_8(p, args, inputs);
+                    break;
+                default:
+                    res = 0;
+                    for (i = 0; i < node->n_args; ++i)
+                        res = (res << 8) |
+                              (inputs[p->nodes[args[i]].param] & 0xffUL);
+                    break;
+            }
+            break;
+        case DAG_ZEXT:
+            res = __eval(p, args[0], inputs);
+            break;
+        case DAG_SEXT:
+            res = (uint64_t)__sext(__eval(p, args[0], inputs),
+                                   p->nodes[args[0]].size) &
+                  mask;
+            break;
+        default:
+            ASSERT_OR_ABORT(0, "__eval(): unknown op");
+    }
+
+    if (unlikely(p->probing)) {
+        if (!(p->sigs[n] & p->dirty_sig)) {
+            // same value on the base inputs
+            p->stamps[n] = p->base_generation;
+            p->values[n] = res;
+            return res;
+        }
+        dag_undo_t* u = &p->undo[p->n_undo++];
+        u->node       = n;
+        u->stamp      = p->stamps[n];
+        u->value      = p->values[n];
+    }
+    p->stamps[n] = p->generation;
+    p->values[n] = res;
+    return res;
+}
+
+static inline void __next_generation(dag_program_t* p)
+{
+    if (unlikely(++p->generation == 0)) {
+        memset(p->stamps, 0, sizeof(uint32_t) * p->max_nodes);
+        p->generation = 1;
+        if (p->probing) {
+            // the values of the base inputs are lost, start over
+            p->base_generation = 1;
+            p->generation      = 2;
+        }
+    }
+}
+
+uint64_t dag_eval(dag_program_t* p, int root, uint64_t* inputs,
+                  uint32_t* depth)
+{
+    ASSERT_OR_ABORT(!p->probing, "dag_eval(): called while probing");
+    __next_generation(p);
+
+    dag_node_t* node = &p->nodes[root];
+    if (depth == NULL)
+        return __eval(p, (uint32_t)root, inputs);
+    if (node->op != DAG_AND) {
+        uint64_t res = __eval(p, (uint32_t)root, inputs);
+        *depth       = res != 0;
+        return res;
+    }
+
+    // same walk of __eval, but keep track of how many conjuncts are true
+    uint32_t* args = &p->args[node->args];
+    uint32_t  i;
+    for (i = 0; i < node->n_args; ++i)
+        if (!__eval(p, args[i], inputs))
+            break;
+    *depth = i;
+    return i == node->n_args;
+}
+
+void dag_probe_begin(dag_program_t* p)
+{
+    // the values of the base inputs are computed lazily by the probes
+    p->probing = 1;
+    __next_generation(p);
+    p->base_generation = p->generation;
+    p->n_undo          = 0;
+}
+
+uint64_t dag_eval_probe(dag_program_t* p, int root, uint64_t* inputs,
+                        uint32_t* changed, uint32_t n_changed)
+{
+    uint32_t i;
+    __next_generation(p);
+    p->dirty_sig = 0;
+    for (i = 0; i < n_changed; ++i)
+        p->dirty_sig |= 1UL << (changed[i] % 64);
+
+    uint64_t res = __eval(p, (uint32_t)root, inputs);
+
+    while (p->n_undo > 0) {
+        dag_undo_t* u      = &p->undo[--p->n_undo];
+        p->stamps[u->node] = u->stamp;
+        p->values[u->node] = u->value;
+    }
+    return res;
+}
+
+void dag_probe_end(dag_program_t* p) { p->probing = 0; }
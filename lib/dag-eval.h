@@ -0,0 +1,123 @@
+#ifndef DAG_EVAL_H
+#define DAG_EVAL_H
+
+#include <stdint.h>
+#include <z3.h>
+
+// bitvector (<= 64 bits) and boolean expressions flattened in an array of
+// nodes, with a dense id for each node of the DAG. Booleans are 0/1
+typedef enum dag_op_t {
+    DAG_CONST,
+    DAG_INPUT, // param: index of the input
+    DAG_NOT,
+    DAG_AND,
+    DAG_OR,
+    DAG_XOR,
+    DAG_ITE,
+    DAG_EQ,
+    DAG_DISTINCT,
+    DAG_ULT,
+    DAG_ULE,
+    DAG_UGT,
+    DAG_UGE,
+    DAG_SLT,
+    DAG_SLE,
+    DAG_SGT,
+    DAG_SGE,
+    DAG_BADD,
+    DAG_BSUB,
+    DAG_BMUL,
+    DAG_BUDIV,
+    DAG_BUREM,
+    DAG_BSDIV,
+    DAG_BSREM,
+    DAG_BSMOD,
+    DAG_BAND,
+    DAG_BOR,
+    DAG_BXOR,
+    DAG_BNOT,
+    DAG_BNEG,
+    DAG_SHL,
+    DAG_LSHR,
+    DAG_ASHR,
+    DAG_ROTL,    // param: rotation
+    DAG_ROTR,    // param: rotation
+    DAG_EXTRACT, // param: low bit
+    DAG_CONCAT,
+    DAG_ZEXT,
+    DAG_SEXT,
+    DAG_LOAD // concat of 8-bit inputs (the args), the first is the MSB
+} dag_op_t;
+
+typedef struct dag_node_t {
+    uint32_t op;
+    uint32_t size;   // size in bits of the result
+    uint32_t n_args;
+    uint32_t args;   // first argument in dag_program_t.args
+    uint64_t param;
+} dag_node_t;
+
+// a value overwritten by a probe, see dag_eval_probe()
+typedef struct dag_undo_t {
+    uint32_t node;
+    uint32_t stamp;
+    uint64_t value;
+} dag_undo_t;
+
+typedef struct dag_program_t {
+    Z3_context    ctx;
+    unsigned long n_inputs;
+
+    dag_node_t* nodes;
+    uint32_t    n_nodes, max_nodes;
+    uint32_t*   args;
+    uint32_t    n_args, max_args;
+
+    // Z3 ast id -> node, open addressing
+    uint32_t* map_ids;
+    uint32_t* map_nodes;
+    uint32_t  map_size, map_used;
+
+    // memo of the current evaluation: a value is valid if its stamp is equal
+    // to the generation, that is incremented by every dag_eval
+    uint64_t* values;
+    uint32_t* stamps;
+    uint32_t  generation;
+
+    // bit i % 64 of the signature of a node is set if it depends on input i
+    uint64_t* sigs;
+
+    // probes: the values stamped with base_generation are the ones of the
+    // inputs passed to dag_probe_begin(). A probe reuses them for the nodes
+    // whose signature does not meet dirty_sig, the values it overwrites are
+    // restored from undo when it ends
+    int         probing;
+    uint32_t    base_generation;
+    uint64_t    dirty_sig;
+    dag_undo_t* undo;
+    uint32_t    n_undo;
+} dag_program_t;
+
+dag_program_t* dag_create(Z3_context ctx, unsigned long n_inputs);
+void           dag_free(dag_program_t* p);
+
+// compile e, returns its node or -1 if e contains something unsupported
+// (sizes over 64 bits, non-input symbols, arrays, ...)
+int dag_add_root(dag_program_t* p, Z3_ast e);
+
+// evaluate a root on inputs. If depth is not NULL and the root is an AND, it
+// is set to the number of arguments that are true before the first false one
+uint64_t dag_eval(dag_program_t* p, int root, uint64_t* inputs,
+                  uint32_t* depth);
+
+// batched evaluation of inputs that differ from a base one in a few bytes
+// (e.g., the probes of a gradient). dag_eval_probe() evaluates a root on
+// inputs, that must be equal to the ones passed to dag_probe_begin() but at
+// the n_changed indexes in changed: only the nodes that depend on them are
+// recomputed. dag_eval() cannot be called before dag_probe_end()
+void     dag_probe_begin(dag_program_t* p);
+uint64_t dag_eval_probe(dag_program_t* p, int root, uint64_t* inputs,
+                        uint32_t* changed, uint32_t n_changed);
+void     dag_probe_end(dag_program_t* p);
+
+#endif
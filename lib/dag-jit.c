@@ -0,0 +1,376 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dag-jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+#ifndef likely
+#define likely(x) __builtin_expect(!!(x), 1)
+#endif
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+#define ASSERT_OR_ABORT(x, mex)                                                \
+    if (unlikely(!(x))) {                                                      \
+        fprintf(stderr, "[jit ABORT] " mex "\n");                              \
+        abort();                                                               \
+    }
+
+// the code is preceded by its mapping size, used by dag_jit_free
+#define JIT_HEADER_SIZE 16
+
+// register numbers in the encodings
+#define RAX 0
+#define RCX 1
+#define RDX 2
+
+typedef struct code_buf_t {
+    uint8_t* data;
+    size_t   size;
+    size_t   max_size;
+} code_buf_t;
+
+static void __emit(code_buf_t* b, const uint8_t* bytes, size_t n)
+{
+    if (b->size + n > b->max_size) {
+        while (b->size + n > b->max_size)
+            b->max_size *= 2;
+        b->data = (uint8_t*)realloc(b->data, b->max_size);
+        ASSERT_OR_ABORT(b->data != NULL, "__emit(): realloc failed");
+    }
+    memcpy(b->data + b->size, bytes, n);
+    b->size += n;
+}
+
+#define EMIT(b, ...)                                                           \
+    do {                                                                       \
+        const uint8_t __bytes[] = {__VA_ARGS__};                               \
+        __emit(b, __bytes, sizeof(__bytes));                                   \
+    } while (0)
+
+static void __emit_u32(code_buf_t* b, uint32_t v)
+{
+    __emit(b, (uint8_t*)&v, sizeof(v));
+}
+
+static void __emit_u64(code_buf_t* b, uint64_t v)
+{
+    __emit(b, (uint8_t*)&v, sizeof(v));
+}
+
+// mov reg, [rsi + 8 * node]
+static void __load_slot(code_buf_t* b, int reg, uint32_t node)
+{
+    EMIT(b, 0x48, 0x8b, 0x86 | (reg << 3));
+    __emit_u32(b, node * 8);
+}
+
+// mov [rsi + 8 * node], rax
+static void __store_slot(code_buf_t* b, uint32_t node)
+{
+    EMIT(b, 0x48, 0x89, 0x86);
+    __emit_u32(b, node * 8);
+}
+
+// mov reg, imm64
+static void __load_imm(code_buf_t* b, int reg, uint64_t v)
+{
+    EMIT(b, 0x48, 0xb8 | reg);
+    __emit_u64(b, v);
+}
+
+static void __mask_rax(code_buf_t* b, uint32_t size)
+{
+    if (size >= 64)
+        return;
+    if (size == 32) {
+        EMIT(b, 0x89, 0xc0); // mov eax, eax
+        return;
+    }
+    __load_imm(b, RCX, (1UL << size) - 1);
+    EMIT(b, 0x48, 0x21, 0xc8); // and rax, rcx
+}
+
+// sign extend reg (rax or rcx) from size to 64 bits
+static void __sext_reg(code_buf_t* b, int reg, uint32_t size)
+{
+    if (size >= 64)
+        return;
+    EMIT(b, 0x48, 0xc1, 0xe0 | reg, 64 - size); // shl reg, 64 - size
+    EMIT(b, 0x48, 0xc1, 0xf8 | reg, 64 - size); // sar reg, 64 - size
+}
+
+// cmp rax, rcx; setcc al; movzx eax, al
+static void __emit_cmp(code_buf_t* b, uint8_t setcc)
+{
+    EMIT(b, 0x48, 0x39, 0xc8, 0x0f, setcc, 0xc0, 0x0f, 0xb6, 0xc0);
+}
+
+static int __supported(dag_node_t* n)
+{
+    switch (n->op) {
+        case DAG_BUDIV:
+        case DAG_BUREM:
+        case DAG_BSDIV:
+        case DAG_BSREM:
+        case DAG_BSMOD:
+            return 0;
+        case DAG_EQ:
+        case DAG_DISTINCT:
+            return n->n_args == 2;
+        default:
+            return 1;
+    }
+}
+
+static void __emit_node(code_buf_t* b, dag_program_t* p, uint32_t id)
+{
+    dag_node_t* n    = &p->nodes[id];
+    uint32_t*   args = &p->args[n->args];
+    uint32_t    i;
+
+    switch (n->op) {
+        case DAG_CONST:
+            __load_imm(b, RAX, n->param);
+            break;
+        case DAG_INPUT:
+            // mov rax, [rdi + 8 * idx]
+            EMIT(b, 0x48, 0x8b, 0x87);
+            __emit_u32(b, (uint32_t)n->param * 8);
+            __mask_rax(b, n->size);
+            break;
+        case DAG_NOT:
+            __load_slot(b, RAX, args[0]);
+            EMIT(b, 0x48, 0x83, 0xf0, 0x01); // xor rax, 1
+            break;
+        case DAG_AND:
+        case DAG_OR:
+        case DAG_XOR:
+        case DAG_BAND:
+        case DAG_BOR:
+        case DAG_BXOR:
+        case DAG_BADD:
+        case DAG_BSUB:
+        case DAG_BMUL:
+            __load_slot(b, RAX, args[0]);
+            for (i = 1; i < n->n_args; ++i) {
+                __load_slot(b, RCX, args[i]);
+                switch (n->op) {
+                    case DAG_AND:
+                    case DAG_BAND:
+                        EMIT(b, 0x48, 0x21, 0xc8); // and rax, rcx
+                        break;
+                    case DAG_OR:
+                    case DAG_BOR:
+                        EMIT(b, 0x48, 0x09, 0xc8); // or rax, rcx
+                        break;
+                    case DAG_XOR:
+                    case DAG_BXOR:
+                        EMIT(b, 0x48, 0x31, 0xc8); // xor rax, rcx
+                        break;
+                    case DAG_BADD:
+                        EMIT(b, 0x48, 0x01, 0xc8); // add rax, rcx
+                        break;
+                    case DAG_BSUB:
+                        EMIT(b, 0x48, 0x29, 0xc8); // sub rax, rcx
+                        break;
+                    default:
+                        EMIT(b, 0x48, 0x0f, 0xaf, 0xc1); // imul rax, rcx
+                        break;
+                }
+            }
+            __mask_rax(b, n->size);
+            break;
+        case DAG_ITE:
+            __load_slot(b, RAX, args[1]);
+            __load_slot(b, RCX, args[2]);
+            __load_slot(b, RDX, args[0]);
+            EMIT(b, 0x48, 0x85, 0xd2);       // test rdx, rdx
+            EMIT(b, 0x48, 0x0f, 0x44, 0xc1); // cmove rax, rcx
+            break;
+        case DAG_EQ:
+        case DAG_DISTINCT:
+        case DAG_ULT:
+        case DAG_ULE:
+        case DAG_UGT:
+        case DAG_UGE:
+            __load_slot(b, RAX, args[0]);
+            __load_slot(b, RCX, args[1]);
+            __emit_cmp(b, n->op == DAG_EQ         ? 0x94   // sete
+                          : n->op == DAG_DISTINCT ? 0x95   // setne
+                          : n->op == DAG_ULT      ? 0x92   // setb
+                          : n->op == DAG_ULE      ? 0x96   // setbe
+                          : n->op == DAG_UGT      ? 0x97   // seta
+                                                  : 0x93); // setae
+            break;
+        case DAG_SLT:
+        case DAG_SLE:
+        case DAG_SGT:
+        case DAG_SGE:
+            __load_slot(b, RAX, args[0]);
+            __load_slot(b, RCX, args[1]);
+            __sext_reg(b, RAX, p->nodes[args[0]].size);
+            __sext_reg(b, RCX, p->nodes[args[0]].size);
+            __emit_cmp(b, n->op == DAG_SLT   ? 0x9c   // setl
+                          : n->op == DAG_SLE ? 0x9e   // setle
+                          : n->op == DAG_SGT ? 0x9f   // setg
+                                             : 0x9d); // setge
+            break;
+        case DAG_BNOT:
+            __load_slot(b, RAX, args[0]);
+            EMIT(b, 0x48, 0xf7, 0xd0); // not rax
+            __mask_rax(b, n->size);
+            break;
+        case DAG_BNEG:
+            __load_slot(b, RAX, args[0]);
+            EMIT(b, 0x48, 0xf7, 0xd8); // neg rax
+            __mask_rax(b, n->size);
+            break;
+        case DAG_SHL:
+        case DAG_LSHR:
+            __load_slot(b, RAX, args[0]);
+            __load_slot(b, RCX, args[1]);
+            // shl/shr rax, cl; xor edx, edx; cmp rcx, size
+            EMIT(b, 0x48, 0xd3, n->op == DAG_SHL ? 0xe0 : 0xe8);
+            EMIT(b, 0x31, 0xd2);
+            EMIT(b, 0x48, 0x81, 0xf9);
+            __emit_u32(b, n->size);
+            EMIT(b, 0x48, 0x0f, 0x43, 0xc2); // cmovae rax, rdx
+            __mask_rax(b, n->size);
+            break;
+        case DAG_ASHR:
+            __load_slot(b, RAX, args[0]);
+            __load_slot(b, RCX, args[1]);
+            __sext_reg(b, RAX, n->size);
+            EMIT(b, 0x48, 0xc7, 0xc2); // mov rdx, size - 1
+            __emit_u32(b, n->size - 1);
+            EMIT(b, 0x48, 0x81, 0xf9); // cmp rcx, size
+            __emit_u32(b, n->size);
+            EMIT(b, 0x48, 0x0f, 0x43, 0xca); // cmovae rcx, rdx
+            EMIT(b, 0x48, 0xd3, 0xf8);       // sar rax, cl
+            __mask_rax(b, n->size);
+            break;
+        case DAG_ROTL:
+        case DAG_ROTR: {
+            uint32_t r = n->op == DAG_ROTL ? (uint32_t)n->param
+                                           : (n->size - (uint32_t)n->param) %
+                                                 n->size;
+            __load_slot(b, RAX, args[0]);
+            if (r == 0)
+                break;
+            EMIT(b, 0x48, 0x89, 0xc1);              // mov rcx, rax
+            EMIT(b, 0x48, 0xc1, 0xe0, r);           // shl rax, r
+            EMIT(b, 0x48, 0xc1, 0xe9, n->size - r); // shr rcx, size - r
+            EMIT(b, 0x48, 0x09, 0xc8);              // or rax, rcx
+            __mask_rax(b, n->size);
+            break;
+        }
+        case DAG_EXTRACT:
+            __load_slot(b, RAX, args[0]);
+            if (n->param > 0)
+                EMIT(b, 0x48, 0xc1, 0xe8, (uint8_t)n->param); // shr rax, lo
+            __mask_rax(b, n->size);
+            break;
+        case DAG_CONCAT:
+            __load_slot(b, RAX, args[0]);
+            for (i = 1; i < n->n_args; ++i) {
+                // shl rax, size of the next argument
+                EMIT(b, 0x48, 0xc1, 0xe0, p->nodes[args[i]].size);
+                __load_slot(b, RCX, args[i]);
+                EMIT(b, 0x48, 0x09, 0xc8); // or rax, rcx
+            }
+            break;
+        case DAG_LOAD:
+            // movzx eax, byte [rdi + 8 * idx]
+            EMIT(b, 0x0f, 0xb6, 0x87);
+            __emit_u32(b, (uint32_t)p->nodes[args[0]].param * 8);
+            for (i = 1; i < n->n_args; ++i) {
+                EMIT(b, 0x48, 0xc1, 0xe0, 8); // shl rax, 8
+                // movzx ecx, byte [rdi + 8 * idx]
+                EMIT(b, 0x0f, 0xb6, 0x8f);
+                __emit_u32(b, (uint32_t)p->nodes[args[i]].param * 8);
+                EMIT(b, 0x48, 0x09, 0xc8); // or rax, rcx
+            }
+            break;
+        case DAG_ZEXT:
+            __load_slot(b, RAX, args[0]);
+            break;
+        case DAG_SEXT:
+            __load_slot(b, RAX, args[0]);
+            __sext_reg(b, RAX, p->nodes[args[0]].size);
+            __mask_rax(b, n->size);
+            break;
+        default:
+            ASSERT_OR_ABORT(0, "__emit_node(): unknown op");
+    }
+    __store_slot(b, id);
+}
+
+dag_jit_fn_t dag_jit_compile(dag_program_t* p, int root)
+{
+    // the arguments of a node always have a smaller id: mark the nodes
+    // reachable from root walking the ids backwards
+    uint8_t* reachable = (uint8_t*)calloc(root + 1, 1);
+    ASSERT_OR_ABORT(reachable != NULL, "dag_jit_compile(): calloc failed");
+
+    int      i;
+    uint32_t j;
+    reachable[root] = 1;
+    for (i = root; i >= 0; --i) {
+        if (!reachable[i])
+            continue;
+        dag_node_t* n = &p->nodes[i];
+        if (!__supported(n)) {
+            free(reachable);
+            return NULL;
+        }
+        for (j = 0; j < n->n_args; ++j)
+            reachable[p->args[n->args + j]] = 1;
+    }
+
+    code_buf_t b;
+    b.size     = 0;
+    b.max_size = 4096;
+    b.data     = (uint8_t*)malloc(b.max_size);
+    ASSERT_OR_ABORT(b.data != NULL, "dag_jit_compile(): malloc failed");
+
+    for (i = 0; i <= root; ++i)
+        if (reachable[i])
+            __emit_node(&b, p, (uint32_t)i);
+    EMIT(&b, 0xc3); // ret, the value of root is still in rax
+    free(reachable);
+
+    size_t   map_size = (JIT_HEADER_SIZE + b.size + 4095) & ~4095UL;
+    uint8_t* page     = (uint8_t*)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        free(b.data);
+        return NULL;
+    }
+    *(size_t*)page = map_size;
+    memcpy(page + JIT_HEADER_SIZE, b.data, b.size);
+    free(b.data);
+    if (mprotect(page, map_size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(page, map_size);
+        return NULL;
+    }
+    return (dag_jit_fn_t)(page + JIT_HEADER_SIZE);
+}
+
+void dag_jit_free(dag_jit_fn_t fn)
+{
+    uint8_t* page = (uint8_t*)fn - JIT_HEADER_SIZE;
+    munmap(page, *(size_t*)page);
+}
+
+#else
+
+dag_jit_fn_t dag_jit_compile(dag_program_t* p, int root) { return NULL; }
+
+void dag_jit_free(dag_jit_fn_t fn) {}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef DAG_JIT_H
+#define DAG_JIT_H
+
+#include <stdint.h>
+#include "dag-eval.h"
+
+// straight-line x86-64 code computing a root of a dag_program_t. slots is
+// the scratch area for the intermediate values (one per node of the
+// program, p->values can be used)
+typedef uint64_t (*dag_jit_fn_t)(uint64_t* inputs, uint64_t* slots);
+
+// returns NULL if the root contains something the emitter does not support
+// (e.g., divisions) or if the host is not x86-64
+dag_jit_fn_t dag_jit_compile(dag_program_t* p, int root);
+void         dag_jit_free(dag_jit_fn_t fn);
+
+#endif
@@ -35,10 +35,11 @@
         fprintf(stderr, format, ##__VA_ARGS__);                                \
     }
 
-#define GD_MOMENTUM_BETA 0.0L
+#define GD_MOMENTUM_BETA 0.5L
 #define GD_ESCAPE_RATIO 1.0L
 #define MAX_EPOCH 1000
 #define MAX_RANDOM_INPUT 0
+#define MAX_RESTARTS 16
 
 #define WRAPPING_ADD_8(x, y) (uint8_t)((uint8_t)(x) + (uint8_t)(y))
 #define WRAPPING_SUB_8(x, y) (uint8_t)((uint8_t)(x) - (uint8_t)(y))
@@ -91,22 +92,25 @@ static __attribute__((unused)) void debug_dump_vector(char* name, uint64_t* v,
     fprintf(stderr, "*** end %s ***\n", name);
 }
 
-static int partial_derivative(gradient_el_t* out_grad_el,
-                              uint64_t (*function)(uint64_t*, int*), int64_t f0,
-                              uint64_t* x0, uint32_t i)
-{
-    int      should_exit;
-    uint64_t original_val = x0[i];
-    x0[i]                 = original_val + 1;
-    int64_t f_plus        = (int64_t)function(x0, &should_exit);
-    if (unlikely(should_exit))
-        return EXIT_ERROR;
-    x0[i]           = original_val - 1;
-    int64_t f_minus = (int64_t)function(x0, &should_exit);
-    if (unlikely(should_exit))
-        return EXIT_ERROR;
-    x0[i] = original_val;
+static gd_gradient_eval_t gradient_eval           = NULL;
+static uint64_t*          __tmp_f_plus_minus      = NULL;
+static unsigned           __tmp_f_plus_minus_size = 0;
 
+static unsigned  optimizer_flags  = 0;
+static double*   __velocity       = NULL;
+static unsigned  __velocity_size  = 0;
+static uint64_t* __restart_x      = NULL;
+static unsigned  __restart_x_size = 0;
+static uint64_t* restart_values   = NULL;
+static uint32_t  n_restart_values = 0;
+static unsigned  restarts_left    = 0;
+
+static gd_variant_stats_t variant_stats;
+
+static int set_partial_derivative(gradient_el_t* out_grad_el, int64_t f0,
+                                  int64_t f_plus, int64_t f_minus, uint64_t* x0,
+                                  uint32_t i)
+{
 #if DEBUG_PARTIAL_DERIVATIVE
     fprintf(stderr, ">>> PARTIAL DERIVATIVE\n");
     fprintf(stderr,
@@ -147,16 +151,64 @@ static int partial_derivative(gradient_el_t* out_grad_el,
     ASSERT_OR_ABORT(0, "partial_derivative - should be unreachable");
 }
 
+static int partial_derivative(gradient_el_t* out_grad_el,
+                              uint64_t (*function)(uint64_t*, int*), int64_t f0,
+                              uint64_t* x0, uint32_t i)
+{
+    int      should_exit;
+    uint64_t original_val = x0[i];
+    x0[i]                 = original_val + 1;
+    int64_t f_plus        = (int64_t)function(x0, &should_exit);
+    if (unlikely(should_exit))
+        return EXIT_ERROR;
+    x0[i]           = original_val - 1;
+    int64_t f_minus = (int64_t)function(x0, &should_exit);
+    if (unlikely(should_exit))
+        return EXIT_ERROR;
+    x0[i] = original_val;
+
+    return set_partial_derivative(out_grad_el, f0, f_plus, f_minus, x0, i);
+}
+
+static int compute_gradient_batch(gradient_el_t* out_grad, int64_t f0,
+                                  uint64_t* x0, uint32_t n)
+{
+    // all the 2n probes are handed to the evaluator at once
+    if (__tmp_f_plus_minus_size < 2 * n) {
+        __tmp_f_plus_minus =
+            realloc(__tmp_f_plus_minus, 2 * n * sizeof(uint64_t));
+        __tmp_f_plus_minus_size = 2 * n;
+    }
+    uint64_t* f_plus  = __tmp_f_plus_minus;
+    uint64_t* f_minus = __tmp_f_plus_minus + n;
+    if (unlikely(!gradient_eval(x0, n, f_plus, f_minus)))
+        return EXIT_ERROR;
+
+    uint32_t i;
+    for (i = 0; i < n; ++i) {
+        set_partial_derivative(&out_grad[i], f0, (int64_t)f_plus[i],
+                               (int64_t)f_minus[i], x0, i);
+        out_grad[i].pct = 0.0L;
+    }
+    return EXIT_OK;
+}
+
 static int compute_gradient(gradient_el_t* out_grad,
                             uint64_t (*function)(uint64_t*, int*), int64_t f0,
                             uint64_t* x0, uint32_t n)
 {
     uint32_t i;
-    for (i = 0; i < n; ++i) {
-        int res = partial_derivative(&out_grad[i], function, f0, x0, i);
-        if (unlikely(res == EXIT_ERROR))
+    if (gradient_eval != NULL) {
+        if (unlikely(compute_gradient_batch(out_grad, f0, x0, n) ==
+                     EXIT_ERROR))
             return EXIT_ERROR;
-        out_grad[i].pct = 0.0L;
+    } else {
+        for (i = 0; i < n; ++i) {
+            int res = partial_derivative(&out_grad[i], function, f0, x0, i);
+            if (unlikely(res == EXIT_ERROR))
+                return EXIT_ERROR;
+            out_grad[i].pct = 0.0L;
+        }
     }
 #if DEBUG_GRADIENT
     fprintf(stderr, ">>> GRADIENT RAW\n");
@@ -183,14 +235,59 @@ static uint64_t max_gradient(gradient_el_t* grad, uint32_t size)
     return max;
 }
 
+static void apply_momentum(gradient_el_t* grad, uint32_t size, uint64_t max)
+{
+    // v = beta * v + (1 - beta) * g, where g is the signed normalized
+    // gradient (positive when increasing x decreases the function)
+    if (__velocity_size < size) {
+        __velocity = realloc(__velocity, size * sizeof(double));
+        memset(__velocity + __velocity_size, 0,
+               (size - __velocity_size) * sizeof(double));
+        __velocity_size = size;
+    }
+
+    uint32_t i;
+    double   v_max = 0.0L;
+    for (i = 0; i < size; ++i) {
+        double g = ((double)grad[i].value) / max;
+        if (grad[i].direction == ASCENDING)
+            g = -g;
+        else if (grad[i].direction == STATIONARY)
+            g = 0.0L;
+
+        __velocity[i] =
+            GD_MOMENTUM_BETA * __velocity[i] + (1.0L - GD_MOMENTUM_BETA) * g;
+        if (__velocity[i] > v_max)
+            v_max = __velocity[i];
+        else if (-__velocity[i] > v_max)
+            v_max = -__velocity[i];
+    }
+
+    // rescale, such that the step search starts from the same step size
+    for (i = 0; i < size; ++i) {
+        if (__velocity[i] > 0.0L) {
+            grad[i].direction = DESCENDING;
+            grad[i].pct       = __velocity[i] / v_max;
+        } else if (__velocity[i] < 0.0L) {
+            grad[i].direction = ASCENDING;
+            grad[i].pct       = -__velocity[i] / v_max;
+        } else {
+            grad[i].direction = STATIONARY;
+            grad[i].pct       = 0.0L;
+        }
+    }
+}
+
 static void normalize_gradient(gradient_el_t* grad, uint32_t size)
 {
     uint64_t max = max_gradient(grad, size);
 
     uint32_t i;
-    for (i = 0; i < size; ++i)
-        grad[i].pct = GD_MOMENTUM_BETA * grad[i].pct +
-                      (1.0L - GD_MOMENTUM_BETA) * ((double)grad[i].value) / max;
+    if (optimizer_flags & GD_OPT_MOMENTUM)
+        apply_momentum(grad, size, max);
+    else
+        for (i = 0; i < size; ++i)
+            grad[i].pct = ((double)grad[i].value) / max;
 
 #if DEBUG_GRADIENT
     fprintf(stderr, "  gradient:\n");
@@ -225,6 +322,88 @@ static void compute_delta_all(uint64_t* x, gradient_el_t* grad, uint64_t step,
     }
 }
 
+static void compute_delta_one(uint64_t* x, gradient_el_t* grad, uint64_t step,
+                              uint32_t i)
+{
+    uint64_t movement = grad[i].pct * step;
+    if (grad[i].direction == ASCENDING)
+        x[i] = x[i] - movement;
+    else if (grad[i].direction == DESCENDING)
+        x[i] = x[i] + movement;
+    else {
+        ASSERT_OR_ABORT(0, "descend - should be unreachable");
+    }
+}
+
+static int bisect_step(uint64_t (*function)(uint64_t*, int*),
+                       gradient_el_t* grad, uint64_t* x_best, int64_t* f_best,
+                       uint64_t* x_tmp, uint64_t step, uint32_t n, uint32_t i)
+{
+    // the last step of the exponential search overshot: try halving it until
+    // it reaches one. If i == n, all the dimensions are moved
+    int should_exit;
+    while ((step /= 2) > 0) {
+        memcpy(x_tmp, x_best, sizeof(uint64_t) * n);
+        if (i == n)
+            compute_delta_all(x_tmp, grad, step, n, 1);
+        else
+            compute_delta_one(x_tmp, grad, step, i);
+
+        int64_t f_tmp = function(x_tmp, &should_exit);
+        if (unlikely(should_exit))
+            return EXIT_ERROR;
+        variant_stats.bisect_evals++;
+        if (f_tmp < *f_best) {
+            variant_stats.bisect_hits++;
+            *f_best = f_tmp;
+            memcpy(x_best, x_tmp, sizeof(uint64_t) * n);
+        }
+    }
+    return EXIT_OK;
+}
+
+static int try_restart(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
+                       int64_t f0, uint64_t* out_x, int64_t* out_f, uint32_t n)
+{
+    // the descent is stuck: set a dimension to one of the restart values and
+    // accept the first jump that lowers the function. Returns 1 on success
+    if (!(optimizer_flags & GD_OPT_RESTART) || n_restart_values == 0)
+        return 0;
+
+    if (__restart_x_size < n) {
+        __restart_x      = realloc(__restart_x, n * sizeof(uint64_t));
+        __restart_x_size = n;
+    }
+
+    int should_exit;
+    while (restarts_left > 0) {
+        restarts_left--;
+        memcpy(__restart_x, x0, sizeof(uint64_t) * n);
+        __restart_x[UR(n)] = restart_values[UR(n_restart_values)];
+
+        int64_t f_val = function(__restart_x, &should_exit);
+        if (unlikely(should_exit))
+            return EXIT_ERROR;
+        variant_stats.restart_evals++;
+        if (f_val < f0) {
+            variant_stats.restart_hits++;
+            memcpy(out_x, __restart_x, sizeof(uint64_t) * n);
+            *out_f = f_val;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void count_momentum_step(int64_t f_prev, int64_t f_next)
+{
+    if (!(optimizer_flags & GD_OPT_MOMENTUM))
+        return;
+    variant_stats.momentum_evals++;
+    if (f_next < f_prev)
+        variant_stats.momentum_hits++;
+}
+
 static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
                    uint64_t* x0, int64_t f0, uint64_t* out_x, int64_t* out_f,
                    uint32_t n)
@@ -288,6 +467,7 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
             res = EXIT_ERROR;
             goto OUT;
         }
+        count_momentum_step(f_prev, f_next);
 #if DEBUG_DESCEND
         fprintf(stderr,
                 "f_prev: %lx\n"
@@ -301,6 +481,12 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
         f_prev = f_next;
     }
     memcpy(x_next, x_prev, sizeof(uint64_t) * n);
+    if ((optimizer_flags & GD_OPT_BISECT) &&
+        bisect_step(function, grad, x_next, &f_prev, x_prev, step, n, n) ==
+            EXIT_ERROR) {
+        res = EXIT_ERROR;
+        goto OUT;
+    }
 
     if (n == 1)
         goto OUT;
@@ -316,21 +502,14 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
     while (1) {
         while (1) {
             memcpy(x_prev, x_next, sizeof(uint64_t) * n);
-
-            uint64_t movement = grad[delta_idx].pct * step;
-            if (grad[delta_idx].direction == ASCENDING)
-                x_next[delta_idx] = x_next[delta_idx] - movement;
-            else if (grad[delta_idx].direction == DESCENDING)
-                x_next[delta_idx] = x_next[delta_idx] + movement;
-            else {
-                ASSERT_OR_ABORT(0, "descend - should be unreachable");
-            }
+            compute_delta_one(x_next, grad, step, delta_idx);
 
             f_next = function(x_next, &should_exit);
             if (unlikely(should_exit)) {
                 res = EXIT_ERROR;
                 goto OUT;
             }
+            count_momentum_step(f_prev, f_next);
 #if DEBUG_DESCEND
             fprintf(stderr,
                     "delta_idx: %u\n"
@@ -345,6 +524,12 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
             f_prev = f_next;
         }
         memcpy(x_next, x_prev, sizeof(uint64_t) * n);
+        if ((optimizer_flags & GD_OPT_BISECT) &&
+            bisect_step(function, grad, x_next, &f_prev, x_prev, step, n,
+                        delta_idx) == EXIT_ERROR) {
+            res = EXIT_ERROR;
+            goto OUT;
+        }
 
         delta_idx++;
         while (delta_idx < n && grad[delta_idx].pct < 0.01)
@@ -392,6 +577,7 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
     }
 
     int64_t f_next = f_prev;
+    int     restart_res;
 
     uint32_t epoch = 0;
     while (epoch < MAX_EPOCH) {
@@ -421,8 +607,18 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
             }
             max_grad = max_gradient(gradient, n);
         }
-        if (i > MAX_RANDOM_INPUT)
-            break;
+        if (i > MAX_RANDOM_INPUT) {
+            restart_res =
+                try_restart(function, x_prev, f_prev, x_next, &f_next, n);
+            if (unlikely(restart_res == EXIT_ERROR)) {
+                res = EXIT_ERROR;
+                goto OUT;
+            }
+            if (!restart_res)
+                break;
+            epoch++;
+            continue;
+        }
 
         normalize_gradient(gradient, n);
 
@@ -448,8 +644,16 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
             res = EXIT_ERROR;
             goto OUT;
         }
-        if (f_prev == f_next)
-            break;
+        if (f_prev == f_next) {
+            restart_res =
+                try_restart(function, x_prev, f_prev, x_next, &f_next, n);
+            if (unlikely(restart_res == EXIT_ERROR)) {
+                res = EXIT_ERROR;
+                goto OUT;
+            }
+            if (!restart_res)
+                break;
+        }
 
 #if DEBUG_MINIMIZE
         fprintf(stderr, "  x_prev:\n");
@@ -505,7 +709,11 @@ int gd_descend_transf(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
         return EXIT_ERROR;
     if (max_gradient(gradient, n) == 0) {
         // we reached a min
-        return 1;
+        int restart_res =
+            try_restart(function, x0, f0, out_x, (int64_t*)out_f, n);
+        if (unlikely(restart_res == EXIT_ERROR))
+            return EXIT_ERROR;
+        return restart_res ? 0 : 1;
     }
     normalize_gradient(gradient, n);
 
@@ -555,4 +763,35 @@ void gd_free()
     free(__tmp_gradient);
     __tmp_gradient_size = 0;
     __tmp_gradient      = NULL;
+
+    free(__tmp_f_plus_minus);
+    __tmp_f_plus_minus_size = 0;
+    __tmp_f_plus_minus      = NULL;
+    gradient_eval           = NULL;
+
+    free(__velocity);
+    free(__restart_x);
+    __velocity       = NULL;
+    __velocity_size  = 0;
+    __restart_x      = NULL;
+    __restart_x_size = 0;
+    optimizer_flags  = 0;
 }
+
+void gd_set_gradient_eval(gd_gradient_eval_t f) { gradient_eval = f; }
+
+void gd_set_optimizer(unsigned flags) { optimizer_flags = flags; }
+
+void gd_reset_optimizer(uint64_t* values, uint32_t n_values)
+{
+    // start a new descent: forget the momentum and refill the restart budget.
+    // values must outlive the descent
+    if (__velocity_size > 0)
+        memset(__velocity, 0, __velocity_size * sizeof(double));
+    restart_values   = values;
+    n_restart_values = n_values;
+    restarts_left    = MAX_RESTARTS;
+    memset(&variant_stats, 0, sizeof(gd_variant_stats_t));
+}
+
+void gd_get_variant_stats(gd_variant_stats_t* out) { *out = variant_stats; }
@@ -3,8 +3,34 @@
 
 #include <stdint.h>
 
+// evaluates the function in x0 +/- 1 along every dimension, writing the
+// results in f_plus and f_minus. Returns 0 if the evaluation must stop
+typedef int (*gd_gradient_eval_t)(uint64_t* x0, uint32_t n, uint64_t* f_plus,
+                                  uint64_t* f_minus);
+
+// optimizer variants, they can be combined
+#define GD_OPT_BISECT 1   // refine the exponential step search by bisection
+#define GD_OPT_MOMENTUM 2 // keep a fraction of the previous gradients
+#define GD_OPT_RESTART 4  // escape plateaus jumping to the restart values
+
+// work of the optimizer variants since the last gd_reset_optimizer(): the
+// evaluations each one spent, and how many of them lowered the function.
+// Momentum is charged with the line searches along the blended gradient
+typedef struct gd_variant_stats_t {
+    unsigned long bisect_evals;
+    unsigned long bisect_hits;
+    unsigned long momentum_evals;
+    unsigned long momentum_hits;
+    unsigned long restart_evals;
+    unsigned long restart_hits;
+} gd_variant_stats_t;
+
 void gd_init();
 void gd_free();
+void gd_set_gradient_eval(gd_gradient_eval_t gradient_eval);
+void gd_set_optimizer(unsigned flags);
+void gd_reset_optimizer(uint64_t* restart_values, uint32_t n_restart_values);
+void gd_get_variant_stats(gd_variant_stats_t* out);
 
 int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
                 uint64_t* out_x_min, uint64_t* out_f_min, uint32_t n);
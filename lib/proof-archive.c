@@ -0,0 +1,354 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "proof-archive.h"
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+#define ASSERT_OR_ABORT(x, mex)                                                \
+    if (unlikely(!(x))) {                                                      \
+        fprintf(stderr, "[proof-archive ABORT] " mex "\n");                    \
+        abort();                                                               \
+    }
+
+#define ARCHIVE_MAGIC "FZPROOF1"
+#define INDEX_MAGIC "FZPINDEX"
+#define MAGIC_SIZE 8
+#define FOOTER_SIZE (2 * sizeof(uint64_t) + MAGIC_SIZE)
+#define ARCHIVE_BUF_SIZE (1UL << 20)
+
+struct proof_archive_t {
+    int            fd;
+    unsigned char* seed;
+    uint64_t       seed_len;
+    uint64_t       pos; // bytes appended so far
+    int            io_error;
+
+    proof_archive_entry_t* index;
+    uint64_t               n_entries, max_entries;
+
+    // double buffering: the caller fills buf[cur], the writer thread writes
+    // pending (the other one)
+    unsigned char*  buf[2];
+    size_t          buf_len;
+    int             cur;
+    unsigned char*  pending;
+    size_t          pending_len;
+    int             stop;
+    pthread_t       writer;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+static int __write_all(int fd, unsigned char const* data, size_t n)
+{
+    while (n > 0) {
+        ssize_t r = write(fd, data, n);
+        if (r <= 0)
+            return -1;
+        data += r;
+        n -= r;
+    }
+    return 0;
+}
+
+static void* __writer_loop(void* arg)
+{
+    proof_archive_t* a = (proof_archive_t*)arg;
+
+    pthread_mutex_lock(&a->lock);
+    while (1) {
+        while (a->pending == NULL && !a->stop)
+            pthread_cond_wait(&a->cond, &a->lock);
+        if (a->pending == NULL)
+            break;
+
+        unsigned char* data = a->pending;
+        size_t         n    = a->pending_len;
+        pthread_mutex_unlock(&a->lock);
+        int res = __write_all(a->fd, data, n);
+        pthread_mutex_lock(&a->lock);
+
+        if (res != 0)
+            a->io_error = 1;
+        a->pending = NULL;
+        pthread_cond_broadcast(&a->cond);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return NULL;
+}
+
+static void __wait_writer(proof_archive_t* a)
+{
+    while (a->pending != NULL)
+        pthread_cond_wait(&a->cond, &a->lock);
+}
+
+static void __flush(proof_archive_t* a)
+{
+    if (a->buf_len == 0)
+        return;
+
+    pthread_mutex_lock(&a->lock);
+    __wait_writer(a);
+    a->pending     = a->buf[a->cur];
+    a->pending_len = a->buf_len;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+
+    a->cur ^= 1;
+    a->buf_len = 0;
+}
+
+static void __append(proof_archive_t* a, void const* data, size_t n)
+{
+    unsigned char const* p = (unsigned char const*)data;
+    while (n > 0) {
+        size_t chunk = ARCHIVE_BUF_SIZE - a->buf_len;
+        if (chunk > n)
+            chunk = n;
+        memcpy(a->buf[a->cur] + a->buf_len, p, chunk);
+        a->buf_len += chunk;
+        a->pos += chunk;
+        p += chunk;
+        n -= chunk;
+        if (a->buf_len == ARCHIVE_BUF_SIZE)
+            __flush(a);
+    }
+}
+
+static void __append_u64(proof_archive_t* a, uint64_t v)
+{
+    __append(a, &v, sizeof(v));
+}
+
+proof_archive_t* proof_archive_create(const char*          filename,
+                                      unsigned char const* seed,
+                                      unsigned long        seed_len)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return NULL;
+
+    proof_archive_t* a = (proof_archive_t*)calloc(1, sizeof(proof_archive_t));
+    ASSERT_OR_ABORT(a != NULL, "proof_archive_create(): calloc failed");
+    a->fd          = fd;
+    a->seed_len    = seed_len;
+    a->seed        = (unsigned char*)malloc(seed_len > 0 ? seed_len : 1);
+    a->max_entries = 1024;
+    a->index       = (proof_archive_entry_t*)malloc(
+        sizeof(proof_archive_entry_t) * a->max_entries);
+    a->buf[0]      = (unsigned char*)malloc(ARCHIVE_BUF_SIZE);
+    a->buf[1]      = (unsigned char*)malloc(ARCHIVE_BUF_SIZE);
+    ASSERT_OR_ABORT(a->seed != NULL && a->index != NULL && a->buf[0] != NULL &&
+                        a->buf[1] != NULL,
+                    "proof_archive_create(): malloc failed");
+    memcpy(a->seed, seed, seed_len);
+
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond, NULL);
+    ASSERT_OR_ABORT(pthread_create(&a->writer, NULL, __writer_loop, a) == 0,
+                    "proof_archive_create(): pthread_create failed");
+
+    __append(a, ARCHIVE_MAGIC, MAGIC_SIZE);
+    __append_u64(a, seed_len);
+    __append(a, seed, seed_len);
+    return a;
+}
+
+static void __add_entry(proof_archive_t* a, uint64_t query)
+{
+    if (a->n_entries == a->max_entries) {
+        a->max_entries *= 2;
+        a->index = (proof_archive_entry_t*)realloc(
+            a->index, sizeof(proof_archive_entry_t) * a->max_entries);
+        ASSERT_OR_ABORT(a->index != NULL, "__add_entry(): realloc failed");
+    }
+    a->index[a->n_entries].query  = query;
+    a->index[a->n_entries].offset = a->pos;
+    a->n_entries++;
+}
+
+void proof_archive_add_patch(proof_archive_t* a, uint64_t query,
+                             fuzzy_patch_t const* patches,
+                             unsigned long        n_patches)
+{
+    unsigned long i;
+
+    __add_entry(a, query);
+    __append_u64(a, n_patches);
+    for (i = 0; i < n_patches; ++i)
+        __append_u64(a, patches[i].offset);
+    for (i = 0; i < n_patches; ++i)
+        __append(a, &patches[i].value, 1);
+}
+
+void proof_archive_add_proof(proof_archive_t* a, uint64_t query,
+                             unsigned char const* proof)
+{
+    uint64_t i, n_patches = 0;
+
+    for (i = 0; i < a->seed_len; ++i)
+        if (proof[i] != a->seed[i])
+            n_patches++;
+
+    __add_entry(a, query);
+    __append_u64(a, n_patches);
+    for (i = 0; i < a->seed_len; ++i)
+        if (proof[i] != a->seed[i])
+            __append_u64(a, i);
+    for (i = 0; i < a->seed_len; ++i)
+        if (proof[i] != a->seed[i])
+            __append(a, &proof[i], 1);
+}
+
+static int __entry_cmp(const void* e1, const void* e2)
+{
+    uint64_t q1 = ((proof_archive_entry_t*)e1)->query;
+    uint64_t q2 = ((proof_archive_entry_t*)e2)->query;
+    return q1 < q2 ? -1 : (q1 > q2 ? 1 : 0);
+}
+
+int proof_archive_close(proof_archive_t* a)
+{
+    static const unsigned char zeros[sizeof(uint64_t)] = {0};
+
+    qsort(a->index, a->n_entries, sizeof(proof_archive_entry_t), __entry_cmp);
+    if (a->pos % sizeof(uint64_t) != 0)
+        __append(a, zeros, sizeof(uint64_t) - a->pos % sizeof(uint64_t));
+    uint64_t index_offset = a->pos;
+    __append(a, a->index, sizeof(proof_archive_entry_t) * a->n_entries);
+    __append_u64(a, a->n_entries);
+    __append_u64(a, index_offset);
+    __append(a, INDEX_MAGIC, MAGIC_SIZE);
+    __flush(a);
+
+    pthread_mutex_lock(&a->lock);
+    __wait_writer(a);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->writer, NULL);
+
+    int res = a->io_error ? -1 : 0;
+    if (close(a->fd) != 0)
+        res = -1;
+
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->cond);
+    free(a->buf[0]);
+    free(a->buf[1]);
+    free(a->index);
+    free(a->seed);
+    free(a);
+    return res;
+}
+
+static uint64_t __read_u64(unsigned char const* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int proof_archive_map(proof_archive_reader_t* r, const char* filename)
+{
+    struct stat sb;
+    int         fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &sb) != 0 ||
+        (uint64_t)sb.st_size < MAGIC_SIZE + sizeof(uint64_t) + FOOTER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    void* data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    r->data = (unsigned char*)data;
+    r->size = sb.st_size;
+
+    unsigned char const* footer = r->data + r->size - FOOTER_SIZE;
+    if (memcmp(r->data, ARCHIVE_MAGIC, MAGIC_SIZE) != 0 ||
+        memcmp(footer + 2 * sizeof(uint64_t), INDEX_MAGIC, MAGIC_SIZE) != 0)
+        goto INVALID;
+
+    r->seed_len  = __read_u64(r->data + MAGIC_SIZE);
+    r->seed      = r->data + MAGIC_SIZE + sizeof(uint64_t);
+    r->n_entries = __read_u64(footer);
+
+    // the records lie between the seed and the index
+    uint64_t index_offset = __read_u64(footer + sizeof(uint64_t));
+    if (index_offset % sizeof(uint64_t) != 0 ||
+        index_offset > r->size - FOOTER_SIZE ||
+        index_offset < MAGIC_SIZE + sizeof(uint64_t) ||
+        r->seed_len > index_offset - MAGIC_SIZE - sizeof(uint64_t) ||
+        r->n_entries > (r->size - FOOTER_SIZE - index_offset) /
+                           sizeof(proof_archive_entry_t))
+        goto INVALID;
+    r->index = (proof_archive_entry_t const*)(r->data + index_offset);
+    return 0;
+
+INVALID:
+    munmap(r->data, r->size);
+    r->data = NULL;
+    return -1;
+}
+
+void proof_archive_unmap(proof_archive_reader_t* r)
+{
+    if (r->data != NULL)
+        munmap(r->data, r->size);
+    r->data = NULL;
+}
+
+int proof_archive_extract(proof_archive_reader_t* r, uint64_t query,
+                          unsigned char* out)
+{
+    // binary search in the index
+    uint64_t lo = 0, hi = r->n_entries;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (r->index[mid].query < query)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == r->n_entries || r->index[lo].query != query)
+        return 0;
+
+    // do not trust the index, the record must fit before the index
+    uint64_t records_begin = MAGIC_SIZE + sizeof(uint64_t) + r->seed_len;
+    uint64_t records_end   = (unsigned char const*)r->index - r->data;
+    uint64_t offset        = r->index[lo].offset;
+    if (offset < records_begin || offset > records_end - sizeof(uint64_t))
+        return -1;
+
+    unsigned char const* record    = r->data + offset;
+    uint64_t             n_patches = __read_u64(record);
+    if (n_patches > (records_end - offset - sizeof(uint64_t)) /
+                        (sizeof(uint64_t) + 1))
+        return -1;
+
+    unsigned char const* offsets   = record + sizeof(uint64_t);
+    unsigned char const* values    = offsets + sizeof(uint64_t) * n_patches;
+    uint64_t             i;
+
+    memcpy(out, r->seed, r->seed_len);
+    for (i = 0; i < n_patches; ++i) {
+        offset = __read_u64(offsets + sizeof(uint64_t) * i);
+        if (offset < r->seed_len)
+            out[offset] = values[i];
+    }
+    return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef PROOF_ARCHIVE_H
+#define PROOF_ARCHIVE_H
+
+#include <stdint.h>
+#include "z3-fuzzy.h"
+
+// append-only file of proofs, each one stored as byte patches against the
+// seed (that is stored once, in the header). Layout (host byte order):
+//
+//   "FZPROOF1" | seed_len (u64) | seed bytes
+//   records:     n_patches (u64) | offsets (u64 * n) | values (u8 * n)
+//   index:       proof_archive_entry_t * n_entries, sorted by query and
+//                aligned to 8 bytes
+//   footer:      n_entries (u64) | index offset (u64) | "FZPINDEX"
+//
+// The writer fills a buffer while a background thread writes the previous
+// one, the index is kept in memory and written by proof_archive_close()
+typedef struct proof_archive_entry_t {
+    uint64_t query;
+    uint64_t offset; // offset of the record in the file
+} proof_archive_entry_t;
+
+typedef struct proof_archive_t proof_archive_t;
+
+// returns NULL if filename cannot be created
+proof_archive_t* proof_archive_create(const char*          filename,
+                                      unsigned char const* seed,
+                                      unsigned long        seed_len);
+void proof_archive_add_patch(proof_archive_t* a, uint64_t query,
+                             fuzzy_patch_t const* patches,
+                             unsigned long        n_patches);
+// diff proof (seed_len bytes) against the seed
+void proof_archive_add_proof(proof_archive_t* a, uint64_t query,
+                             unsigned char const* proof);
+// returns 0 on success, -1 if a write failed
+int proof_archive_close(proof_archive_t* a);
+
+// read side: the whole file is mapped, index points into the mapping
+typedef struct proof_archive_reader_t {
+    unsigned char*               data;
+    uint64_t                     size;
+    unsigned char const*         seed;
+    uint64_t                     seed_len;
+    proof_archive_entry_t const* index;
+    uint64_t                     n_entries;
+} proof_archive_reader_t;
+
+// returns 0 on success, -1 if filename is not a valid archive
+int  proof_archive_map(proof_archive_reader_t* r, const char* filename);
+void proof_archive_unmap(proof_archive_reader_t* r);
+// write the proof of query in out (seed_len bytes). Returns 0 if the archive
+// has no proof for query, -1 if its record is corrupted
+int proof_archive_extract(proof_archive_reader_t* r, uint64_t query,
+                          unsigned char* out);
+
+#endif
@@ -220,6 +220,13 @@ int wi_update_cmp(wrapped_interval_t* src, uint64_t c, optype op)
             src->max = c;
             break;
         }
+        case OP_NE: {
+            // the complement of a value is a wrapping interval
+            cint.min = (c + 1) & get_size_mask(src->size);
+            cint.max = (c - 1) & get_size_mask(src->size);
+            res      = wi_intersect(src, &cint);
+            break;
+        }
 
         default:
             ASSERT_OR_ABORT(0, "INTERVAL_H interval_update_cmp() - invalid op");
@@ -242,13 +249,10 @@ void wi_update_sub(wrapped_interval_t* src, uint64_t c)
 
 void wi_update_invert(wrapped_interval_t* src)
 {
-    src->min = (- src->min) & get_size_mask(src->size);
-    src->max = (- src->max) & get_size_mask(src->size);
-    if (src->max < src->min) {
-        src->min ^= src->max;
-        src->max ^= src->min;
-        src->min ^= src->max;
-    }
+    // -[min, max] = [-max, -min], possibly wrapping (e.g. -[0, 10])
+    uint64_t old_min = src->min;
+    src->min         = (-src->max) & get_size_mask(src->size);
+    src->max         = (-old_min) & get_size_mask(src->size);
 }
 
 void wi_modify_size(wrapped_interval_t* src, uint32_t new_size)
@@ -284,18 +288,224 @@ wrapped_interval_iter_t wi_init_iter_values(wrapped_interval_t* interval)
     it.curr_i = 0;
     it.max_i  = wi_get_range(interval);
     it.mask   = get_size_mask(interval->size);
+    it.set    = NULL;
+    it.set_i  = 0;
+    return it;
+}
+
+wrapped_interval_iter_t wis_init_iter_values(const wrapped_interval_set_t* set)
+{
+    wrapped_interval_iter_t it;
+    it.mask  = get_size_mask(set->size);
+    it.set   = set;
+    it.set_i = 0;
+    if (set->n == 0) {
+        it.min_v  = 0;
+        it.curr_i = 1;
+        it.max_i  = 0;
+        return it;
+    }
+    it.min_v  = set->intervals[0].min;
+    it.curr_i = 0;
+    it.max_i  = set->intervals[0].max - set->intervals[0].min;
     return it;
 }
 
 int wi_iter_get_next(wrapped_interval_iter_t* it, uint64_t* el)
 {
-    if (it->curr_i > it->max_i)
-        return 0;
+    if (it->curr_i > it->max_i) {
+        // move to the next interval of the set (if any)
+        if (it->set == NULL || it->set_i + 1 >= it->set->n)
+            return 0;
+
+        const wrapped_interval_t* next = &it->set->intervals[++it->set_i];
+        it->min_v                      = next->min;
+        it->curr_i                     = 0;
+        it->max_i                      = next->max - next->min;
+    }
 
     *el = (uint64_t)((it->min_v + it->curr_i++) & it->mask);
     return 1;
 }
 
+unsigned wi_iter_get_next_batch(wrapped_interval_iter_t* it, uint64_t* els,
+                                unsigned max_els)
+{
+    // fill els with up to max_els values, returns how many were written
+    unsigned n = 0;
+    while (n < max_els && wi_iter_get_next(it, &els[n]))
+        n++;
+    return n;
+}
+
+// ******** interval sets ********
+
+static inline void wis_append(wrapped_interval_set_t* set,
+                              wrapped_interval_t*     buf, uint32_t* n,
+                              uint64_t min, uint64_t max)
+{
+    // buf is sorted by min: merge if overlapping or adjacent
+    if (*n > 0 && (buf[*n - 1].max == get_size_mask(set->size) ||
+                   min <= buf[*n - 1].max + 1)) {
+        buf[*n - 1].max = _max(buf[*n - 1].max, max);
+        return;
+    }
+    buf[*n].min  = min;
+    buf[*n].max  = max;
+    buf[*n].size = set->size;
+    *n += 1;
+}
+
+static inline void wis_store(wrapped_interval_set_t* set,
+                             wrapped_interval_t* buf, uint32_t n)
+{
+    // too many intervals: merge the ones separated by the smallest gap
+    while (n > WI_SET_MAX_INTERVALS) {
+        uint32_t i, best = 0;
+        for (i = 1; i < n - 1; ++i)
+            if (buf[i + 1].min - buf[i].max < buf[best + 1].min - buf[best].max)
+                best = i;
+
+        buf[best].max = buf[best + 1].max;
+        for (i = best + 1; i < n - 1; ++i)
+            buf[i] = buf[i + 1];
+        n--;
+    }
+
+    uint32_t i;
+    for (i = 0; i < n; ++i)
+        set->intervals[i] = buf[i];
+    set->n = n;
+}
+
+wrapped_interval_set_t wis_init(unsigned size)
+{
+    wrapped_interval_set_t res;
+    res.size         = size;
+    res.n            = 1;
+    res.intervals[0] = wi_init(size);
+    return res;
+}
+
+wrapped_interval_set_t wis_from_interval(const wrapped_interval_t* interval)
+{
+    wrapped_interval_set_t res;
+    res.size = interval->size;
+    res.n    = 0;
+    if (!is_wrapping(interval)) {
+        res.intervals[0] = *interval;
+        res.n            = 1;
+    } else {
+        wrapped_interval_t buf[2];
+        uint32_t           n = 0;
+        wis_append(&res, buf, &n, 0, interval->max);
+        wis_append(&res, buf, &n, interval->min, get_size_mask(res.size));
+        wis_store(&res, buf, n);
+    }
+    return res;
+}
+
+int wis_intersect_set(wrapped_interval_set_t*       set1,
+                      const wrapped_interval_set_t* set2)
+{
+    // exact, unless the result has too many intervals
+    // -> side-effect on set1 (unmodified if the intersection is empty)
+    wrapped_interval_t buf[2 * WI_SET_MAX_INTERVALS];
+    uint32_t           n = 0, i = 0, j = 0;
+
+    while (i < set1->n && j < set2->n) {
+        const wrapped_interval_t* a = &set1->intervals[i];
+        const wrapped_interval_t* b = &set2->intervals[j];
+
+        uint64_t min = _max(a->min, b->min);
+        uint64_t max = _min(a->max, b->max);
+        if (min <= max)
+            wis_append(set1, buf, &n, min, max);
+
+        if (a->max < b->max)
+            i++;
+        else
+            j++;
+    }
+    if (n == 0)
+        return 0;
+
+    wis_store(set1, buf, n);
+    return 1;
+}
+
+int wis_intersect(wrapped_interval_set_t* set, const wrapped_interval_t* wi)
+{
+    wrapped_interval_set_t tmp = wis_from_interval(wi);
+    return wis_intersect_set(set, &tmp);
+}
+
+void wis_union(wrapped_interval_set_t* set1, const wrapped_interval_set_t* set2)
+{
+    wrapped_interval_t buf[2 * WI_SET_MAX_INTERVALS];
+    uint32_t           n = 0, i = 0, j = 0;
+
+    while (i < set1->n || j < set2->n) {
+        const wrapped_interval_t* next;
+        if (j >= set2->n ||
+            (i < set1->n && set1->intervals[i].min < set2->intervals[j].min))
+            next = &set1->intervals[i++];
+        else
+            next = &set2->intervals[j++];
+        wis_append(set1, buf, &n, next->min, next->max);
+    }
+    wis_store(set1, buf, n);
+}
+
+void wis_modify_size(wrapped_interval_set_t* set, uint32_t new_size)
+{
+    if (new_size < set->size) {
+        wrapped_interval_t tmp = {
+            .min = 0, .max = get_size_mask(new_size), .size = set->size};
+        if (!wis_intersect(set, &tmp)) {
+            // no value fits in new_size
+            *set = wis_init(new_size);
+            return;
+        }
+    }
+    uint32_t i;
+    for (i = 0; i < set->n; ++i)
+        set->intervals[i].size = new_size;
+    set->size = new_size;
+}
+
+int wis_contains_element(const wrapped_interval_set_t* set, uint64_t value)
+{
+    uint32_t i;
+    for (i = 0; i < set->n; ++i) {
+        if (value < set->intervals[i].min)
+            return 0;
+        if (value <= set->intervals[i].max)
+            return 1;
+    }
+    return 0;
+}
+
+uint64_t wis_get_range(const wrapped_interval_set_t* set)
+{
+    // number of elements - 1, as wi_get_range
+    uint64_t range = 0;
+    uint32_t i;
+    for (i = 0; i < set->n; ++i)
+        range += set->intervals[i].max - set->intervals[i].min;
+    return set->n > 0 ? range + set->n - 1 : 0;
+}
+
+uint64_t wis_get_min(const wrapped_interval_set_t* set)
+{
+    return set->n > 0 ? set->intervals[0].min : 0;
+}
+
+uint64_t wis_get_max(const wrapped_interval_set_t* set)
+{
+    return set->n > 0 ? set->intervals[set->n - 1].max : 0;
+}
+
 const char* op_to_string(optype op)
 {
     switch (op) {
@@ -315,6 +525,10 @@ const char* op_to_string(optype op)
             return "OP_SLT";
         case OP_SLE:
             return "OP_SLE";
+        case OP_EQ:
+            return "OP_EQ";
+        case OP_NE:
+            return "OP_NE";
 
         default:
             ASSERT_OR_ABORT(0, "op_to_string() - unexpected optype");
@@ -331,3 +545,12 @@ void wi_print(wrapped_interval_t* interval)
                 get_size_mask(interval->size), 0UL, interval->max,
                 interval->size);
 }
+
+void wis_print(const wrapped_interval_set_t* set)
+{
+    uint32_t i;
+    for (i = 0; i < set->n; ++i)
+        fprintf(stderr, "%s[ 0x%lx, 0x%lx ]", i > 0 ? " U " : "",
+                set->intervals[i].min, set->intervals[i].max);
+    fprintf(stderr, " (%u)\n", set->size);
+}
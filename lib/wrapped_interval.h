@@ -12,6 +12,9 @@
 #define OP_UGE 6
 #define OP_SGE 7
 #define OP_EQ 8
+#define OP_NE 9
+
+#define WI_SET_MAX_INTERVALS 8
 
 typedef int optype;
 
@@ -21,11 +24,21 @@ typedef struct wrapped_interval_t {
     uint32_t size;
 } wrapped_interval_t;
 
+// sorted set of disjoint, non-wrapping intervals. If it grows over
+// WI_SET_MAX_INTERVALS, the closest intervals are merged (overapproximation)
+typedef struct wrapped_interval_set_t {
+    wrapped_interval_t intervals[WI_SET_MAX_INTERVALS];
+    uint32_t           n;
+    uint32_t           size;
+} wrapped_interval_set_t;
+
 typedef struct wrapped_interval_iter_t {
-    uint64_t curr_i;
-    uint64_t max_i;
-    uint64_t min_v;
-    uint64_t mask;
+    uint64_t                      curr_i;
+    uint64_t                      max_i;
+    uint64_t                      min_v;
+    uint64_t                      mask;
+    const wrapped_interval_set_t* set;
+    uint32_t                      set_i;
 } wrapped_interval_iter_t;
 
 wrapped_interval_t wi_init(unsigned size);
@@ -39,8 +52,25 @@ int  wi_contains_element(const wrapped_interval_t* interval, uint64_t value);
 uint64_t wi_get_range(const wrapped_interval_t* interval);
 void     wi_print(wrapped_interval_t* interval);
 
+wrapped_interval_set_t wis_init(unsigned size);
+wrapped_interval_set_t wis_from_interval(const wrapped_interval_t* interval);
+int  wis_intersect(wrapped_interval_set_t* set, const wrapped_interval_t* wi);
+int  wis_intersect_set(wrapped_interval_set_t*       set1,
+                       const wrapped_interval_set_t* set2);
+void wis_union(wrapped_interval_set_t* set1, const wrapped_interval_set_t* set2);
+void wis_modify_size(wrapped_interval_set_t* set, uint32_t new_size);
+int  wis_contains_element(const wrapped_interval_set_t* set, uint64_t value);
+uint64_t wis_get_range(const wrapped_interval_set_t* set);
+uint64_t wis_get_min(const wrapped_interval_set_t* set);
+uint64_t wis_get_max(const wrapped_interval_set_t* set);
+void     wis_print(const wrapped_interval_set_t* set);
+
 wrapped_interval_iter_t wi_init_iter_values(wrapped_interval_t* interval);
-int wi_iter_get_next(wrapped_interval_iter_t* it, uint64_t* el);
+wrapped_interval_iter_t
+    wis_init_iter_values(const wrapped_interval_set_t* set);
+int      wi_iter_get_next(wrapped_interval_iter_t* it, uint64_t* el);
+unsigned wi_iter_get_next_batch(wrapped_interval_iter_t* it, uint64_t* els,
+                                unsigned max_els);
 
 const char* op_to_string(optype op);
 
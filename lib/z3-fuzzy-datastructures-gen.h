@@ -3,7 +3,7 @@
 
 typedef struct index_group_t {
     unsigned char n;                       // number of valid indexes
-    unsigned long indexes[MAX_GROUP_SIZE]; // indexes
+    uint32_t      indexes[MAX_GROUP_SIZE]; // indexes
 } index_group_t;
 
 #define SET_N_BUCKETS 8
@@ -13,9 +13,13 @@ typedef set__index_group_t index_groups_t;
 
 unsigned long index_group_hash(index_group_t* el)
 {
-    unsigned long a = el->n;
-    unsigned long b = a > 0 ? el->indexes[0] : 0;
-    return (a + b) * (a + b + 1) / 2;
+    // groups that share the first index are common (e.g., a word and a dword
+    // read from the same offset), mix all the indexes
+    unsigned long h = el->n;
+    unsigned char i;
+    for (i = 0; i < el->n; ++i)
+        h = (h ^ el->indexes[i]) * 0x100000001b3UL;
+    return h ^ (h >> 29);
 }
 
 unsigned int index_group_equals(index_group_t* el1, index_group_t* el2)
@@ -147,10 +151,13 @@ static inline void add_item_to_conflicting(dict__conflicting_ptr* dict,
 // ******** end conflicting dict *********
 // ********** interval group *************
 typedef struct interval_group_t {
-    wrapped_interval_t interval;
-    index_group_t      group;
+    wrapped_interval_set_t interval;
+    index_group_t          group;
 } interval_group_t;
 
+#define DA_DATA_T interval_group_t
+#include "dynamic-array.h"
+
 typedef interval_group_t* interval_group_ptr;
 #define SET_DATA_T interval_group_ptr
 #include "set.h"
@@ -179,6 +186,47 @@ static void index_to_group_intervals_el_free(da__interval_group_ptr* el)
 // ******* da Z3_ast **********************
 #define DA_DATA_T Z3_ast
 #include "dynamic-array.h"
+
+#define DICT_DATA_T da__Z3_ast
+#include "dict.h"
+
+static void da_Z3_ast_el_free(da__Z3_ast* el) { da_free__Z3_ast(el, NULL); }
+// ****************************************
+// ********* canonical asts ***************
+typedef struct canon_ast_t {
+    Z3_context ctx;
+    Z3_ast     ast;   // the key of the entry is the id of ast
+    Z3_ast     canon; // canonical form of ast
+} canon_ast_t;
+#define DICT_DATA_T canon_ast_t
+#include "dict.h"
+
+static void canon_ast_free(canon_ast_t* el)
+{
+    Z3_dec_ref(el->ctx, el->ast);
+    Z3_dec_ref(el->ctx, el->canon);
+}
+// ****************************************
+// ********* session frames ***************
+typedef struct session_frame_t {
+    unsigned long n_constraints; // constraints asserted in previous frames
+    Z3_ast        query;         // conjunction of the constraints (or NULL)
+    int           learned;       // the frame modified the learned state
+    struct learned_snapshot_t* snapshot; // learned state before it (or NULL)
+} session_frame_t;
+#define DA_DATA_T session_frame_t
+#include "dynamic-array.h"
+// ****************************************
+// ********* token dictionary *************
+typedef struct token_t {
+    unsigned long value;
+    unsigned long hits; // how many times the constant has been harvested
+} token_t;
+#define DA_DATA_T token_t
+#include "dynamic-array.h"
+
+#define DICT_DATA_T ulong
+#include "dict.h"
 // ****************************************
 // ********* ItS ite **********************
 typedef struct ite_its_t {
@@ -199,3 +247,46 @@ int da_check_el__ite_its_t(da__ite_its_t* d, ite_its_t* el)
     return 0;
 }
 // ****************************************
+// ********* tmp_input journal ************
+typedef struct input_patch_t {
+    unsigned long index;
+    unsigned long value; // value of the index before the patch
+} input_patch_t;
+#define DA_DATA_T input_patch_t
+#include "dynamic-array.h"
+// ****************************************
+// ************ proof patches *************
+#define DA_DATA_T fuzzy_patch_t
+#include "dynamic-array.h"
+// ****************************************
+// ********* abstract values **************
+typedef struct abs_value_t {
+    uint64_t           zeros; // bits known to be zero
+    uint64_t           ones;  // bits known to be one
+    wrapped_interval_t range; // size 0 if wider than 64 bits
+} abs_value_t;
+#define DICT_DATA_T abs_value_t
+#include "dict.h"
+// ****************************************
+// ********* shared facts *****************
+typedef enum shared_fact_kind_t {
+    SHARED_FACT_NONE, // the constraint does not define nor bound its inputs
+    SHARED_FACT_UNIVOCALLY_DEFINED,
+    SHARED_FACT_RANGE
+} shared_fact_kind_t;
+
+typedef struct shared_fact_t {
+    Z3_context             ctx;
+    Z3_ast                 constraint; // the key of the entry is its id
+    shared_fact_kind_t     kind;
+    index_group_t          group;
+    wrapped_interval_set_t interval; // only for SHARED_FACT_RANGE
+} shared_fact_t;
+#define DICT_DATA_T shared_fact_t
+#include "dict.h"
+
+static void shared_fact_free(shared_fact_t* el)
+{
+    Z3_dec_ref(el->ctx, el->constraint);
+}
+// ****************************************
@@ -7,7 +7,7 @@ static inline void print_index_queue(ast_info_ptr data)
     set_reset_iter__index_group_t(&data->index_groups, 1);
     while (set_iter_next__index_group_t(&data->index_groups, 1, &group)) {
         for (j = 0; j < group->n; ++j)
-            fprintf(stderr, "group: %d. index: 0x%lx\n", i, group->indexes[j]);
+            fprintf(stderr, "group: %d. index: 0x%x\n", i, group->indexes[j]);
         i++;
     }
 
@@ -30,7 +30,7 @@ static inline void print_index_group(index_group_t* ig)
             ig->n);
     unsigned i;
     for (i = 0; i < ig->n; ++i)
-        fprintf(stderr, "%03ld ", ig->indexes[i]);
+        fprintf(stderr, "%03u ", ig->indexes[i]);
     fprintf(stderr, "\n}\n");
 }
 
@@ -45,7 +45,7 @@ static inline void print_interval_groups(fuzzy_ctx_t* ctx)
     while (set_iter_next__interval_group_ptr(group_intervals, 0, &el)) {
         fprintf(stderr, "***************************\n");
         print_index_group(&(*el)->group);
-        wi_print(&(*el)->interval);
+        wis_print(&(*el)->interval);
         fprintf(stderr, "***************************\n");
     }
     fprintf(stderr, "------------------------------\n");
@@ -6,6 +6,8 @@
 #include "gradient_descend.h"
 #include "wrapped_interval.h"
 #include "timer.h"
+#include "dag-eval.h"
+#include "dag-jit.h"
 #include "z3-fuzzy.h"
 
 #ifndef likely
@@ -27,13 +29,14 @@
     } while (0);
 #define Z3FUZZ_LOG(x...) fprintf(stderr, "[z3fuzz] " x)
 
-#define FLIP_BIT(_var, _idx) ((_var) ^ (1 << (_idx)));
+#define FLIP_BIT(_var, _idx) ((_var) ^ (1 << (_idx)))
 #define rightmost_set_bit(x) ((x) != 0 ? __builtin_ctzl(x) : -1)
 #define leftmost_set_bit(x) ((x) != 0 ? (63 - __builtin_clzl(x)) : -1)
 
 #define HAVOC_STACK_POW2 7
 #define HAVOC_C 20
 #define RANGE_MAX_WIDTH_BRUTE_FORCE 2048
+#define RANGE_BATCH_SIZE 64
 #define Z3_UNIQUE Z3_get_ast_hash // Z3_get_ast_id
 
 // #define PRINT_SAT
@@ -50,12 +53,20 @@
 #define ENABLE_AGGRESSIVE_OPTIMISTIC
 #define AVOID_GD_FALLBACK 0
 
-static int log_query_stats = 0;
-static int skip_notify     = 0;
+static int log_query_stats              = 0;
+static int skip_notify                  = 0;
+static int defer_notify                 = 0;
+static int skip_slicing                 = 1;
+static int skip_canonicalize            = 0;
+static int skip_abstract_interpretation = 0;
+static int use_dag_eval                 = 0;
+static int skip_dag_jit                 = 0;
 
 static int skip_reuse                   = 1;
 static int skip_input_to_state          = 0;
 static int skip_simple_math             = 0;
+static int skip_linear_math             = 0;
+static int skip_equality_chain          = 0;
 static int skip_input_to_state_extended = 0;
 static int skip_brute_force             = 0;
 static int skip_range_brute_force       = 0;
@@ -78,11 +89,16 @@ static int skip_afl_det_int32              = 0;
 static int skip_afl_det_flip_long          = 0;
 static int skip_afl_det_arith64            = 0;
 static int skip_afl_det_int64              = 0;
+static int skip_afl_dictionary             = 0;
 
 static int skip_freeze_neighbours = 1;
 static int skip_afl_havoc         = 0;
 static int use_greedy_mamin       = 0;
 static int check_unnecessary_eval = 1;
+static int gd_batch_gradient      = 0;
+static int gd_bisect              = 0;
+static int gd_momentum            = 0;
+static int gd_restart             = 0;
 
 static int max_ast_info_cache_size = 14000;
 
@@ -143,6 +159,89 @@ static ast_data_t     ast_data            = {0};
 static char           notify_count        = 0;
 static unsigned long  g_prev_num_evaluate = 0;
 
+// undo journal of tmp_input: every write goes through set_tmp_input(). While a
+// checkpoint is open, the first write of an index saves its previous value
+// (tmp_input_stamps holds the epoch of the checkpoint that saved it), so that
+// rolling back costs O(bytes changed)
+#define TMP_INPUT_MAX_CHECKPOINTS 16
+static da__input_patch_t tmp_input_journal;
+static unsigned*         tmp_input_stamps        = NULL;
+static unsigned          tmp_input_next_epoch    = 0;
+static unsigned          tmp_input_n_checkpoints = 0;
+static unsigned long     tmp_input_marks[TMP_INPUT_MAX_CHECKPOINTS];
+static unsigned          tmp_input_epochs[TMP_INPUT_MAX_CHECKPOINTS];
+// values tmp_input was reset to, NULL if it was written outside a checkpoint
+// (the journal does not hold all its differences from them)
+static unsigned long* tmp_input_base = NULL;
+
+// proofs are built in tmp_proof, that mirrors the seed (proof_seed) outside
+// the offsets in proof_patch. If the journal holds all the differences of
+// tmp_input from the seed, a proof costs O(bytes changed). The optimistic
+// solution is kept as opt_patch in the same case, and written in
+// tmp_opt_input/tmp_opt_proof only when they are needed (opt_lazy)
+static da__fuzzy_patch_t proof_patch;
+static unsigned long*    proof_seed = NULL;
+static da__input_patch_t opt_patch;
+static int               opt_lazy = 0;
+
+// per-query lookup of the learned intervals (index_to_group_intervals). An
+// entry is valid only if its epoch matches the current one, so that starting a
+// new query invalidates the whole table in O(1)
+static da__interval_group_ptr** index_intervals_lookup = NULL;
+static unsigned*                index_intervals_epoch  = NULL;
+static size_t                   index_intervals_size   = 0;
+static unsigned                 intervals_epoch        = 1;
+// intervals involving the inputs of the current query (see ast_data.inputs)
+static da__interval_group_ptr query_intervals;
+static int                    query_intervals_ready = 0;
+// flat copy of the groups of the current query (see ast_data.inputs), sorted
+// by first index. The phases iterate it instead of the buckets of the set
+static da__index_group_t query_groups;
+static int               query_groups_ready = 0;
+// all the inputs of the current query are 8-bit symbols (no wide symbols
+// added by z3fuzz_add_assignment): the group helpers use the unrolled
+// instantiations of BYTE_GROUP_HELPERS
+static int query_bytes_only = 0;
+// abstract values (see __abs_eval) of the subterms of the current branch
+// condition, keyed by ast id
+static dict__abs_value_t abs_values;
+// ranges of the input groups implied by the conjuncts of the current query and
+// branch condition, the only facts the abstract interpretation relies on
+static da__interval_group_t abs_facts;
+// independence slicing of the current query: the conjuncts that share inputs
+// (transitively) with the branch condition are evaluated first, the others
+// only on the candidates that satisfy them. slice_parent is the union-find
+// over the input indexes used to build the slice. slice_pos and rest_pos map
+// the conjuncts of the slice and of the rest to their position in the query,
+// so that the depth is still counted in the order of the query
+// Off by default (Z3FUZZ_SKIP_SLICING=0 enables it): building the slice costs
+// more than the evaluations it saves on the traces measured so far
+static Z3_ast    sliced_query = NULL;
+static Z3_ast    query_slice  = NULL;
+static Z3_ast    query_rest   = NULL;
+static unsigned* slice_parent = NULL;
+static uint32_t* slice_pos    = NULL;
+static uint32_t* rest_pos     = NULL;
+static uint32_t  slice_size   = 0;
+static uint32_t  rest_size    = 0;
+// the current query compiled as a DAG (Z3FUZZ_DAG_EVAL): every subterm has a
+// dense id and is evaluated once per candidate. Only the roots registered when
+// the query is prepared use it, any other ast goes through ctx->model_eval.
+// A root evaluated DAG_JIT_THRESHOLD times is compiled to native code
+#define QUERY_DAG_MAX_ROOTS 4
+#define DAG_JIT_THRESHOLD 1000
+static dag_program_t* query_dag = NULL;
+static Z3_ast         query_dag_asts[QUERY_DAG_MAX_ROOTS];
+static int            query_dag_roots[QUERY_DAG_MAX_ROOTS];
+static unsigned long  query_dag_evals[QUERY_DAG_MAX_ROOTS];
+static dag_jit_fn_t   query_dag_jit[QUERY_DAG_MAX_ROOTS];
+static unsigned       query_dag_n_roots = 0;
+// asts compiled in the query DAG only to be probed (the objectives of the gd),
+// referenced until the DAG is released so that Z3 does not recycle their ids
+#define QUERY_DAG_MAX_PINNED 8
+static Z3_ast   query_dag_pinned[QUERY_DAG_MAX_PINNED];
+static unsigned query_dag_n_pinned = 0;
+
 static char* query_log_filename = "/tmp/fuzzy-log-info.csv";
 FILE*        query_log;
 
@@ -256,6 +355,106 @@ static long interesting64[] = {
 
 #define TIMEOUT_V 0xffff
 
+static inline void __journal_tmp_input(unsigned long index)
+{
+    unsigned epoch = tmp_input_epochs[tmp_input_n_checkpoints - 1];
+    if (tmp_input_stamps[index] == epoch)
+        return;
+
+    input_patch_t patch = {index, tmp_input[index]};
+    da_add_item__input_patch_t(&tmp_input_journal, patch);
+    tmp_input_stamps[index] = epoch;
+}
+
+static inline void set_tmp_input(unsigned long index, unsigned long value)
+{
+    if (tmp_input_n_checkpoints > 0)
+        __journal_tmp_input(index);
+    else
+        tmp_input_base = NULL;
+    tmp_input[index] = value;
+}
+
+// returns the id of the new checkpoint, to pass to rollback_tmp_input() or
+// release_tmp_input(). Both close the checkpoints opened after it as well
+static inline unsigned checkpoint_tmp_input()
+{
+    ASSERT_OR_ABORT(tmp_input_n_checkpoints < TMP_INPUT_MAX_CHECKPOINTS,
+                    "checkpoint_tmp_input(): too many checkpoints");
+    if (unlikely(++tmp_input_next_epoch == 0)) {
+        memset(tmp_input_stamps, 0, sizeof(unsigned) * index_intervals_size);
+        tmp_input_next_epoch = 1;
+    }
+    tmp_input_marks[tmp_input_n_checkpoints]  = tmp_input_journal.size;
+    tmp_input_epochs[tmp_input_n_checkpoints] = tmp_input_next_epoch;
+    return tmp_input_n_checkpoints++;
+}
+
+static inline void rollback_tmp_input(unsigned checkpoint)
+{
+    unsigned long mark = tmp_input_marks[checkpoint];
+    while (tmp_input_journal.size > mark) {
+        input_patch_t* patch =
+            &tmp_input_journal.data[--tmp_input_journal.size];
+        tmp_input[patch->index] = patch->value;
+    }
+    tmp_input_n_checkpoints = checkpoint;
+}
+
+// close the checkpoint keeping the changes
+static inline void release_tmp_input(unsigned checkpoint)
+{
+    tmp_input_n_checkpoints = checkpoint;
+    if (checkpoint == 0 && tmp_input_journal.size > 0) {
+        tmp_input_journal.size = 0;
+        tmp_input_base         = NULL;
+    }
+}
+
+// undo the changes made after the checkpoint, leaving it open
+static inline void undo_tmp_input(unsigned checkpoint)
+{
+    rollback_tmp_input(checkpoint);
+    checkpoint_tmp_input();
+}
+
+static inline void reset_tmp_input(unsigned long* values, unsigned long n)
+{
+    memcpy(tmp_input, values, n * sizeof(unsigned long));
+    tmp_input_journal.size  = 0;
+    tmp_input_n_checkpoints = 0;
+    tmp_input_base          = values;
+}
+
+static inline unsigned long __query_dag_eval(unsigned i, unsigned long* values,
+                                             uint32_t* depth)
+{
+    // the native code does not compute the depth
+    if (depth != NULL)
+        return dag_eval(query_dag, query_dag_roots[i], values, depth);
+
+    if (query_dag_jit[i] != NULL)
+        return query_dag_jit[i](values, query_dag->values);
+    if (++query_dag_evals[i] == DAG_JIT_THRESHOLD && !skip_dag_jit)
+        query_dag_jit[i] = dag_jit_compile(query_dag, query_dag_roots[i]);
+    return dag_eval(query_dag, query_dag_roots[i], values, NULL);
+}
+
+static inline unsigned long __model_eval(fuzzy_ctx_t* ctx, Z3_ast e,
+                                         unsigned long* values,
+                                         unsigned char* value_sizes,
+                                         unsigned long n_values,
+                                         uint32_t*      depth)
+{
+    unsigned i;
+    for (i = 0; i < query_dag_n_roots; ++i)
+        if (query_dag_asts[i] == e)
+            return __query_dag_eval(i, values, depth);
+
+    return ctx->model_eval(ctx->z3_ctx, e, values, value_sizes, n_values,
+                           depth);
+}
+
 static inline int timer_check_wrapper(fuzzy_ctx_t* ctx)
 {
     if (ctx->timer == NULL)
@@ -290,6 +489,7 @@ static inline void timer_start_wrapper(fuzzy_ctx_t* ctx)
 #define RESEED_RNG 10000
 static int             dev_urandom_fd = -1;
 static unsigned        rand_cnt       = 1;
+static pid_t           snapshot_pid   = 0;
 static inline unsigned UR(unsigned limit)
 {
     if (unlikely(!rand_cnt--)) {
@@ -367,6 +567,7 @@ static inline void ast_data_free(ast_data_t* ast_data)
 static void __reset_ast_data();
 static void detect_involved_inputs_wrapper(fuzzy_ctx_t* ctx, Z3_ast v,
                                            ast_info_ptr* data);
+static int  __query_dag_pin(Z3_ast e);
 
 typedef struct mapping_subel_t {
     unsigned      idx;
@@ -387,6 +588,8 @@ typedef struct eval_wapper_ctx_t {
     unsigned       ast_sort_size;
     Z3_ast         pi;
     Z3_ast         ast;
+    int            dag_pi;  // nodes in the query DAG, -1 if not compiled
+    int            dag_ast;
     fuzzy_ctx_t*   fctx;
 } eval_wapper_ctx_t;
 
@@ -402,21 +605,38 @@ static void __gd_fix_tmp_input(unsigned long* x)
         for (j = 0; j < mel->n; ++j) {
             mapping_subel_t* sel   = &mel->subels[j];
             unsigned long    value = (x[i] & sel->mask) >> sel->shift;
-            tmp_input[sel->idx]    = value & 0xff;
+            set_tmp_input(sel->idx, value & 0xff);
         }
     }
 }
 
-static void __gd_restore_tmp_input(testcase_t* t)
+static inline void __gd_fix_tmp_input_el(mapping_el_t* mel, unsigned long v)
 {
-    unsigned i, j;
-    for (i = 0; i < eval_ctx->mapping_size; ++i) {
-        mapping_el_t* mel = &eval_ctx->mapping[i];
-        for (j = 0; j < mel->n; ++j) {
-            mapping_subel_t* sel = &mel->subels[j];
-            tmp_input[sel->idx]  = t->values[sel->idx];
-        }
+    unsigned j;
+    for (j = 0; j < mel->n; ++j) {
+        mapping_subel_t* sel = &mel->subels[j];
+        set_tmp_input(sel->idx, ((v & sel->mask) >> sel->shift) & 0xff);
+    }
+}
+
+static unsigned long __gd_eval_tmp_input()
+{
+    testcase_t* seed_testcase = &eval_ctx->fctx->testcases.data[0];
+
+    if (eval_ctx->check_pi_eval) {
+        unsigned long pi_eval = __model_eval(
+            eval_ctx->fctx, eval_ctx->pi, tmp_input,
+            seed_testcase->value_sizes, seed_testcase->values_len, NULL);
+
+        if (!pi_eval)
+            return 0x7fffffffffffffff;
     }
+
+    unsigned long res = __model_eval(
+        eval_ctx->fctx, eval_ctx->ast, tmp_input, seed_testcase->value_sizes,
+        seed_testcase->values_len, NULL);
+    eval_ctx->fctx->stats.num_evaluate++;
+    return res;
 }
 
 static unsigned long __gd_eval(unsigned long* x, int* should_exit)
@@ -428,23 +648,92 @@ static unsigned long __gd_eval(unsigned long* x, int* should_exit)
         return 0;
     }
 
-    testcase_t* seed_testcase = &eval_ctx->fctx->testcases.data[0];
     __gd_fix_tmp_input(x);
+    return __gd_eval_tmp_input();
+}
 
-    if (eval_ctx->check_pi_eval) {
-        unsigned long pi_eval = eval_ctx->fctx->model_eval(
-            eval_ctx->fctx->z3_ctx, eval_ctx->pi, tmp_input,
-            seed_testcase->value_sizes, seed_testcase->values_len, NULL);
+static unsigned long __gd_probe_tmp_input(mapping_el_t* mel, unsigned long v)
+{
+    uint32_t changed[8];
+    unsigned j;
+    for (j = 0; j < mel->n; ++j)
+        changed[j] = mel->subels[j].idx;
+    __gd_fix_tmp_input_el(mel, v);
+
+    if (eval_ctx->check_pi_eval &&
+        !dag_eval_probe(query_dag, eval_ctx->dag_pi, tmp_input, changed,
+                        mel->n))
+        return 0x7fffffffffffffff;
+
+    unsigned long res = dag_eval_probe(query_dag, eval_ctx->dag_ast, tmp_input,
+                                       changed, mel->n);
+    eval_ctx->fctx->stats.num_evaluate++;
+    return res;
+}
 
-        if (!pi_eval)
-            return 0x7fffffffffffffff;
+static int __gd_eval_gradient(unsigned long* x, uint32_t n,
+                              unsigned long* f_plus, unsigned long* f_minus)
+{
+    // the probes differ from x in a single group: write x once and patch
+    // only the bytes of the group that is moving. If the function is in the
+    // query DAG, a probe recomputes only the nodes that depend on the group
+    uint32_t i;
+    int      use_dag = eval_ctx->dag_ast >= 0;
+    if (eval_ctx->check_pi_eval && eval_ctx->dag_pi < 0)
+        use_dag = 0;
+    __gd_fix_tmp_input(x);
+    if (use_dag)
+        dag_probe_begin(query_dag);
+    for (i = 0; i < n; ++i) {
+        if (timer_check_wrapper(eval_ctx->fctx)) {
+            eval_ctx->fctx->stats.num_timeouts++;
+            if (use_dag)
+                dag_probe_end(query_dag);
+            return 0;
+        }
+
+        mapping_el_t* mel = &eval_ctx->mapping[i];
+        if (use_dag) {
+            f_plus[i]  = __gd_probe_tmp_input(mel, x[i] + 1);
+            f_minus[i] = __gd_probe_tmp_input(mel, x[i] - 1);
+        } else {
+            __gd_fix_tmp_input_el(mel, x[i] + 1);
+            f_plus[i] = __gd_eval_tmp_input();
+            __gd_fix_tmp_input_el(mel, x[i] - 1);
+            f_minus[i] = __gd_eval_tmp_input();
+        }
+        __gd_fix_tmp_input_el(mel, x[i]);
     }
+    if (use_dag)
+        dag_probe_end(query_dag);
+    return 1;
+}
 
-    unsigned long res = eval_ctx->fctx->model_eval(
-        eval_ctx->fctx->z3_ctx, eval_ctx->ast, tmp_input,
-        seed_testcase->value_sizes, seed_testcase->values_len, NULL);
-    eval_ctx->fctx->stats.num_evaluate++;
-    return res;
+static int compare_index_groups(const void* v1, const void* v2)
+{
+    const index_group_t* g1 = (const index_group_t*)v1;
+    const index_group_t* g2 = (const index_group_t*)v2;
+    if (g1->indexes[0] != g2->indexes[0])
+        return g1->indexes[0] < g2->indexes[0] ? -1 : 1;
+    return (int)g1->n - (int)g2->n;
+}
+
+static da__index_group_t* __get_query_groups()
+{
+    if (likely(query_groups_ready))
+        return &query_groups;
+
+    da_remove_all__index_group_t(&query_groups, NULL);
+
+    index_group_t* g;
+    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
+    while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0, &g))
+        da_add_item__index_group_t(&query_groups, *g);
+    qsort(query_groups.data, query_groups.size, sizeof(index_group_t),
+          compare_index_groups);
+
+    query_groups_ready = 1;
+    return &query_groups;
 }
 
 static int __check_overlapping_groups()
@@ -453,11 +742,11 @@ static int __check_overlapping_groups()
     set__ulong s;
     set_init__ulong(&s, &index_hash, &index_equals);
 
-    index_group_t* g;
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
-    while (
-        set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0, &g)) {
-        int i;
+    da__index_group_t* groups = __get_query_groups();
+    unsigned long      gi;
+    for (gi = 0; gi < groups->size; ++gi) {
+        index_group_t* g = &groups->data[gi];
+        int            i;
         for (i = 0; i < g->n; ++i) {
             if (set_check__ulong(&s, g->indexes[i])) {
                 res = 1;
@@ -483,6 +772,13 @@ static int __gd_init_eval(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast expr,
     out_ctx->check_pi_eval = check_pi_eval;
     out_ctx->mapping       = NULL;
     out_ctx->input         = NULL;
+    out_ctx->dag_pi        = -1;
+    out_ctx->dag_ast       = -1;
+    if (gd_batch_gradient) {
+        out_ctx->dag_ast = __query_dag_pin(expr);
+        if (check_pi_eval)
+            out_ctx->dag_pi = __query_dag_pin(pi);
+    }
 
     Z3_inc_ref(ctx->z3_ctx, out_ctx->ast);
     Z3_inc_ref(ctx->z3_ctx, out_ctx->pi);
@@ -845,9 +1141,18 @@ static void init_config_params()
 {
     env_get_or_die(&log_query_stats, getenv("Z3FUZZ_LOG_QUERY_STATS"));
     env_get_or_die(&skip_notify, getenv("Z3FUZZ_SKIP_NOTIFY"));
+    env_get_or_die(&defer_notify, getenv("Z3FUZZ_DEFER_NOTIFY"));
+    env_get_or_die(&skip_slicing, getenv("Z3FUZZ_SKIP_SLICING"));
+    env_get_or_die(&skip_canonicalize, getenv("Z3FUZZ_SKIP_CANONICALIZE"));
+    env_get_or_die(&skip_abstract_interpretation,
+                   getenv("Z3FUZZ_SKIP_ABSTRACT_INTERPRETATION"));
+    env_get_or_die(&use_dag_eval, getenv("Z3FUZZ_DAG_EVAL"));
+    env_get_or_die(&skip_dag_jit, getenv("Z3FUZZ_SKIP_DAG_JIT"));
     env_get_or_die(&skip_reuse, getenv("Z3FUZZ_SKIP_REUSE"));
     env_get_or_die(&skip_input_to_state, getenv("Z3FUZZ_SKIP_INPUT_TO_STATE"));
     env_get_or_die(&skip_simple_math, getenv("Z3FUZZ_SKIP_SIMPLE_MATH"));
+    env_get_or_die(&skip_linear_math, getenv("Z3FUZZ_SKIP_LINEAR_MATH"));
+    env_get_or_die(&skip_equality_chain, getenv("Z3FUZZ_SKIP_EQUALITY_CHAIN"));
     env_get_or_die(&skip_input_to_state_extended,
                    getenv("Z3FUZZ_SKIP_INPUT_TO_STATE_EXTENDED"));
     env_get_or_die(&skip_brute_force, getenv("Z3FUZZ_SKIP_BRUTE_FORCE"));
@@ -875,12 +1180,17 @@ static void init_config_params()
     env_get_or_die(&skip_afl_det_flip_long, getenv("Z3FUZZ_SKIP_FLIP_LONG"));
     env_get_or_die(&skip_afl_det_arith64, getenv("Z3FUZZ_SKIP_ARITH64"));
     env_get_or_die(&skip_afl_det_int64, getenv("Z3FUZZ_SKIP_INT64"));
+    env_get_or_die(&skip_afl_dictionary, getenv("Z3FUZZ_SKIP_DICTIONARY"));
     env_get_or_die(&skip_afl_havoc, getenv("Z3FUZZ_SKIP_HAVOC"));
     env_get_or_die(&skip_gradient_descend,
                    getenv("Z3FUZZ_SKIP_GRADIENT_DESCEND"));
     env_get_or_die(&use_greedy_mamin, getenv("Z3FUZZ_USE_GREEDY_MAMIN"));
     env_get_or_die(&check_unnecessary_eval,
                    getenv("Z3FUZZ_CHECK_UNNECESSARY_EVAL"));
+    env_get_or_die(&gd_batch_gradient, getenv("Z3FUZZ_GD_BATCH_GRADIENT"));
+    env_get_or_die(&gd_bisect, getenv("Z3FUZZ_GD_BISECT"));
+    env_get_or_die(&gd_momentum, getenv("Z3FUZZ_GD_MOMENTUM"));
+    env_get_or_die(&gd_restart, getenv("Z3FUZZ_GD_RESTART"));
 }
 
 static int  g_global_ctx_initialized = 0;
@@ -906,6 +1216,29 @@ static void init_global_context(size_t input_size)
                 tmp_opt_proof, sizeof(unsigned char) * input_size);
             ASSERT_OR_ABORT(tmp_opt_proof,
                             "init_global_context(): realloc failed");
+            index_intervals_lookup = (da__interval_group_ptr**)realloc(
+                index_intervals_lookup,
+                sizeof(da__interval_group_ptr*) * input_size);
+            ASSERT_OR_ABORT(index_intervals_lookup,
+                            "init_global_context(): realloc failed");
+            index_intervals_epoch = (unsigned*)realloc(
+                index_intervals_epoch, sizeof(unsigned) * input_size);
+            ASSERT_OR_ABORT(index_intervals_epoch,
+                            "init_global_context(): realloc failed");
+            memset(index_intervals_epoch + current_input_size, 0,
+                   sizeof(unsigned) * (input_size - current_input_size));
+            slice_parent = (unsigned*)realloc(slice_parent,
+                                              sizeof(unsigned) * input_size);
+            ASSERT_OR_ABORT(slice_parent,
+                            "init_global_context(): realloc failed");
+            tmp_input_stamps = (unsigned*)realloc(
+                tmp_input_stamps, sizeof(unsigned) * input_size);
+            ASSERT_OR_ABORT(tmp_input_stamps,
+                            "init_global_context(): realloc failed");
+            memset(tmp_input_stamps + current_input_size, 0,
+                   sizeof(unsigned) * (input_size - current_input_size));
+            current_input_size   = input_size;
+            index_intervals_size = input_size;
         }
         return;
     }
@@ -919,6 +1252,25 @@ static void init_global_context(size_t input_size)
     ASSERT_OR_ABORT(tmp_proof, "init_global_context(): malloc failed");
     tmp_opt_proof = (unsigned char*)malloc(sizeof(unsigned char) * input_size);
     ASSERT_OR_ABORT(tmp_opt_proof, "init_global_context(): malloc failed");
+    index_intervals_lookup = (da__interval_group_ptr**)malloc(
+        sizeof(da__interval_group_ptr*) * input_size);
+    ASSERT_OR_ABORT(index_intervals_lookup,
+                    "init_global_context(): malloc failed");
+    index_intervals_epoch = (unsigned*)calloc(input_size, sizeof(unsigned));
+    ASSERT_OR_ABORT(index_intervals_epoch,
+                    "init_global_context(): malloc failed");
+    index_intervals_size = input_size;
+    slice_parent = (unsigned*)malloc(sizeof(unsigned) * input_size);
+    ASSERT_OR_ABORT(slice_parent, "init_global_context(): malloc failed");
+    tmp_input_stamps = (unsigned*)calloc(input_size, sizeof(unsigned));
+    ASSERT_OR_ABORT(tmp_input_stamps, "init_global_context(): malloc failed");
+    da_init__input_patch_t(&tmp_input_journal);
+    da_init__fuzzy_patch_t(&proof_patch);
+    da_init__input_patch_t(&opt_patch);
+    da_init__interval_group_ptr(&query_intervals);
+    da_init__index_group_t(&query_groups);
+    dict_init__abs_value_t(&abs_values, NULL);
+    da_init__interval_group_t(&abs_facts);
 
     init_config_params();
     dev_urandom_fd = open("/dev/urandom", O_RDONLY);
@@ -934,10 +1286,78 @@ static void init_global_context(size_t input_size)
 
     ast_data_init(&ast_data);
     gd_init();
+    if (gd_batch_gradient)
+        gd_set_gradient_eval(__gd_eval_gradient);
+    gd_set_optimizer((gd_bisect ? GD_OPT_BISECT : 0) |
+                     (gd_momentum ? GD_OPT_MOMENTUM : 0) |
+                     (gd_restart ? GD_OPT_RESTART : 0));
 
     g_global_ctx_initialized = 1;
 }
 
+// per-byte facts of a context, indexed by input index. The flags mirror
+// univocally_defined_inputs and the keys of index_to_group_intervals, so that
+// the hot paths test a byte instead of hashing the index
+#define BYTE_UNIVOCALLY_DEFINED 1
+#define BYTE_HAS_INTERVALS 2
+
+typedef struct byte_meta_t {
+    unsigned char* flags;
+    unsigned long  size;
+} byte_meta_t;
+
+static void __byte_meta_grow(fuzzy_ctx_t* ctx, unsigned long size)
+{
+    byte_meta_t* meta = (byte_meta_t*)ctx->byte_meta;
+    if (size <= meta->size)
+        return;
+
+    meta->flags = (unsigned char*)realloc(meta->flags, size);
+    ASSERT_OR_ABORT(meta->flags != NULL, "__byte_meta_grow(): realloc failed");
+    memset(meta->flags + meta->size, 0, size - meta->size);
+    meta->size = size;
+}
+
+static void __byte_meta_init(fuzzy_ctx_t* ctx, unsigned long size)
+{
+    ctx->byte_meta = calloc(1, sizeof(byte_meta_t));
+    ASSERT_OR_ABORT(ctx->byte_meta != NULL,
+                    "__byte_meta_init(): calloc failed");
+    __byte_meta_grow(ctx, size);
+}
+
+static void __byte_meta_free(fuzzy_ctx_t* ctx)
+{
+    byte_meta_t* meta = (byte_meta_t*)ctx->byte_meta;
+    free(meta->flags);
+    free(meta);
+    ctx->byte_meta = NULL;
+}
+
+static __always_inline unsigned char get_byte_meta(fuzzy_ctx_t*  ctx,
+                                                   unsigned long index)
+{
+    byte_meta_t* meta = (byte_meta_t*)ctx->byte_meta;
+    return likely(index < meta->size) ? meta->flags[index] : 0;
+}
+
+static inline void set_byte_meta(fuzzy_ctx_t* ctx, unsigned long index,
+                                 unsigned char flag)
+{
+    byte_meta_t* meta = (byte_meta_t*)ctx->byte_meta;
+    if (unlikely(index >= meta->size))
+        __byte_meta_grow(ctx, (index + 1) * 3 / 2);
+    meta->flags[index] |= flag;
+}
+
+static void clear_byte_meta(fuzzy_ctx_t* ctx, unsigned char flag)
+{
+    byte_meta_t*  meta = (byte_meta_t*)ctx->byte_meta;
+    unsigned long i;
+    for (i = 0; i < meta->size; ++i)
+        meta->flags[i] &= ~flag;
+}
+
 void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
                  char* testcase_path,
                  uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*, uint8_t*,
@@ -977,6 +1397,7 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
     set__ulong* univocally_defined_inputs =
         (set__ulong*)fctx->univocally_defined_inputs;
     set_init__ulong(univocally_defined_inputs, &index_hash, &index_equals);
+    __byte_meta_init(fctx, current_testcase->values_len);
 
     fctx->group_intervals = (void*)malloc(sizeof(set__interval_group_ptr));
     set__interval_group_ptr* group_intervals =
@@ -1006,6 +1427,12 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
     set__ulong* processed_constraints =
         (set__ulong*)fctx->processed_constraints;
     set_init__ulong(processed_constraints, index_hash, index_equals);
+
+    fctx->session      = NULL;
+    fctx->token_dict   = NULL;
+    fctx->shared_store = NULL;
+    fctx->deferred     = NULL;
+    fctx->canon_cache  = NULL;
 }
 
 fuzzy_ctx_t* z3fuzz_create(Z3_context ctx, char* seed_filename,
@@ -1037,15 +1464,167 @@ __attribute__((destructor)) static void release_global_context()
     tmp_proof = NULL;
     free(tmp_opt_proof);
     tmp_opt_proof = NULL;
+    free(index_intervals_lookup);
+    index_intervals_lookup = NULL;
+    free(index_intervals_epoch);
+    index_intervals_epoch = NULL;
+    free(slice_parent);
+    slice_parent = NULL;
+    free(tmp_input_stamps);
+    tmp_input_stamps = NULL;
+    da_free__input_patch_t(&tmp_input_journal, NULL);
+    da_free__fuzzy_patch_t(&proof_patch, NULL);
+    da_free__input_patch_t(&opt_patch, NULL);
+    da_free__interval_group_ptr(&query_intervals, NULL);
+    da_free__index_group_t(&query_groups, NULL);
+    dict_free__abs_value_t(&abs_values);
+    da_free__interval_group_t(&abs_facts, NULL);
 
     ast_data_free(&ast_data);
     gd_free();
 }
 
+// constants harvested from the notified constraints and from the solved
+// queries. The deterministic stages and havoc use them as tokens, similarly to
+// the auto extras of AFL
+#define TOKEN_DICT_MAX_SIZE 1024
+#define TOKEN_DICT_MAX_DET  64
+
+typedef struct token_dict_t {
+    da__token_t tokens;
+    dict__ulong lookup; // value -> position in tokens
+} token_dict_t;
+
+static void __token_dict_free(fuzzy_ctx_t* ctx)
+{
+    token_dict_t* dict = (token_dict_t*)ctx->token_dict;
+    if (dict == NULL)
+        return;
+
+    da_free__token_t(&dict->tokens, NULL);
+    dict_free__ulong(&dict->lookup);
+    free(dict);
+    ctx->token_dict = NULL;
+}
+
+typedef struct session_t {
+    da__Z3_ast          constraints;
+    da__session_frame_t frames;
+} session_t;
+
+// the learned state of a context before the first constraint of a frame that
+// modified it: popping the frame restores it, instead of notifying again the
+// whole stack. Conflicting asts are stored as (index, ast) pairs
+typedef struct learned_snapshot_t {
+    da__ulong            processed_constraints;
+    da__ulong            univocally_defined_inputs;
+    da__ulong            conflicting_indexes;
+    da__Z3_ast           conflicting_asts;
+    da__interval_group_t group_intervals;
+} learned_snapshot_t;
+
+static void __snapshot_free(fuzzy_ctx_t* ctx, learned_snapshot_t* snapshot)
+{
+    unsigned long i;
+    for (i = 0; i < snapshot->conflicting_asts.size; ++i)
+        Z3_dec_ref(ctx->z3_ctx, snapshot->conflicting_asts.data[i]);
+    da_free__ulong(&snapshot->processed_constraints, NULL);
+    da_free__ulong(&snapshot->univocally_defined_inputs, NULL);
+    da_free__ulong(&snapshot->conflicting_indexes, NULL);
+    da_free__Z3_ast(&snapshot->conflicting_asts, NULL);
+    da_free__interval_group_t(&snapshot->group_intervals, NULL);
+    free(snapshot);
+}
+
+static void __session_free(fuzzy_ctx_t* ctx)
+{
+    session_t* session = (session_t*)ctx->session;
+    if (session == NULL)
+        return;
+
+    unsigned long i;
+    for (i = 0; i < session->constraints.size; ++i)
+        Z3_dec_ref(ctx->z3_ctx, session->constraints.data[i]);
+    for (i = 0; i < session->frames.size; ++i) {
+        if (session->frames.data[i].query != NULL)
+            Z3_dec_ref(ctx->z3_ctx, session->frames.data[i].query);
+        if (session->frames.data[i].snapshot != NULL)
+            __snapshot_free(ctx, session->frames.data[i].snapshot);
+    }
+    da_free__Z3_ast(&session->constraints, NULL);
+    da_free__session_frame_t(&session->frames, NULL);
+    free(session);
+    ctx->session = NULL;
+}
+
+// facts learned by the contexts attached to a shared store, keyed by the
+// constraint they come from. A context uses a fact only when it analyzes the
+// same constraint, so the facts of a path never reach a context that did not
+// assert it, and popping a frame drops them with the rest of its learned
+// state. The contexts attached to a store share the Z3 context (the key is the
+// id of the constraint) and are used from a single thread
+struct z3fuzz_shared_store_t {
+    dict__shared_fact_t facts;
+};
+
+// constraints notified with Z3FUZZ_DEFER_NOTIFY=1. They are analyzed only when
+// a query involves one of their inputs
+typedef struct deferred_t {
+    da__Z3_ast       queued;   // holds a reference to each queued constraint
+    unsigned long    indexed;  // queued[indexed:] are not in by_index yet
+    dict__da__Z3_ast by_index; // input index -> queued constraints
+    set__ulong       analyzed;
+} deferred_t;
+
+static void __canon_cache_free(fuzzy_ctx_t* ctx)
+{
+    dict__canon_ast_t* cache = (dict__canon_ast_t*)ctx->canon_cache;
+    if (cache == NULL)
+        return;
+
+    dict_free__canon_ast_t(cache);
+    free(cache);
+    ctx->canon_cache = NULL;
+}
+
+static deferred_t* __deferred_get(fuzzy_ctx_t* ctx)
+{
+    deferred_t* deferred = (deferred_t*)ctx->deferred;
+    if (deferred == NULL) {
+        deferred = (deferred_t*)malloc(sizeof(deferred_t));
+        ASSERT_OR_ABORT(deferred != NULL, "__deferred_get(): failed malloc");
+        da_init__Z3_ast(&deferred->queued);
+        deferred->indexed = 0;
+        dict_init__da__Z3_ast(&deferred->by_index, da_Z3_ast_el_free);
+        set_init__ulong(&deferred->analyzed, index_hash, index_equals);
+        ctx->deferred = deferred;
+    }
+    return deferred;
+}
+
+static void __deferred_free(fuzzy_ctx_t* ctx)
+{
+    deferred_t* deferred = (deferred_t*)ctx->deferred;
+    if (deferred == NULL)
+        return;
+
+    unsigned long i;
+    for (i = 0; i < deferred->queued.size; ++i)
+        Z3_dec_ref(ctx->z3_ctx, deferred->queued.data[i]);
+    da_free__Z3_ast(&deferred->queued, NULL);
+    dict_free__da__Z3_ast(&deferred->by_index);
+    set_free__ulong(&deferred->analyzed, NULL);
+    free(deferred);
+    ctx->deferred = NULL;
+}
+
 void z3fuzz_free(fuzzy_ctx_t* ctx)
 {
     free(ctx->timer);
     free_testcase_list(ctx->z3_ctx, &ctx->testcases);
+    // the seed values can be reused by the allocator
+    proof_seed     = NULL;
+    tmp_input_base = NULL;
 
     unsigned int i;
     for (i = 0; i < ctx->n_symbols; ++i)
@@ -1078,6 +1657,7 @@ void z3fuzz_free(fuzzy_ctx_t* ctx)
         (set__ulong*)ctx->univocally_defined_inputs;
     set_free__ulong(univocally_defined_inputs, NULL);
     free(ctx->univocally_defined_inputs);
+    __byte_meta_free(ctx);
 
     set__interval_group_ptr* group_intervals =
         (set__interval_group_ptr*)ctx->group_intervals;
@@ -1088,6 +1668,11 @@ void z3fuzz_free(fuzzy_ctx_t* ctx)
         (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
     dict_free__da__interval_group_ptr(index_to_group_intervals);
     free(ctx->index_to_group_intervals);
+
+    __session_free(ctx);
+    __token_dict_free(ctx);
+    __deferred_free(ctx);
+    __canon_cache_free(ctx);
 }
 
 void z3fuzz_print_expr(fuzzy_ctx_t* ctx, Z3_ast e)
@@ -1114,6 +1699,88 @@ static inline void __vals_long_to_char(unsigned long* in_vals,
         out_vals[i] = (unsigned char)in_vals[i];
 }
 
+static inline void __patch_proof(unsigned long offset, unsigned long value)
+{
+    if (tmp_proof[offset] == (unsigned char)value)
+        return;
+
+    fuzzy_patch_t patch = {offset, (unsigned char)value};
+    da_add_item__fuzzy_patch_t(&proof_patch, patch);
+    tmp_proof[offset] = patch.value;
+}
+
+static int __patch_cmp(const void* a, const void* b)
+{
+    unsigned long off_a = ((fuzzy_patch_t*)a)->offset;
+    unsigned long off_b = ((fuzzy_patch_t*)b)->offset;
+    return off_a < off_b ? -1 : (off_a > off_b ? 1 : 0);
+}
+
+// write the proof of values in tmp_proof
+static void __set_proof(fuzzy_ctx_t* ctx, unsigned long* values)
+{
+    testcase_t*   t = &ctx->testcases.data[0];
+    unsigned long i;
+
+    if (proof_seed != t->values) {
+        __vals_long_to_char(t->values, tmp_proof, t->testcase_len);
+        proof_seed = t->values;
+    } else
+        for (i = 0; i < proof_patch.size; ++i) {
+            unsigned long offset = proof_patch.data[i].offset;
+            tmp_proof[offset]    = (unsigned char)t->values[offset];
+        }
+    proof_patch.size = 0;
+
+    if (values == tmp_input && tmp_input_base == t->values) {
+        for (i = 0; i < tmp_input_journal.size; ++i) {
+            unsigned long index = tmp_input_journal.data[i].index;
+            if (index < t->testcase_len)
+                __patch_proof(index, values[index]);
+        }
+        qsort(proof_patch.data, proof_patch.size, sizeof(fuzzy_patch_t),
+              __patch_cmp);
+    } else
+        for (i = 0; i < t->testcase_len; ++i)
+            __patch_proof(i, values[i]);
+}
+
+// keep values as optimistic solution
+static void __set_opt(fuzzy_ctx_t* ctx, unsigned long* values)
+{
+    testcase_t* t = &ctx->testcases.data[0];
+    if (values == tmp_input && tmp_input_base == t->values) {
+        unsigned long i;
+        opt_patch.size = 0;
+        for (i = 0; i < tmp_input_journal.size; ++i) {
+            input_patch_t patch = {tmp_input_journal.data[i].index, 0};
+            patch.value         = values[patch.index];
+            da_add_item__input_patch_t(&opt_patch, patch);
+        }
+        opt_lazy = 1;
+        return;
+    }
+
+    memcpy(tmp_opt_input, values, t->values_len * sizeof(unsigned long));
+    __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
+    opt_lazy = 0;
+}
+
+// write the optimistic solution in tmp_opt_input and tmp_opt_proof
+static void __materialize_opt(fuzzy_ctx_t* ctx)
+{
+    if (!opt_lazy)
+        return;
+
+    testcase_t*   t = &ctx->testcases.data[0];
+    unsigned long i;
+    memcpy(tmp_opt_input, t->values, t->values_len * sizeof(unsigned long));
+    for (i = 0; i < opt_patch.size; ++i)
+        tmp_opt_input[opt_patch.data[i].index] = opt_patch.data[i].value;
+    __vals_long_to_char(tmp_opt_input, tmp_opt_proof, t->testcase_len);
+    opt_lazy = 0;
+}
+
 static int __check_or_add_digest(set__digest_t* set, unsigned char* values,
                                  unsigned n)
 {
@@ -1146,9 +1813,50 @@ static int __check_or_add_digest(set__digest_t* set, unsigned char* values,
     return 0;
 }
 
+// group helpers for a fixed group size N, that the compiler fully unrolls.
+// They assume that every index holds a byte (see query_bytes_only)
+#define BYTE_GROUP_HELPERS(N)                                                  \
+    static __always_inline unsigned long __byte_group_to_value_##N(            \
+        const uint32_t* indexes, const unsigned long* values)                  \
+    {                                                                          \
+        unsigned long res = 0;                                                 \
+        int           i;                                                       \
+        for (i = 0; i < N; ++i)                                                \
+            res = (res << 8) | values[indexes[i]];                             \
+        return res;                                                            \
+    }                                                                          \
+    static __always_inline void __byte_group_set_value_##N(                    \
+        const uint32_t* indexes, unsigned long* values, uint64_t v)            \
+    {                                                                          \
+        int i;                                                                 \
+        for (i = N - 1; i >= 0; --i) {                                         \
+            values[indexes[i]] = v & 0xff;                                     \
+            v >>= 8;                                                           \
+        }                                                                      \
+    }
+
+BYTE_GROUP_HELPERS(2)
+BYTE_GROUP_HELPERS(4)
+BYTE_GROUP_HELPERS(8)
+
 static __always_inline unsigned long index_group_to_value(index_group_t* ig,
                                                           unsigned long* values)
 {
+    if (query_bytes_only) {
+        switch (ig->n) {
+            case 1:
+                return values[ig->indexes[0]];
+            case 2:
+                return __byte_group_to_value_2(ig->indexes, values);
+            case 4:
+                return __byte_group_to_value_4(ig->indexes, values);
+            case 8:
+                return __byte_group_to_value_8(ig->indexes, values);
+            default:
+                break;
+        }
+    }
+
     unsigned long res = 0;
     int           i;
     for (i = 0; i < ig->n; ++i)
@@ -1156,8 +1864,64 @@ static __always_inline unsigned long index_group_to_value(index_group_t* ig,
     return res;
 }
 
+static __always_inline void index_group_set_value(index_group_t* ig,
+                                                  unsigned long* values,
+                                                  uint64_t       v)
+{
+    if (query_bytes_only) {
+        switch (ig->n) {
+            case 1:
+                values[ig->indexes[0]] = v & 0xff;
+                return;
+            case 2:
+                __byte_group_set_value_2(ig->indexes, values, v);
+                return;
+            case 4:
+                __byte_group_set_value_4(ig->indexes, values, v);
+                return;
+            case 8:
+                __byte_group_set_value_8(ig->indexes, values, v);
+                return;
+            default:
+                break;
+        }
+    }
+
+    unsigned char k;
+    for (k = 0; k < ig->n; ++k)
+        values[ig->indexes[ig->n - k - 1]] = (v >> (k * 8)) & 0xff;
+}
+
 static int check_is_valid = 1;
 
+static inline void invalidate_intervals_lookup()
+{
+    if (unlikely(++intervals_epoch == 0)) {
+        // wrapped around, stale entries could match again
+        memset(index_intervals_epoch, 0,
+               sizeof(unsigned) * index_intervals_size);
+        intervals_epoch = 1;
+    }
+    query_intervals_ready = 0;
+}
+
+static __always_inline da__interval_group_ptr*
+get_index_intervals(fuzzy_ctx_t* ctx, unsigned long index)
+{
+    if (!(get_byte_meta(ctx, index) & BYTE_HAS_INTERVALS))
+        return NULL;
+
+    if (unlikely(index_intervals_epoch[index] != intervals_epoch)) {
+        dict__da__interval_group_ptr* index_to_group_intervals =
+            (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
+
+        index_intervals_epoch[index]  = intervals_epoch;
+        index_intervals_lookup[index] = dict_get_ref__da__interval_group_ptr(
+            index_to_group_intervals, index);
+    }
+    return index_intervals_lookup[index];
+}
+
 static __always_inline int is_valid_eval_index(fuzzy_ctx_t*   ctx,
                                                unsigned long  index,
                                                unsigned long* values,
@@ -1170,12 +1934,7 @@ static __always_inline int is_valid_eval_index(fuzzy_ctx_t*   ctx,
     if (unlikely(!check_is_valid))
         return 1;
     // check validity of index eval
-    dict__da__interval_group_ptr* index_to_group_intervals =
-        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
-
-    da__interval_group_ptr* list;
-    list =
-        dict_get_ref__da__interval_group_ptr(index_to_group_intervals, index);
+    da__interval_group_ptr* list = get_index_intervals(ctx, index);
     if (list == NULL)
         return 1;
 
@@ -1185,8 +1944,10 @@ static __always_inline int is_valid_eval_index(fuzzy_ctx_t*   ctx,
         el = list->data[i];
 
         unsigned long group_value = index_group_to_value(&el->group, values);
-        if (!wi_contains_element(&el->interval, group_value))
+        if (!wis_contains_element(&el->interval, group_value)) {
+            ctx->stats.num_invalid_eval++;
             return 0;
+        }
     }
     return 1;
 #endif
@@ -1211,30 +1972,127 @@ is_valid_eval_group(fuzzy_ctx_t* ctx, index_group_t* ig, unsigned long* values,
 #endif
 }
 
-static inline int __evaluate_branch_query(fuzzy_ctx_t* ctx, Z3_ast query,
-                                          Z3_ast         branch_condition,
-                                          unsigned long* values,
-                                          unsigned char* value_sizes,
-                                          unsigned long  n_values)
+static inline void __init_query_intervals(fuzzy_ctx_t* ctx)
 {
-    if (timer_check_wrapper(ctx)) {
-        ctx->stats.num_timeouts++;
-        return TIMEOUT_V;
+    da_remove_all__interval_group_ptr(&query_intervals, NULL);
+    query_intervals_ready = 1;
+    if (ast_data.inputs == NULL)
+        return;
+
+    ulong* p;
+    set_reset_iter__ulong(&ast_data.inputs->indexes, 0);
+    while (set_iter_next__ulong(&ast_data.inputs->indexes, 0, &p)) {
+        da__interval_group_ptr* list = get_index_intervals(ctx, *p);
+        if (list == NULL)
+            continue;
+
+        unsigned i, j;
+        for (i = 0; i < list->size; ++i) {
+            // an interval is reachable from all the indexes of its group
+            for (j = 0; j < query_intervals.size; ++j)
+                if (query_intervals.data[j] == list->data[i])
+                    break;
+            if (j == query_intervals.size)
+                da_add_item__interval_group_ptr(&query_intervals,
+                                                list->data[i]);
+        }
     }
+}
 
-    ctx->stats.num_evaluate++;
+static __always_inline int is_valid_eval_query(fuzzy_ctx_t*   ctx,
+                                               unsigned long* values)
+{
+#ifdef SKIP_IS_VALID_EVAL
+    return 1;
+#else
+    if (unlikely(!check_is_valid))
+        return 1;
+    if (unlikely(!query_intervals_ready))
+        __init_query_intervals(ctx);
 
-    if (check_unnecessary_eval)
-        if (__check_or_add_digest(&ast_data.processed_set,
-                                  (unsigned char*)values,
-                                  ctx->n_symbols * sizeof(unsigned long))) {
+    unsigned           i;
+    interval_group_ptr el;
+    for (i = 0; i < query_intervals.size; ++i) {
+        el = query_intervals.data[i];
+
+        unsigned long group_value = index_group_to_value(&el->group, values);
+        if (!wis_contains_element(&el->interval, group_value)) {
+            ctx->stats.num_invalid_eval++;
             return 0;
         }
+    }
+    return 1;
+#endif
+}
 
-    int      res;
+static inline int __evaluate_query_opt(fuzzy_ctx_t* ctx, Z3_ast query,
+                                       unsigned long* values,
+                                       unsigned char* value_sizes,
+                                       unsigned long  n_values)
+{
+    // the branch condition is true on values: evaluate the query and keep
+    // values as optimistic solution if it goes deeper than the previous one
     uint32_t depth;
-    res = (int)ctx->model_eval(ctx->z3_ctx, branch_condition, values,
-                               value_sizes, n_values, NULL);
+    int      res;
+    if (query == sliced_query) {
+        res = (int)__model_eval(ctx, query_slice, values, value_sizes,
+                                n_values, &depth);
+        if (res) {
+            // the first false conjunct of the query, if any, is in the rest
+            res = (int)__model_eval(ctx, query_rest, values, value_sizes,
+                                    n_values, &depth);
+            depth = res ? slice_size + rest_size
+                        : rest_pos[depth < rest_size ? depth : 0];
+        } else {
+            // the first false conjunct of the query is the one of the slice,
+            // unless a conjunct of the rest before it is false. Evaluate the
+            // rest only if the query can go deeper than the optimistic
+            // solution
+            depth = slice_pos[depth < slice_size ? depth : 0];
+            if (opt_found && depth <= opt_num_sat)
+                return 0;
+            uint32_t rest_depth;
+            if (!__model_eval(ctx, query_rest, values, value_sizes, n_values,
+                              &rest_depth)) {
+                rest_depth = rest_pos[rest_depth < rest_size ? rest_depth : 0];
+                if (rest_depth < depth)
+                    depth = rest_depth;
+            }
+        }
+    } else
+        res = (int)__model_eval(ctx, query, values, value_sizes, n_values,
+                                &depth);
+    if (!opt_found || depth > opt_num_sat) {
+        opt_found   = 1;
+        opt_num_sat = depth;
+        __set_opt(ctx, values);
+    }
+    return res;
+}
+
+static inline int __evaluate_branch_query(fuzzy_ctx_t* ctx, Z3_ast query,
+                                          Z3_ast         branch_condition,
+                                          unsigned long* values,
+                                          unsigned char* value_sizes,
+                                          unsigned long  n_values)
+{
+    if (timer_check_wrapper(ctx)) {
+        ctx->stats.num_timeouts++;
+        return TIMEOUT_V;
+    }
+
+    ctx->stats.num_evaluate++;
+
+    if (check_unnecessary_eval)
+        if (__check_or_add_digest(&ast_data.processed_set,
+                                  (unsigned char*)values,
+                                  ctx->n_symbols * sizeof(unsigned long))) {
+            return 0;
+        }
+
+    int res;
+    res = (int)__model_eval(ctx, branch_condition, values, value_sizes,
+                            n_values, NULL);
     if (res) {
 #if 0
         unsigned num_sat;
@@ -1248,17 +2106,13 @@ static inline int __evaluate_branch_query(fuzzy_ctx_t* ctx, Z3_ast query,
             __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
         }
 #else
-        res = (int)ctx->model_eval(ctx->z3_ctx, query, values, value_sizes,
-                                   n_values, &depth);
-        if (!opt_found || depth > opt_num_sat) {
-            testcase_t* t = &ctx->testcases.data[0];
-            opt_found     = 1;
-            opt_num_sat   = depth;
-            memcpy(tmp_opt_input, values,
-                   t->values_len * sizeof(unsigned long));
-            __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
-        }
+        res = __evaluate_query_opt(ctx, query, values, value_sizes, n_values);
 #endif
+        // phases like havoc and gd do not check the learned intervals on
+        // their own: a candidate that violates them still counts as
+        // optimistic solution, but it is not a model of the path
+        if (res && !is_valid_eval_query(ctx, values))
+            res = 0;
     }
     res = res != 0 ? 1 : 0;
     return res;
@@ -1440,7 +2294,7 @@ static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
 #ifdef DEBUG_DETECT_GROUP
                     Z3FUZZ_LOG("next_n: %d\n", next_n);
                     for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
+                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%x\n", i,
                                    ig->indexes[i]);
 #endif
 
@@ -1464,7 +2318,7 @@ static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
 
 #ifdef DEBUG_DETECT_GROUP
                     for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
+                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%x\n", i,
                                    ig->indexes[i]);
 #endif
                     break;
@@ -1536,7 +2390,7 @@ static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
                     Z3FUZZ_LOG("low: %lu, hig: %lu\n", low, hig);
                     Z3FUZZ_LOG("next_n: %d\n", next_n);
                     for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
+                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%x\n", i,
                                    ig->indexes[i]);
 #endif
 
@@ -1561,7 +2415,7 @@ static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
 
 #ifdef DEBUG_DETECT_GROUP
                     for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
+                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%x\n", i,
                                    ig->indexes[i]);
 #endif
                     free(tmp);
@@ -2150,9 +3004,8 @@ static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
                         // concat chain. commit
                         unsigned i, at_least_one = 0;
                         for (i = 0; i < group.n; ++i)
-                            if (!set_check__ulong(
-                                    (set__ulong*)ctx->univocally_defined_inputs,
-                                    group.indexes[i])) {
+                            if (!(get_byte_meta(ctx, group.indexes[i]) &
+                                  BYTE_UNIVOCALLY_DEFINED)) {
                                 set_add__ulong(&new_el->indexes,
                                                group.indexes[i]);
                                 at_least_one = 1;
@@ -2182,6 +3035,8 @@ static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
                             decl_kind == Z3_OP_BAND)
                             // extract op not within a group. Take note
                             new_el->input_extract_ops++;
+                        else if (decl_kind == Z3_OP_BADD)
+                            new_el->linear_arithmetic_operations++;
                     }
                     break;
                 }
@@ -2202,9 +3057,8 @@ static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
 
                     group.indexes[group.n++] = symbol_index;
 
-                    if (!set_check__ulong(
-                            (set__ulong*)ctx->univocally_defined_inputs,
-                            symbol_index)) {
+                    if (!(get_byte_meta(ctx, symbol_index) &
+                          BYTE_UNIVOCALLY_DEFINED)) {
                         set_add__index_group_t(&new_el->index_groups, group);
                         set_add__ulong(&new_el->indexes, symbol_index);
                     } else if (!da_check_el__ulong(
@@ -2219,7 +3073,10 @@ static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
                     goto FUN_END;
                 }
                 case Z3_OP_BLSHR:
-                case Z3_OP_BASHR:
+                case Z3_OP_BASHR: {
+                    new_el->input_extract_ops++;
+                    break;
+                }
                 case Z3_OP_BUDIV0:
                 case Z3_OP_BUDIV:
                 case Z3_OP_BUDIV_I:
@@ -2232,6 +3089,27 @@ static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
                 case Z3_OP_BSREM_I:
                 case Z3_OP_BSMOD: {
                     new_el->input_extract_ops++;
+                    new_el->nonlinear_arithmetic_operations++;
+                    break;
+                }
+                case Z3_OP_BSUB:
+                case Z3_OP_BNEG: {
+                    new_el->linear_arithmetic_operations++;
+                    break;
+                }
+                case Z3_OP_BMUL: {
+                    // linear if all the factors but one are constants
+                    unsigned n_terms = 0;
+                    for (i = 0; i < num_fields; ++i) {
+                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                        if (Z3_get_ast_kind(ctx->z3_ctx, child) !=
+                            Z3_NUMERAL_AST)
+                            n_terms++;
+                    }
+                    if (n_terms > 1)
+                        new_el->nonlinear_arithmetic_operations++;
+                    else
+                        new_el->linear_arithmetic_operations++;
                     break;
                 }
                 case Z3_OP_ITE: {
@@ -2439,15 +3317,209 @@ static void __detect_early_constants(fuzzy_ctx_t* ctx, Z3_ast v,
     return;
 }
 
-static inline unsigned long get_group_value_in_tmp_input(index_group_t* group)
+static token_dict_t* __token_dict_get(fuzzy_ctx_t* ctx)
 {
-    unsigned long res = 0;
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        res |= tmp_input[index] << (k * 8);
+    token_dict_t* dict = (token_dict_t*)ctx->token_dict;
+    if (dict == NULL) {
+        dict = (token_dict_t*)malloc(sizeof(token_dict_t));
+        ASSERT_OR_ABORT(dict != NULL, "__token_dict_get(): failed malloc");
+        da_init__token_t(&dict->tokens);
+        dict_init__ulong(&dict->lookup, NULL);
+        ctx->token_dict = dict;
+    }
+    return dict;
+}
+
+static void __token_dict_add(fuzzy_ctx_t* ctx, unsigned long value)
+{
+    token_dict_t*  dict = __token_dict_get(ctx);
+    unsigned long* pos  = dict_get_ref__ulong(&dict->lookup, value);
+    if (pos != NULL) {
+        dict->tokens.data[*pos].hits++;
+        return;
     }
-    return res;
+    if (dict->tokens.size >= TOKEN_DICT_MAX_SIZE)
+        return;
+
+    token_t token = {.value = value, .hits = 1};
+    dict_set__ulong(&dict->lookup, value, dict->tokens.size);
+    da_add_item__token_t(&dict->tokens, token);
+}
+
+static void __token_dict_add_values(fuzzy_ctx_t* ctx, values_t* values)
+{
+    unsigned long i;
+    for (i = 0; i < values->size; ++i)
+        __token_dict_add(ctx, values->data[i]);
+}
+
+static inline void __token_dict_harvest_numeral(fuzzy_ctx_t* ctx, Z3_ast e,
+                                                values_t* values)
+{
+    uint64_t v;
+    if (Z3_get_ast_kind(ctx->z3_ctx, e) != Z3_NUMERAL_AST ||
+        !Z3_get_numeral_uint64(ctx->z3_ctx, e, &v))
+        return; // constant bigger than 64
+    da_add_item__ulong(values, v);
+    da_add_item__ulong(values, v + 1);
+    da_add_item__ulong(values, v - 1);
+}
+
+// same constants as __detect_early_constants, but the notified constraints
+// are not screened by the phases: skip wide constants instead of aborting,
+// and visit shared subtrees once
+static void __token_dict_harvest_rec(fuzzy_ctx_t* ctx, Z3_ast v,
+                                     values_t* values, set__ulong* visited)
+{
+    if (Z3_get_ast_kind(ctx->z3_ctx, v) != Z3_APP_AST)
+        return;
+    unsigned long id = Z3_get_ast_id(ctx->z3_ctx, v);
+    if (set_check__ulong(visited, id))
+        return;
+    set_add__ulong(visited, id);
+
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, v);
+    Z3_decl_kind decl_kind =
+        Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app));
+    unsigned n_args = Z3_get_app_num_args(ctx->z3_ctx, app);
+    unsigned i;
+    switch (decl_kind) {
+        case Z3_OP_EXTRACT:
+        case Z3_OP_NOT:
+        case Z3_OP_ITE:
+            // unary forward (the condition of the ite)
+            __token_dict_harvest_rec(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                     values, visited);
+            break;
+        case Z3_OP_CONCAT:
+        case Z3_OP_OR:
+        case Z3_OP_AND:
+            for (i = 0; i < n_args; ++i)
+                __token_dict_harvest_rec(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, i), values, visited);
+            break;
+        case Z3_OP_EQ:
+        case Z3_OP_UGEQ:
+        case Z3_OP_SGEQ:
+        case Z3_OP_UGT:
+        case Z3_OP_SGT:
+        case Z3_OP_ULEQ:
+        case Z3_OP_ULT:
+        case Z3_OP_SLT:
+        case Z3_OP_SLEQ:
+        case Z3_OP_BSUB:
+        case Z3_OP_BADD:
+        case Z3_OP_BAND: {
+            if (n_args < 2)
+                break;
+            Z3_ast child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            Z3_ast child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            if (Z3_get_ast_kind(ctx->z3_ctx, child1) == Z3_NUMERAL_AST)
+                __token_dict_harvest_numeral(ctx, child1, values);
+            else
+                __token_dict_harvest_numeral(ctx, child2, values);
+
+            if (decl_kind == Z3_OP_BSUB || decl_kind == Z3_OP_BADD ||
+                decl_kind == Z3_OP_BAND)
+                break;
+            // binary forward
+            __token_dict_harvest_rec(ctx, child1, values, visited);
+            __token_dict_harvest_rec(ctx, child2, values, visited);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void __token_dict_harvest(fuzzy_ctx_t* ctx, Z3_ast constraint)
+{
+    values_t   values;
+    set__ulong visited;
+    da_init__ulong(&values);
+    set_init__ulong(&visited, index_hash, index_equals);
+    __token_dict_harvest_rec(ctx, constraint, &values, &visited);
+    __token_dict_add_values(ctx, &values);
+    set_free__ulong(&visited, NULL);
+    da_free__ulong(&values, NULL);
+}
+
+// the number of bytes of the token, once truncated (sign or zero extended)
+static inline unsigned __token_width(unsigned long value)
+{
+    unsigned w;
+    for (w = 1; w < 8; w *= 2) {
+        unsigned long high = value & ~((1UL << (w * 8)) - 1);
+        if (high == 0 ||
+            (high == ~((1UL << (w * 8)) - 1) && (value >> (w * 8 - 1)) & 1))
+            return w;
+    }
+    return 8;
+}
+
+static inline int __token_dict_available(fuzzy_ctx_t* ctx)
+{
+    token_dict_t* dict = (token_dict_t*)ctx->token_dict;
+    return !skip_afl_dictionary &&
+           (ast_data.values.size > 0 || (dict && dict->tokens.size > 0));
+}
+
+// a constant of the query half of the times (if any), otherwise a token of
+// the dictionary, preferring the most frequent ones (best of two)
+static inline unsigned long __token_dict_pick(fuzzy_ctx_t* ctx)
+{
+    token_dict_t* dict   = (token_dict_t*)ctx->token_dict;
+    unsigned long n_dict = dict != NULL ? dict->tokens.size : 0;
+    if (ast_data.values.size > 0 && (n_dict == 0 || UR(2)))
+        return ast_data.values.data[UR(ast_data.values.size)];
+
+    token_t* a = &dict->tokens.data[UR(n_dict)];
+    token_t* b = &dict->tokens.data[UR(n_dict)];
+    return a->hits >= b->hits ? a->value : b->value;
+}
+
+static unsigned long det_tokens[TOKEN_DICT_MAX_DET];
+static unsigned      det_tokens_size;
+
+static int compare_token_hits(const void* v1, const void* v2)
+{
+    unsigned long h1 = ((token_t*)v1)->hits;
+    unsigned long h2 = ((token_t*)v2)->hits;
+    return h1 < h2 ? 1 : (h1 > h2 ? -1 : 0);
+}
+
+// tokens tried by the deterministic stage: the constants of the query,
+// followed by the most frequent tokens of the dictionary
+static void __det_tokens_prepare(fuzzy_ctx_t* ctx)
+{
+    det_tokens_size = 0;
+    if (skip_afl_dictionary)
+        return;
+
+    unsigned long i;
+    for (i = 0; i < ast_data.values.size; ++i) {
+        if (det_tokens_size == TOKEN_DICT_MAX_DET)
+            return;
+        det_tokens[det_tokens_size++] = ast_data.values.data[i];
+    }
+
+    token_dict_t* dict = (token_dict_t*)ctx->token_dict;
+    if (dict == NULL || dict->tokens.size == 0)
+        return;
+
+    token_t* sorted = (token_t*)malloc(sizeof(token_t) * dict->tokens.size);
+    ASSERT_OR_ABORT(sorted != NULL, "__det_tokens_prepare(): failed malloc");
+    memcpy(sorted, dict->tokens.data, sizeof(token_t) * dict->tokens.size);
+    qsort(sorted, dict->tokens.size, sizeof(token_t), compare_token_hits);
+    for (i = 0; i < dict->tokens.size && det_tokens_size < TOKEN_DICT_MAX_DET;
+         ++i)
+        det_tokens[det_tokens_size++] = sorted[i].value;
+    free(sorted);
+}
+
+static inline unsigned long get_group_value_in_tmp_input(index_group_t* group)
+{
+    return index_group_to_value(group, tmp_input);
 }
 
 static inline unsigned long
@@ -2470,12 +3542,13 @@ static inline unsigned char __extract_from_long(long value, unsigned int i)
 static inline void set_tmp_input_group_to_value(index_group_t* group,
                                                 uint64_t       v)
 {
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        unsigned char b     = __extract_from_long(v, k);
-        tmp_input[index]    = b;
-    }
+    if (tmp_input_n_checkpoints > 0) {
+        unsigned char k;
+        for (k = 0; k < group->n; ++k)
+            __journal_tmp_input(group->indexes[k]);
+    } else
+        tmp_input_base = NULL;
+    index_group_set_value(group, tmp_input, v);
 }
 
 static inline void set_tmp_input_group_to_value_inv(index_group_t* group,
@@ -2485,18 +3558,78 @@ static inline void set_tmp_input_group_to_value_inv(index_group_t* group,
     for (k = 0; k < group->n; ++k) {
         unsigned long index = group->indexes[k];
         unsigned char b     = __extract_from_long(v, k);
-        tmp_input[index]    = b;
+        set_tmp_input(index, b);
     }
 }
 
-static inline void restore_tmp_input_group(index_group_t* group,
-                                           unsigned long* vals)
+// evaluate the root i of the query DAG with the group ig of tmp_input set to
+// each of the n values (n <= 64). The probes recompute only the nodes that
+// depend on the group. Returns the mask of the values on which it is true
+static uint64_t __query_dag_probe_group(unsigned i, index_group_t* ig,
+                                        uint64_t* vals, unsigned n)
 {
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        tmp_input[index]    = vals[index];
+    uint32_t      changed[MAX_GROUP_SIZE];
+    uint64_t      mask = 0;
+    unsigned long orig = get_group_value_in_tmp_input(ig);
+    unsigned      j;
+    for (j = 0; j < ig->n; ++j)
+        changed[j] = ig->indexes[j];
+
+    dag_probe_begin(query_dag);
+    for (j = 0; j < n; ++j) {
+        index_group_set_value(ig, tmp_input, vals[j]);
+        if (dag_eval_probe(query_dag, query_dag_roots[i], tmp_input, changed,
+                           ig->n))
+            mask |= 1UL << j;
+    }
+    dag_probe_end(query_dag);
+    index_group_set_value(ig, tmp_input, orig);
+    return mask;
+}
+
+static int __range_bruteforce_group(fuzzy_ctx_t* ctx, Z3_ast query,
+                                    Z3_ast                   branch_condition,
+                                    index_group_t*           ig,
+                                    wrapped_interval_iter_t* it,
+                                    uint64_t                 max_values)
+{
+    // values are pulled from the iterator a batch at a time. If the branch
+    // condition is in the query DAG, the batch is filtered with probes of the
+    // group: only the values on which it is true go through
+    // __evaluate_branch_query (query, optimistic solution, learned intervals)
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    uint64_t    vals[RANGE_BATCH_SIZE];
+    uint64_t    n_tried = 0, branch_true = ~0UL;
+    unsigned    i, n, branch_root;
+
+    for (branch_root = 0; branch_root < query_dag_n_roots; ++branch_root)
+        if (query_dag_asts[branch_root] == branch_condition)
+            break;
+
+    while (n_tried < max_values &&
+           (n = wi_iter_get_next_batch(it, vals, RANGE_BATCH_SIZE)) > 0) {
+        if (n > max_values - n_tried)
+            n = max_values - n_tried;
+        if (branch_root < query_dag_n_roots) {
+            if (timer_check_wrapper(ctx)) {
+                ctx->stats.num_timeouts++;
+                return TIMEOUT_V;
+            }
+            branch_true = __query_dag_probe_group(branch_root, ig, vals, n);
+            ctx->stats.num_evaluate += n - __builtin_popcountll(branch_true);
+        }
+        for (i = 0; i < n; ++i, ++n_tried) {
+            if (!(branch_true >> i & 1))
+                continue;
+            set_tmp_input_group_to_value(ig, vals[i]);
+            int eval_v = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (eval_v != 0)
+                return eval_v;
+        }
     }
+    return 0;
 }
 
 static void __put_solutions_of_current_groups_to_early_constants(
@@ -2758,16 +3891,13 @@ static inline unsigned size_normalized(unsigned size)
     ABORT("size_normalized() - unexpected size");
 }
 
-static inline interval_group_ptr interval_group_set_add_or_modify(
-    set__interval_group_ptr* set, index_group_t* ig, uint64_t c, optype op,
-    uint64_t add_constant, uint64_t sub_constant, int should_invert,
-    uint32_t add_sub_const_size, uint32_t const_size, int* created_new)
+static inline wrapped_interval_set_t
+__range_to_intervals(index_group_t* ig, uint64_t c, optype op,
+                     uint64_t add_constant, uint64_t sub_constant,
+                     int should_invert, uint32_t add_sub_const_size,
+                     uint32_t const_size)
 {
-    ASSERT_OR_ABORT(op != -1,
-                    "interval_group_set_add_or_modify() invalid optype");
-    interval_group_t    igt     = {.group = *ig, .interval = {0}};
-    interval_group_ptr  igt_p   = &igt;
-    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
+    ASSERT_OR_ABORT(op != -1, "__range_to_intervals() invalid optype");
 
     wrapped_interval_t wi = wi_init(const_size);
     wi_update_cmp(&wi, c, op);
@@ -2785,9 +3915,25 @@ static inline interval_group_ptr interval_group_set_add_or_modify(
         }
     }
 
-    wi_modify_size(&wi, ig->n * 8);
+    // resize the set and not the interval: a wrapping interval would be
+    // overapproximated
+    wrapped_interval_set_t wis = wis_from_interval(&wi);
+    wis_modify_size(&wis, ig->n * 8);
+    return wis;
+}
+
+static inline interval_group_ptr
+interval_group_set_add_or_modify(set__interval_group_ptr*      set,
+                                 index_group_t*                ig,
+                                 const wrapped_interval_set_t* wis,
+                                 int*                          created_new)
+{
+    interval_group_t    igt     = {.group = *ig};
+    interval_group_ptr  igt_p   = &igt;
+    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
+
     if (igt_ptr != NULL) {
-        wi_intersect(&(*igt_ptr)->interval, &wi);
+        wis_intersect_set(&(*igt_ptr)->interval, wis);
         return *igt_ptr;
     } else {
         *created_new = 1;
@@ -2795,7 +3941,7 @@ static inline interval_group_ptr interval_group_set_add_or_modify(
             (interval_group_ptr)malloc(sizeof(interval_group_t));
         unsigned size    = ig->n;
         size             = size_normalized(size);
-        new_el->interval = wi;
+        new_el->interval = *wis;
         new_el->group    = *ig;
         set_add__interval_group_ptr(set, new_el);
         return new_el;
@@ -2819,10 +3965,10 @@ update_or_create_in_index_to_group_intervals(dict__da__interval_group_ptr* dict,
     }
 }
 
-static inline wrapped_interval_t*
+static inline wrapped_interval_set_t*
 interval_group_get_interval(set__interval_group_ptr* set, index_group_t* ig)
 {
-    interval_group_t    igt     = {.group = *ig, .interval = {0}};
+    interval_group_t    igt     = {.group = *ig};
     interval_group_ptr  igt_p   = &igt;
     interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
     if (igt_ptr != NULL)
@@ -2830,6 +3976,90 @@ interval_group_get_interval(set__interval_group_ptr* set, index_group_t* ig)
     return NULL;
 }
 
+static inline void __add_range_fact(fuzzy_ctx_t* ctx, index_group_t* ig,
+                                    const wrapped_interval_set_t* wis)
+{
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
+
+    dict__da__interval_group_ptr* index_to_group_intervals =
+        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
+
+    int                created_new = 0;
+    interval_group_ptr el = interval_group_set_add_or_modify(
+        group_intervals, ig, wis, &created_new);
+
+    if (created_new) {
+        unsigned i;
+        for (i = 0; i < ig->n; ++i) {
+            update_or_create_in_index_to_group_intervals(
+                index_to_group_intervals, ig->indexes[i], el);
+            set_byte_meta(ctx, ig->indexes[i], BYTE_HAS_INTERVALS);
+        }
+        // the insertion can rehash index_to_group_intervals: drop the cached
+        // references (notify, deferred analysis and imports end up here)
+        invalidate_intervals_lookup();
+    }
+}
+
+static void __shared_store_publish(fuzzy_ctx_t* ctx, Z3_ast constraint,
+                                   shared_fact_kind_t            kind,
+                                   index_group_t*                ig,
+                                   const wrapped_interval_set_t* wis)
+{
+    z3fuzz_shared_store_t* store = (z3fuzz_shared_store_t*)ctx->shared_store;
+    if (store == NULL)
+        return;
+
+    unsigned long id = Z3_get_ast_id(ctx->z3_ctx, constraint);
+    if (dict_get_ref__shared_fact_t(&store->facts, id) != NULL)
+        return;
+
+    shared_fact_t fact = {0};
+    fact.ctx           = ctx->z3_ctx;
+    fact.constraint    = constraint;
+    fact.kind          = kind;
+    if (ig != NULL)
+        fact.group = *ig;
+    if (wis != NULL)
+        fact.interval = *wis;
+    Z3_inc_ref(ctx->z3_ctx, constraint);
+    dict_set__shared_fact_t(&store->facts, id, fact);
+}
+
+static inline shared_fact_t* __shared_store_get(fuzzy_ctx_t* ctx,
+                                                Z3_ast       constraint)
+{
+    z3fuzz_shared_store_t* store = (z3fuzz_shared_store_t*)ctx->shared_store;
+    if (store == NULL)
+        return NULL;
+    return dict_get_ref__shared_fact_t(
+        &store->facts, Z3_get_ast_id(ctx->z3_ctx, constraint));
+}
+
+// add to the learned state of ctx a fact published by a context that analyzed
+// the same constraint. Returns 1 if the fact has the given kind
+static int __shared_fact_apply(fuzzy_ctx_t* ctx, shared_fact_t* fact,
+                               shared_fact_kind_t kind)
+{
+    if (fact->kind != kind)
+        return 0;
+
+    ctx->stats.num_shared_facts++;
+    if (kind == SHARED_FACT_RANGE) {
+        __add_range_fact(ctx, &fact->group, &fact->interval);
+        return 1;
+    }
+
+    unsigned i;
+    for (i = 0; i < fact->group.n; ++i) {
+        set_add__ulong((set__ulong*)ctx->univocally_defined_inputs,
+                       fact->group.indexes[i]);
+        set_byte_meta(ctx, fact->group.indexes[i], BYTE_UNIVOCALLY_DEFINED);
+    }
+    return 1;
+}
+
 static inline int __check_if_range(fuzzy_ctx_t* ctx, Z3_ast expr,
                                    // output args
                                    index_group_t* ig, uint64_t* constant,
@@ -2871,10 +4101,8 @@ static inline int __check_if_range(fuzzy_ctx_t* ctx, Z3_ast expr,
         decl_kind != Z3_OP_SGT && decl_kind != Z3_OP_UGT &&
         decl_kind != Z3_OP_EQ)
         goto END_FUN_1;
-    if (is_not && decl_kind == Z3_OP_EQ)
-        // could be extended...
-        goto END_FUN_1;
-    if (is_not)
+    int is_ne = is_not && decl_kind == Z3_OP_EQ;
+    if (is_not && !is_ne)
         decl_kind = get_opposite_decl_kind(decl_kind);
 
     // should be always the case
@@ -2986,7 +4214,7 @@ static inline int __check_if_range(fuzzy_ctx_t* ctx, Z3_ast expr,
     }
     // it is a range query!
     has_zext = 0;
-    *op      = __find_optype(decl_kind, const_operand, has_zext);
+    *op = is_ne ? OP_NE : __find_optype(decl_kind, const_operand, has_zext);
 
     res = 1;
 END_FUN_2:
@@ -2997,43 +4225,73 @@ END_FUN_1:
     return res;
 }
 
-static inline int __check_range_constraint(fuzzy_ctx_t* ctx, Z3_ast expr)
+static inline int __get_range_intervals(fuzzy_ctx_t* ctx, Z3_ast expr,
+                                        index_group_t*          ig,
+                                        wrapped_interval_set_t* wis)
 {
-    Z3_inc_ref(ctx->z3_ctx, expr);
-    int res = 0;
+    uint64_t constant, add_constant, sub_constant;
+    optype   op;
+    uint32_t add_sub_const_size;
+    unsigned const_size;
+    int      should_invert;
 
-    index_group_t ig = {0};
-    uint64_t      constant, add_constant, sub_constant;
-    optype        op = -1;
-    uint32_t      add_sub_const_size;
-    unsigned      const_size;
-    int           should_invert;
-
-    if (!__check_if_range(ctx, expr, &ig, &constant, &op, &add_constant,
-                          &sub_constant, &should_invert, &add_sub_const_size,
-                          &const_size)) {
-        goto OUT;
+    if (__check_if_range(ctx, expr, ig, &constant, &op, &add_constant,
+                         &sub_constant, &should_invert, &add_sub_const_size,
+                         &const_size)) {
+        if (const_size > 64)
+            return 0;
+        *wis = __range_to_intervals(ig, constant, op, add_constant,
+                                    sub_constant, should_invert,
+                                    add_sub_const_size, const_size);
+        return 1;
     }
-    if (const_size > 64)
-        goto OUT;
-
-    set__interval_group_ptr* group_intervals =
-        (set__interval_group_ptr*)ctx->group_intervals;
 
-    dict__da__interval_group_ptr* index_to_group_intervals =
-        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
+    // disjunction of ranges on the same group (e.g., x < 5 || x > 200)
+    if (Z3_get_ast_kind(ctx->z3_ctx, expr) != Z3_APP_AST)
+        return 0;
+    Z3_app app = Z3_to_app(ctx->z3_ctx, expr);
+    if (Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app)) !=
+        Z3_OP_OR)
+        return 0;
 
-    int                created_new;
-    interval_group_ptr el = interval_group_set_add_or_modify(
-        group_intervals, &ig, constant, op, add_constant, sub_constant,
-        should_invert, add_sub_const_size, const_size, &created_new);
+    unsigned i, num_args = Z3_get_app_num_args(ctx->z3_ctx, app);
+    for (i = 0; i < num_args; ++i) {
+        index_group_t          arg_ig = {0};
+        wrapped_interval_set_t arg_wis;
+        Z3_ast                 arg = Z3_get_app_arg(ctx->z3_ctx, app, i);
+        if (!__check_if_range(ctx, arg, &arg_ig, &constant, &op, &add_constant,
+                              &sub_constant, &should_invert,
+                              &add_sub_const_size, &const_size) ||
+            const_size > 64)
+            return 0;
 
-    if (created_new) {
-        unsigned i;
-        for (i = 0; i < ig.n; ++i)
-            update_or_create_in_index_to_group_intervals(
-                index_to_group_intervals, ig.indexes[i], el);
+        arg_wis = __range_to_intervals(&arg_ig, constant, op, add_constant,
+                                       sub_constant, should_invert,
+                                       add_sub_const_size, const_size);
+        if (i == 0) {
+            *ig  = arg_ig;
+            *wis = arg_wis;
+        } else if (!index_group_equals(ig, &arg_ig))
+            return 0;
+        else
+            wis_union(wis, &arg_wis);
     }
+    return num_args > 0;
+}
+
+static inline int __check_range_constraint(fuzzy_ctx_t* ctx, Z3_ast expr)
+{
+    Z3_inc_ref(ctx->z3_ctx, expr);
+    int res = 0;
+
+    index_group_t          ig = {0};
+    wrapped_interval_set_t wis;
+
+    if (!__get_range_intervals(ctx, expr, &ig, &wis))
+        goto OUT;
+
+    __add_range_fact(ctx, &ig, &wis);
+    __shared_store_publish(ctx, expr, SHARED_FACT_RANGE, &ig, &wis);
 
 #ifdef DEBUG_RANGE
     puts("+++++++++++++++++++++++++++++++++++++");
@@ -3049,47 +4307,21 @@ OUT:
 }
 
 static inline int get_range(fuzzy_ctx_t* ctx, Z3_ast expr, index_group_t* ig,
-                            wrapped_interval_t* wi)
+                            wrapped_interval_set_t* wis)
 {
     Z3_inc_ref(ctx->z3_ctx, expr);
     int res = 0;
 
-    uint64_t constant, add_constant, sub_constant;
-    optype   op;
-    uint32_t add_sub_const_size;
-    unsigned const_size;
-    int      should_invert;
-
-    if (!__check_if_range(ctx, expr, ig, &constant, &op, &add_constant,
-                          &sub_constant, &should_invert, &add_sub_const_size,
-                          &const_size))
+    if (!__get_range_intervals(ctx, expr, ig, wis))
         goto OUT;
 
     set__interval_group_ptr* group_intervals =
         (set__interval_group_ptr*)ctx->group_intervals;
 
-    *wi = wi_init(const_size);
-
-    wi_update_cmp(wi, constant, op);
-    if (add_constant > 0) {
-        wi_modify_size(wi, add_sub_const_size);
-        wi_update_sub(wi, add_constant);
-    }
-    if (sub_constant > 0) {
-        wi_modify_size(wi, add_sub_const_size);
-        if (!should_invert)
-            wi_update_add(wi, sub_constant);
-        else {
-            wi_update_invert(wi);
-            wi_update_add(wi, sub_constant);
-        }
-    }
-    wi_modify_size(wi, ig->n * 8);
-
-    const wrapped_interval_t* cached_wi =
+    const wrapped_interval_set_t* cached_wis =
         interval_group_get_interval(group_intervals, ig);
-    if (!performing_aggressive_optimistic && cached_wi != NULL)
-        wi_intersect(wi, cached_wi);
+    if (!performing_aggressive_optimistic && cached_wis != NULL)
+        wis_intersect_set(wis, cached_wis);
 
     res = 1;
 OUT:
@@ -3146,7 +4378,10 @@ static inline int __check_univocally_defined(fuzzy_ctx_t* ctx, Z3_ast expr)
     for (i = 0; i < ig->n; ++i) {
         set_add__ulong((set__ulong*)ctx->univocally_defined_inputs,
                        ig->indexes[i]);
+        set_byte_meta(ctx, ig->indexes[i], BYTE_UNIVOCALLY_DEFINED);
     }
+    __shared_store_publish(ctx, expr, SHARED_FACT_UNIVOCALLY_DEFINED, ig,
+                           NULL);
     return 1;
 }
 
@@ -3296,23 +4531,619 @@ static inline void __reset_ast_data()
     ast_data.inputs                 = NULL;
     ast_data.input_to_state_group.n = 0;
     ast_data.n_useless_eval         = 0;
+    query_intervals_ready           = 0;
+    query_groups_ready              = 0;
 }
 
-static inline void __init_global_data(fuzzy_ctx_t* ctx, Z3_ast query,
-                                      Z3_ast branch_condition)
+static void __analyze_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
+{
+    // a constraint analyzed by another context attached to the shared store
+    // is not analyzed again (the conflicting asts are not shared)
+    shared_fact_t* fact = __shared_store_get(ctx, constraint);
+    if (fact != NULL
+            ? __shared_fact_apply(ctx, fact, SHARED_FACT_UNIVOCALLY_DEFINED)
+            : __check_univocally_defined(ctx, constraint)) {
+        ctx->stats.num_univocally_defined++;
+
+        // invalidate ast_info_cache
+        dict__ast_info_ptr* ast_info_cache =
+            (dict__ast_info_ptr*)ctx->ast_info_cache;
+        dict_remove_all__ast_info_ptr(ast_info_cache);
+    } else {
+        ctx->stats.num_conflicting +=
+            __check_conflicting_constraint(ctx, constraint);
+
+        ctx->stats.num_range_constraints +=
+            fact != NULL ? __shared_fact_apply(ctx, fact, SHARED_FACT_RANGE)
+                         : __check_range_constraint(ctx, constraint);
+    }
+    if (fact == NULL)
+        __shared_store_publish(ctx, constraint, SHARED_FACT_NONE, NULL, NULL);
+
+    if (!skip_afl_dictionary)
+        __token_dict_harvest(ctx, constraint);
+}
+
+static inline void __deferred_analyze(fuzzy_ctx_t* ctx, deferred_t* deferred,
+                                      Z3_ast constraint)
+{
+    unsigned long hash = Z3_UNIQUE(ctx->z3_ctx, constraint);
+    if (set_check__ulong(&deferred->analyzed, hash))
+        return;
+    set_add__ulong(&deferred->analyzed, hash);
+    __analyze_constraint(ctx, constraint);
+}
+
+// analyze the queued constraints that involve the inputs of expr
+static void __deferred_process(fuzzy_ctx_t* ctx, Z3_ast expr)
+{
+    deferred_t* deferred = (deferred_t*)ctx->deferred;
+    if (deferred == NULL || deferred->analyzed.size == deferred->queued.size)
+        return;
+
+    unsigned long  i, j;
+    unsigned long* idx;
+    ast_info_ptr   inputs;
+    for (; deferred->indexed < deferred->queued.size; ++deferred->indexed) {
+        Z3_ast constraint = deferred->queued.data[deferred->indexed];
+        detect_involved_inputs_wrapper(ctx, constraint, &inputs);
+        if (inputs->indexes.size == 0) {
+            __deferred_analyze(ctx, deferred, constraint);
+            continue;
+        }
+
+        set_reset_iter__ulong(&inputs->indexes, 0);
+        while (set_iter_next__ulong(&inputs->indexes, 0, &idx)) {
+            da__Z3_ast* list =
+                dict_get_ref__da__Z3_ast(&deferred->by_index, *idx);
+            if (list == NULL) {
+                da__Z3_ast new_list;
+                da_init__Z3_ast(&new_list);
+                da_add_item__Z3_ast(&new_list, constraint);
+                dict_set__da__Z3_ast(&deferred->by_index, *idx, new_list);
+            } else
+                da_add_item__Z3_ast(list, constraint);
+        }
+    }
+
+    // the analysis can invalidate the ast info of expr, copy its inputs
+    da__ulong expr_indexes;
+    da_init__ulong(&expr_indexes);
+    detect_involved_inputs_wrapper(ctx, expr, &inputs);
+    set_reset_iter__ulong(&inputs->indexes, 0);
+    while (set_iter_next__ulong(&inputs->indexes, 0, &idx))
+        da_add_item__ulong(&expr_indexes, *idx);
+
+    for (i = 0; i < expr_indexes.size; ++i) {
+        da__Z3_ast* list =
+            dict_get_ref__da__Z3_ast(&deferred->by_index, expr_indexes.data[i]);
+        if (list == NULL)
+            continue;
+        for (j = 0; j < list->size; ++j)
+            __deferred_analyze(ctx, deferred, list->data[j]);
+        da_remove_all__Z3_ast(list, NULL);
+    }
+    da_free__ulong(&expr_indexes, NULL);
+}
+
+// ****** canonicalization of the queries ******
+// cheap local rewritings, applied bottom-up once per query (and cached across
+// queries): constant folding, double negations, ites with a constant
+// condition, extract/concat chains over the same bits and zero-extended
+// unsigned comparisons
+
+static inline Z3_decl_kind __canon_kind(Z3_context c, Z3_ast e)
+{
+    if (Z3_get_ast_kind(c, e) != Z3_APP_AST)
+        return Z3_OP_UNINTERPRETED;
+    return Z3_get_decl_kind(c, Z3_get_app_decl(c, Z3_to_app(c, e)));
+}
+
+static inline int __canon_is_constant(Z3_context c, Z3_ast e)
+{
+    if (Z3_get_ast_kind(c, e) == Z3_NUMERAL_AST)
+        return 1;
+    Z3_decl_kind kind = __canon_kind(c, e);
+    return kind == Z3_OP_TRUE || kind == Z3_OP_FALSE;
+}
+
+static inline Z3_ast __canon_arg(Z3_context c, Z3_ast e, unsigned i)
+{
+    return Z3_get_app_arg(c, Z3_to_app(c, e), i);
+}
+
+static inline unsigned __canon_param(Z3_context c, Z3_ast e, unsigned i)
+{
+    return Z3_get_decl_int_parameter(c, Z3_get_app_decl(c, Z3_to_app(c, e)),
+                                     i);
+}
+
+static inline unsigned __canon_size(Z3_context c, Z3_ast e)
+{
+    return Z3_get_bv_sort_size(c, Z3_get_sort(c, e));
+}
+
+// replace *e with new_ast, moving the reference
+static inline int __canon_replace(Z3_context c, Z3_ast* e, Z3_ast new_ast)
+{
+    Z3_inc_ref(c, new_ast);
+    Z3_dec_ref(c, *e);
+    *e = new_ast;
+    return 1;
+}
+
+static Z3_ast __canon_mk_cmp(Z3_context c, Z3_decl_kind kind, Z3_ast a,
+                             Z3_ast b)
+{
+    switch (kind) {
+        case Z3_OP_EQ:
+            return Z3_mk_eq(c, a, b);
+        case Z3_OP_ULT:
+            return Z3_mk_bvult(c, a, b);
+        case Z3_OP_ULEQ:
+            return Z3_mk_bvule(c, a, b);
+        case Z3_OP_UGT:
+            return Z3_mk_bvugt(c, a, b);
+        case Z3_OP_UGEQ:
+            return Z3_mk_bvuge(c, a, b);
+        default:
+            ASSERT_OR_ABORT(0, "__canon_mk_cmp(): unexpected kind");
+    }
+    return NULL;
+}
+
+// (cmp (zero_extend a) (zero_extend b)) -> (cmp a b), and the same if one of
+// the two sides is a constant that fits the size of the other one
+static int __canon_zext_cmp(Z3_context c, Z3_ast* e, Z3_decl_kind kind)
+{
+    Z3_ast a = __canon_arg(c, *e, 0);
+    Z3_ast b = __canon_arg(c, *e, 1);
+    int    a_zext = __canon_kind(c, a) == Z3_OP_ZERO_EXT;
+    int    b_zext = __canon_kind(c, b) == Z3_OP_ZERO_EXT;
+
+    if (a_zext && b_zext) {
+        Z3_ast a_inner = __canon_arg(c, a, 0);
+        Z3_ast b_inner = __canon_arg(c, b, 0);
+        if (__canon_size(c, a_inner) != __canon_size(c, b_inner))
+            return 0;
+        return __canon_replace(c, e, __canon_mk_cmp(c, kind, a_inner, b_inner));
+    }
+
+    Z3_ast zext, constant;
+    if (a_zext && Z3_get_ast_kind(c, b) == Z3_NUMERAL_AST) {
+        zext     = a;
+        constant = b;
+    } else if (b_zext && Z3_get_ast_kind(c, a) == Z3_NUMERAL_AST) {
+        zext     = b;
+        constant = a;
+    } else
+        return 0;
+
+    uint64_t value;
+    Z3_ast   inner = __canon_arg(c, zext, 0);
+    unsigned size  = __canon_size(c, inner);
+    if (size > 64 || !Z3_get_numeral_uint64(c, constant, &value))
+        return 0;
+    if (size < 64 && value >> size != 0)
+        return kind == Z3_OP_EQ ? __canon_replace(c, e, Z3_mk_false(c)) : 0;
+
+    Z3_ast narrow = Z3_mk_unsigned_int64(c, value, Z3_get_sort(c, inner));
+    if (zext == a)
+        return __canon_replace(c, e, __canon_mk_cmp(c, kind, inner, narrow));
+    return __canon_replace(c, e, __canon_mk_cmp(c, kind, narrow, inner));
+}
+
+// (extract[h:l] x) with x a concat or an extract
+static int __canon_extract(Z3_context c, Z3_ast* e)
+{
+    unsigned high = __canon_param(c, *e, 0);
+    unsigned low  = __canon_param(c, *e, 1);
+    Z3_ast   x    = __canon_arg(c, *e, 0);
+
+    if (low == 0 && high == __canon_size(c, x) - 1)
+        return __canon_replace(c, e, x);
+
+    switch (__canon_kind(c, x)) {
+        case Z3_OP_EXTRACT: {
+            unsigned x_low = __canon_param(c, x, 1);
+            return __canon_replace(c, e,
+                                   Z3_mk_extract(c, high + x_low, low + x_low,
+                                                 __canon_arg(c, x, 0)));
+        }
+        case Z3_OP_CONCAT: {
+            // the last argument holds the least significant bits
+            unsigned n      = Z3_get_app_num_args(c, Z3_to_app(c, x));
+            unsigned offset = 0;
+            while (n-- > 0) {
+                Z3_ast   arg  = __canon_arg(c, x, n);
+                unsigned size = __canon_size(c, arg);
+                if (low >= offset && high < offset + size)
+                    return __canon_replace(
+                        c, e,
+                        Z3_mk_extract(c, high - offset, low - offset, arg));
+                if (high < offset + size)
+                    break;
+                offset += size;
+            }
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+static inline int __canon_adjacent(Z3_context c, Z3_ast hi, Z3_ast lo)
+{
+    return __canon_kind(c, hi) == Z3_OP_EXTRACT &&
+           __canon_kind(c, lo) == Z3_OP_EXTRACT &&
+           Z3_is_eq_ast(c, __canon_arg(c, hi, 0), __canon_arg(c, lo, 0)) &&
+           __canon_param(c, hi, 1) == __canon_param(c, lo, 0) + 1;
+}
+
+static Z3_ast __canon_node(Z3_context c, Z3_ast e);
+
+// (concat (extract[h:m] x) (extract[m-1:l] x) ...) -> (concat (extract[h:l] x)
+// ...), also when the second extract is the head of a nested concat
+static int __canon_concat(Z3_context c, Z3_ast* e)
+{
+    if (Z3_get_app_num_args(c, Z3_to_app(c, *e)) != 2)
+        return 0;
+
+    Z3_ast hi   = __canon_arg(c, *e, 0);
+    Z3_ast lo   = __canon_arg(c, *e, 1);
+    Z3_ast tail = NULL;
+    if (__canon_kind(c, lo) == Z3_OP_CONCAT &&
+        Z3_get_app_num_args(c, Z3_to_app(c, lo)) == 2) {
+        tail = __canon_arg(c, lo, 1);
+        lo   = __canon_arg(c, lo, 0);
+    }
+    if (!__canon_adjacent(c, hi, lo))
+        return 0;
+
+    Z3_ast merged = __canon_node(
+        c, Z3_mk_extract(c, __canon_param(c, hi, 0), __canon_param(c, lo, 1),
+                         __canon_arg(c, hi, 0)));
+    if (tail == NULL)
+        __canon_replace(c, e, merged);
+    else
+        __canon_replace(c, e, Z3_mk_concat(c, merged, tail));
+    Z3_dec_ref(c, merged);
+    return 1;
+}
+
+// apply one rewriting to *e, whose arguments are already canonical
+static int __canon_step(Z3_context c, Z3_ast* e)
+{
+    Z3_decl_kind kind = __canon_kind(c, *e);
+    if (kind == Z3_OP_UNINTERPRETED)
+        return 0;
+
+    unsigned n = Z3_get_app_num_args(c, Z3_to_app(c, *e));
+    if (n == 0)
+        return 0;
+
+    unsigned i;
+    for (i = 0; i < n; ++i)
+        if (!__canon_is_constant(c, __canon_arg(c, *e, i)))
+            break;
+    if (i == n) {
+        Z3_ast folded = Z3_simplify(c, *e);
+        if (!__canon_is_constant(c, folded) || Z3_is_eq_ast(c, folded, *e))
+            return 0;
+        return __canon_replace(c, e, folded);
+    }
+
+    Z3_ast arg = __canon_arg(c, *e, 0);
+    switch (kind) {
+        case Z3_OP_NOT:
+            if (__canon_kind(c, arg) == Z3_OP_NOT)
+                return __canon_replace(c, e, __canon_arg(c, arg, 0));
+            return 0;
+        case Z3_OP_BNOT:
+            if (__canon_kind(c, arg) == Z3_OP_BNOT)
+                return __canon_replace(c, e, __canon_arg(c, arg, 0));
+            return 0;
+        case Z3_OP_ITE: {
+            Z3_ast       then_v = __canon_arg(c, *e, 1);
+            Z3_ast       else_v = __canon_arg(c, *e, 2);
+            Z3_decl_kind cond   = __canon_kind(c, arg);
+            if (cond == Z3_OP_TRUE || Z3_is_eq_ast(c, then_v, else_v))
+                return __canon_replace(c, e, then_v);
+            if (cond == Z3_OP_FALSE)
+                return __canon_replace(c, e, else_v);
+            if (__canon_kind(c, then_v) == Z3_OP_TRUE &&
+                __canon_kind(c, else_v) == Z3_OP_FALSE)
+                return __canon_replace(c, e, arg);
+            if (__canon_kind(c, then_v) == Z3_OP_FALSE &&
+                __canon_kind(c, else_v) == Z3_OP_TRUE)
+                return __canon_replace(c, e, Z3_mk_not(c, arg));
+            return 0;
+        }
+        case Z3_OP_EXTRACT:
+            return __canon_extract(c, e);
+        case Z3_OP_CONCAT:
+            return __canon_concat(c, e);
+        case Z3_OP_EQ:
+        case Z3_OP_ULT:
+        case Z3_OP_ULEQ:
+        case Z3_OP_UGT:
+        case Z3_OP_UGEQ:
+            return n == 2 && __canon_zext_cmp(c, e, kind);
+        default:
+            return 0;
+    }
+}
+
+// return the canonical form of e with a new reference
+static Z3_ast __canon_node(Z3_context c, Z3_ast e)
+{
+    Z3_inc_ref(c, e);
+    while (__canon_step(c, &e))
+        ;
+    return e;
+}
+
+// the canonical form is owned by the cache
+static Z3_ast __canonicalize_rec(fuzzy_ctx_t* ctx, dict__canon_ast_t* cache,
+                                 Z3_ast e)
+{
+    Z3_context c = ctx->z3_ctx;
+    if (Z3_get_ast_kind(c, e) != Z3_APP_AST)
+        return e;
+
+    unsigned     id  = Z3_get_ast_id(c, e);
+    canon_ast_t* hit = dict_get_ref__canon_ast_t(cache, id);
+    if (hit != NULL)
+        return hit->canon;
+
+    unsigned i, n = Z3_get_app_num_args(c, Z3_to_app(c, e));
+    Z3_ast*  args    = (Z3_ast*)malloc(sizeof(Z3_ast) * (n + 1));
+    int      changed = 0;
+    for (i = 0; i < n; ++i) {
+        Z3_ast arg = __canon_arg(c, e, i);
+        args[i]    = __canonicalize_rec(ctx, cache, arg);
+        changed |= args[i] != arg;
+    }
+    Z3_ast canon = __canon_node(c, changed ? Z3_update_term(c, e, n, args) : e);
+    free(args);
+
+    Z3_inc_ref(c, e);
+    canon_ast_t entry = {.ctx = c, .ast = e, .canon = canon};
+    dict_set__canon_ast_t(cache, id, entry);
+    return canon;
+}
+
+// return the canonical form of e with a new reference
+static Z3_ast __canonicalize(fuzzy_ctx_t* ctx, Z3_ast e)
+{
+    if (skip_canonicalize) {
+        Z3_inc_ref(ctx->z3_ctx, e);
+        return e;
+    }
+
+    dict__canon_ast_t* cache = (dict__canon_ast_t*)ctx->canon_cache;
+    if (cache == NULL) {
+        cache = (dict__canon_ast_t*)malloc(sizeof(dict__canon_ast_t));
+        ASSERT_OR_ABORT(cache != NULL, "__canonicalize(): failed malloc");
+        dict_init__canon_ast_t(cache, canon_ast_free);
+        ctx->canon_cache = cache;
+    } else if (cache->size > max_ast_info_cache_size)
+        dict_remove_all__canon_ast_t(cache);
+
+    Z3_ast canon = __canonicalize_rec(ctx, cache, e);
+    Z3_inc_ref(ctx->z3_ctx, canon);
+    return canon;
+}
+
+static inline unsigned __slice_find(unsigned idx)
+{
+    while (slice_parent[idx] != idx) {
+        slice_parent[idx] = slice_parent[slice_parent[idx]];
+        idx               = slice_parent[idx];
+    }
+    return idx;
+}
+
+// union the inputs of expr, return one of them (or -1 if there are none)
+static long __slice_union_inputs(fuzzy_ctx_t* ctx, Z3_ast expr)
+{
+    ast_info_ptr   inputs;
+    unsigned long* idx;
+    long           first = -1;
+
+    detect_involved_inputs_wrapper(ctx, expr, &inputs);
+    set_reset_iter__ulong(&inputs->indexes, 0);
+    while (set_iter_next__ulong(&inputs->indexes, 0, &idx)) {
+        if (first == -1) {
+            first = *idx;
+            continue;
+        }
+        unsigned root_a = __slice_find(first);
+        unsigned root_b = __slice_find(*idx);
+        if (root_a < root_b)
+            slice_parent[root_b] = root_a;
+        else
+            slice_parent[root_a] = root_b;
+    }
+    return first;
+}
+
+static void __slice_query(fuzzy_ctx_t* ctx, Z3_ast query,
+                          Z3_ast branch_condition)
+{
+    int with_not;
+    if (skip_slicing || !is_and_constraint(ctx, query, &with_not))
+        return;
+
+    da__Z3_ast args;
+    da_init__Z3_ast(&args);
+    flatten_and_args(ctx, query, &args);
+
+    da__Z3_ast slice, rest;
+    da_init__Z3_ast(&slice);
+    da_init__Z3_ast(&rest);
+    // the depth of the evaluation counts the arguments of the top level and:
+    // do not slice (not (or ..)) and nested ands
+    if (args.size < 2 || with_not ||
+        Z3_get_app_num_args(ctx->z3_ctx, Z3_to_app(ctx->z3_ctx, query)) !=
+            args.size)
+        goto OUT;
+
+    unsigned long i;
+    for (i = 0; i < ctx->testcases.data[0].values_len; ++i)
+        slice_parent[i] = i;
+
+    long* arg_inputs = (long*)malloc(sizeof(long) * args.size);
+    for (i = 0; i < args.size; ++i)
+        arg_inputs[i] = __slice_union_inputs(ctx, args.data[i]);
+    long branch_input = __slice_union_inputs(ctx, branch_condition);
+
+    slice_pos = (uint32_t*)malloc(sizeof(uint32_t) * args.size * 2);
+    ASSERT_OR_ABORT(slice_pos != NULL, "__slice_query(): failed malloc");
+    rest_pos = slice_pos + args.size;
+    if (branch_input != -1) {
+        unsigned branch_root = __slice_find(branch_input);
+        for (i = 0; i < args.size; ++i) {
+            if (arg_inputs[i] != -1 &&
+                __slice_find(arg_inputs[i]) == branch_root) {
+                slice_pos[slice.size] = i;
+                da_add_item__Z3_ast(&slice, args.data[i]);
+            } else {
+                rest_pos[rest.size] = i;
+                da_add_item__Z3_ast(&rest, args.data[i]);
+            }
+        }
+    }
+    free(arg_inputs);
+
+    if (rest.size == 0) {
+        free(slice_pos);
+        slice_pos = NULL;
+        rest_pos  = NULL;
+        goto OUT;
+    }
+
+    if (slice.size == 0)
+        query_slice = Z3_mk_true(ctx->z3_ctx);
+    else if (slice.size == 1)
+        query_slice = slice.data[0];
+    else
+        query_slice = Z3_mk_and(ctx->z3_ctx, slice.size, slice.data);
+    Z3_inc_ref(ctx->z3_ctx, query_slice);
+    if (rest.size == 1)
+        query_rest = rest.data[0];
+    else
+        query_rest = Z3_mk_and(ctx->z3_ctx, rest.size, rest.data);
+    Z3_inc_ref(ctx->z3_ctx, query_rest);
+    sliced_query = query;
+    slice_size   = slice.size;
+    rest_size    = rest.size;
+
+OUT:
+    for (i = 0; i < args.size; ++i)
+        Z3_dec_ref(ctx->z3_ctx, args.data[i]);
+    da_free__Z3_ast(&args, NULL);
+    da_free__Z3_ast(&slice, NULL);
+    da_free__Z3_ast(&rest, NULL);
+}
+
+static void __release_query_slice(fuzzy_ctx_t* ctx)
+{
+    if (sliced_query == NULL)
+        return;
+
+    Z3_dec_ref(ctx->z3_ctx, query_slice);
+    Z3_dec_ref(ctx->z3_ctx, query_rest);
+    free(slice_pos);
+    sliced_query = NULL;
+    query_slice  = NULL;
+    query_rest   = NULL;
+    slice_pos    = NULL;
+    rest_pos     = NULL;
+}
+
+static void __query_dag_add_root(Z3_ast e)
+{
+    if (e == NULL || query_dag_n_roots == QUERY_DAG_MAX_ROOTS)
+        return;
+
+    int root = dag_add_root(query_dag, e);
+    if (root < 0)
+        return;
+    query_dag_asts[query_dag_n_roots]  = e;
+    query_dag_roots[query_dag_n_roots] = root;
+    query_dag_evals[query_dag_n_roots] = 0;
+    query_dag_jit[query_dag_n_roots]   = NULL;
+    query_dag_n_roots++;
+}
+
+static int __query_dag_pin(Z3_ast e)
+{
+    if (query_dag == NULL || query_dag_n_pinned == QUERY_DAG_MAX_PINNED)
+        return -1;
+
+    int node = dag_add_root(query_dag, e);
+    if (node < 0)
+        return -1;
+    Z3_inc_ref(query_dag->ctx, e);
+    query_dag_pinned[query_dag_n_pinned++] = e;
+    return node;
+}
+
+static void __prepare_query_dag(fuzzy_ctx_t* ctx, Z3_ast query,
+                                Z3_ast branch_condition)
+{
+    // a custom model_eval may not map the symbols on the inputs as we do
+    if (!use_dag_eval || ctx->model_eval != Z3_custom_eval_depth)
+        return;
+
+    query_dag = dag_create(ctx->z3_ctx, ctx->testcases.data[0].values_len);
+    __query_dag_add_root(branch_condition);
+    __query_dag_add_root(query);
+    __query_dag_add_root(query_slice);
+    __query_dag_add_root(query_rest);
+}
+
+static void __release_query_dag()
+{
+    if (query_dag == NULL)
+        return;
+
+    unsigned i;
+    for (i = 0; i < query_dag_n_roots; ++i)
+        if (query_dag_jit[i] != NULL)
+            dag_jit_free(query_dag_jit[i]);
+    for (i = 0; i < query_dag_n_pinned; ++i)
+        Z3_dec_ref(query_dag->ctx, query_dag_pinned[i]);
+    dag_free(query_dag);
+    query_dag          = NULL;
+    query_dag_n_roots  = 0;
+    query_dag_n_pinned = 0;
+}
+
+static inline void __init_global_data(fuzzy_ctx_t* ctx, Z3_ast query,
+                                      Z3_ast branch_condition)
 {
 
     opt_found = 0;
 
     __reset_ast_data();
+    invalidate_intervals_lookup();
 
     __detect_input_to_state_query(ctx, branch_condition, &ast_data, 0);
     detect_involved_inputs_wrapper(ctx, branch_condition, &ast_data.inputs);
     __detect_early_constants(ctx, branch_condition, &ast_data);
 
-    testcase_t* current_testcase = &ctx->testcases.data[0];
-    memcpy(tmp_input, current_testcase->values,
-           current_testcase->values_len * sizeof(unsigned long));
+    testcase_t*   current_testcase = &ctx->testcases.data[0];
+    da__ulong*    indexes          = &ast_data.inputs->indexes_ud;
+    unsigned long i;
+    query_bytes_only = 1;
+    for (i = 0; i < indexes->size; ++i)
+        if (current_testcase->value_sizes[indexes->data[i]] != 8) {
+            query_bytes_only = 0;
+            break;
+        }
+    reset_tmp_input(current_testcase->values, current_testcase->values_len);
 }
 
 static __always_inline int PHASE_reuse(fuzzy_ctx_t* ctx, Z3_ast query,
@@ -3339,8 +5170,7 @@ static __always_inline int PHASE_reuse(fuzzy_ctx_t* ctx, Z3_ast query,
 #ifdef PRINT_SAT
             Z3FUZZ_LOG("[check light - reuse] Query is SAT\n");
 #endif
-            __vals_long_to_char(testcase->values, tmp_proof,
-                                testcase->testcase_len);
+            __set_proof(ctx, testcase->values);
             ctx->stats.reuse++;
             *proof      = tmp_proof;
             *proof_size = testcase->testcase_len;
@@ -3380,7 +5210,7 @@ static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
 #ifdef DEBUG_CHECK_LIGHT
         Z3FUZZ_LOG("L1 - inj byte: 0x%x @ %d\n", b, index);
 #endif
-        tmp_input[index] = b;
+        set_tmp_input(index, b);
     }
     int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
                                          current_testcase->value_sizes,
@@ -3395,8 +5225,7 @@ static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.input_to_state++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             return 1;
@@ -3411,7 +5240,7 @@ static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
     // restore tmp_input
     for (k = 0; k < group->n; ++k) {
         index            = group->indexes[group->n - k - 1];
-        tmp_input[index] = (unsigned long)current_testcase->values[index];
+        set_tmp_input(index, (unsigned long)current_testcase->values[index]);
     }
 
     return 0;
@@ -3425,9 +5254,9 @@ static __always_inline int PHASE_simple_math(fuzzy_ctx_t* ctx, Z3_ast query,
     if (unlikely(skip_simple_math))
         return 0;
 
-    index_group_t      ig = {0};
-    wrapped_interval_t wi;
-    if (!get_range(ctx, branch_condition, &ig, &wi))
+    index_group_t          ig = {0};
+    wrapped_interval_set_t wis;
+    if (!get_range(ctx, branch_condition, &ig, &wis))
         return 0;
 
 #ifdef DEBUG_CHECK_LIGHT
@@ -3437,38 +5266,33 @@ static __always_inline int PHASE_simple_math(fuzzy_ctx_t* ctx, Z3_ast query,
     unsigned long c;
     int           i, j, k;
 
-    if (wi_get_range(&wi) > RANGE_MAX_WIDTH_BRUTE_FORCE)
+    if (wis_get_range(&wis) > RANGE_MAX_WIDTH_BRUTE_FORCE)
         goto TRY_MIN_MAX; // range too wide
 
-    wrapped_interval_iter_t it = wi_init_iter_values(&wi);
-    uint64_t                val;
-    while (wi_iter_get_next(&it, &val)) {
-        set_tmp_input_group_to_value(&ig, val);
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
+    wrapped_interval_iter_t it = wis_init_iter_values(&wis);
+    int eval_v = __range_bruteforce_group(ctx, query, branch_condition, &ig,
+                                          &it, RANGE_MAX_WIDTH_BRUTE_FORCE + 1);
+    if (eval_v == 1) {
 #ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - simple math] Query is SAT\n");
+        Z3FUZZ_LOG("[check light - simple math] Query is SAT\n");
 #endif
-            ctx->stats.simple_math++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
+        ctx->stats.simple_math++;
+        ctx->stats.num_sat++;
+        __set_proof(ctx, tmp_input);
+        *proof      = tmp_proof;
+        *proof_size = current_testcase->testcase_len;
+        return 1;
+    } else if (unlikely(eval_v == TIMEOUT_V))
+        return TIMEOUT_V;
     return 2;
 
 TRY_MIN_MAX:
-    for (j = 0; j < 2; ++j) {
-        if (j == 0)
-            c = wi.min;
+    // try the bounds of every interval
+    for (j = 0; j < 2 * (int)wis.n; ++j) {
+        if ((j & 1) == 0)
+            c = wis.intervals[j / 2].min;
         else
-            c = wi.max;
+            c = wis.intervals[j / 2].max;
 
         for (k = 0; k < ig.n; ++k) {
             unsigned int  index = ig.indexes[ig.n - k - 1];
@@ -3477,10 +5301,11 @@ TRY_MIN_MAX:
 #ifdef DEBUG_CHECK_LIGHT
             Z3FUZZ_LOG("SM - inj byte: 0x%x @ %d\n", b, index);
 #endif
-            if (current_testcase->values[index] == (unsigned long)b)
+            // the byte already holds the value (e.g. it is the seed one)
+            if (tmp_input[index] == (unsigned long)b)
                 continue;
 
-            tmp_input[index] = b;
+            set_tmp_input(index, b);
         }
         int valid_eval = is_valid_eval_group(ctx, &ig, tmp_input,
                                              current_testcase->value_sizes,
@@ -3496,8 +5321,7 @@ TRY_MIN_MAX:
 #endif
                 ctx->stats.simple_math++;
                 ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
+                __set_proof(ctx, tmp_input);
                 *proof      = tmp_proof;
                 *proof_size = current_testcase->values_len;
                 return 1;
@@ -3507,38 +5331,536 @@ TRY_MIN_MAX:
     }
     for (k = 0; k < ig.n; ++k) {
         i            = ig.indexes[ig.n - k - 1];
-        tmp_input[i] = current_testcase->values[i];
+        set_tmp_input(i, current_testcase->values[i]);
     }
     return 0;
 }
 
-static __always_inline int PHASE_input_to_state_extended(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size)
+// Linear constraints over groups of inputs. A comparison "a op b" of width w
+// is kept as the row sum(coeff[i] * x[i]) + konst == a - b, where x[i] is the
+// value of the i-th group. The row is multiplied by 2^(64-w), that lifts it
+// from Z/2^w to Z/2^64: rows of different widths are solved together
+#define LIN_MAX_VARS 8
+#define LIN_MAX_ROWS 8
+
+typedef struct lin_row_t {
+    uint64_t coeff[LIN_MAX_VARS];
+    uint64_t konst;
+    uint64_t deltas[2]; // admitted values of a - b
+    unsigned n_deltas;
+    int      is_eq; // a == b, the only row kind that is exact modulo 2^w
+} lin_row_t;
+
+typedef struct lin_system_t {
+    index_group_t vars[LIN_MAX_VARS];
+    unsigned      n_vars;
+    lin_row_t     rows[LIN_MAX_ROWS];
+    unsigned      n_rows;
+} lin_system_t;
+
+// the bytes (most significant first) of a group whose value is exactly the
+// value of node: concatenations, zero extensions and aligned extracts
+static int __lin_detect_group(fuzzy_ctx_t* ctx, Z3_ast node, index_group_t* ig)
 {
-    if (unlikely(skip_input_to_state_extended))
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
         return 0;
 
-    ASSERT_OR_ABORT(ast_data.values.size > 0 ||
-                        ast_data.inputs->inp_to_state_ite.size > 0,
-                    "PHASE_input_to_state_extended  no early constants");
-
-#ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying Input to State Extended\n");
-#endif
-    testcase_t* current_testcase = &ctx->testcases.data[0];
-
-    index_group_t* group;
-    unsigned int   index;
-    unsigned       i;
-    unsigned       k;
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     nargs     = Z3_get_app_num_args(ctx->z3_ctx, app);
+    unsigned     i;
 
-    for (i = 0; i < ast_data.values.size; ++i) {
-        set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
-        while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0,
-                                            &group)) {
-            // little endian
-            for (k = 0; k < group->n; ++k) {
+    switch (decl_kind) {
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s    = Z3_get_decl_name(ctx->z3_ctx, decl);
+            int       idx  = Z3_get_symbol_int(ctx->z3_ctx, s);
+            Z3_sort   sort = Z3_get_sort(ctx->z3_ctx, node);
+            if (idx >= ctx->testcases.data[0].testcase_len ||
+                Z3_get_bv_sort_size(ctx->z3_ctx, sort) != 8 ||
+                ig->n == MAX_GROUP_SIZE)
+                return 0;
+            ig->indexes[ig->n++] = idx;
+            return 1;
+        }
+        case Z3_OP_ZERO_EXT:
+            return __lin_detect_group(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                      ig);
+        case Z3_OP_CONCAT: {
+            for (i = 0; i < nargs; ++i) {
+                Z3_ast   child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                unsigned width =
+                    Z3_get_bv_sort_size(ctx->z3_ctx,
+                                        Z3_get_sort(ctx->z3_ctx, child));
+                uint64_t v;
+                if (ig->n == 0 &&
+                    Z3_get_ast_kind(ctx->z3_ctx, child) == Z3_NUMERAL_AST &&
+                    Z3_get_numeral_uint64(ctx->z3_ctx, child, &v) && v == 0)
+                    continue; // leading zeros
+                unsigned prev_n = ig->n;
+                if (!__lin_detect_group(ctx, child, ig) ||
+                    (ig->n - prev_n) * 8 != width)
+                    return 0;
+            }
+            return ig->n > 0;
+        }
+        case Z3_OP_EXTRACT: {
+            unsigned hig = Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 0);
+            unsigned low = Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1);
+
+            index_group_t child = {0};
+            if (low % 8 != 0 || (hig + 1) % 8 != 0 ||
+                !__lin_detect_group(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                    &child) ||
+                hig / 8 >= child.n)
+                return 0;
+            for (i = hig / 8 + 1; i > low / 8; --i) {
+                if (ig->n == MAX_GROUP_SIZE)
+                    return 0;
+                ig->indexes[ig->n++] = child.indexes[child.n - i];
+            }
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int __lin_get_var(lin_system_t* sys, index_group_t* ig)
+{
+    unsigned i, j, k;
+    for (i = 0; i < sys->n_vars; ++i) {
+        index_group_t* var = &sys->vars[i];
+        if (var->n == ig->n &&
+            memcmp(var->indexes, ig->indexes, sizeof(uint32_t) * ig->n) == 0)
+            return i;
+        // the variables must be independent
+        for (j = 0; j < var->n; ++j)
+            for (k = 0; k < ig->n; ++k)
+                if (var->indexes[j] == ig->indexes[k])
+                    return -1;
+    }
+    if (sys->n_vars == LIN_MAX_VARS)
+        return -1;
+    sys->vars[sys->n_vars] = *ig;
+    return sys->n_vars++;
+}
+
+// add mult * node to row. Returns 0 if node is not linear
+static int __lin_parse(fuzzy_ctx_t* ctx, lin_system_t* sys, Z3_ast node,
+                       uint64_t mult, lin_row_t* row)
+{
+    uint64_t v;
+    unsigned i;
+    switch (Z3_get_ast_kind(ctx->z3_ctx, node)) {
+        case Z3_NUMERAL_AST:
+            if (!Z3_get_numeral_uint64(ctx->z3_ctx, node, &v))
+                return 0;
+            row->konst += mult * v;
+            return 1;
+        case Z3_APP_AST:
+            break;
+        default:
+            return 0;
+    }
+
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     nargs     = Z3_get_app_num_args(ctx->z3_ctx, app);
+
+    switch (decl_kind) {
+        case Z3_OP_BADD:
+        case Z3_OP_BSUB: {
+            for (i = 0; i < nargs; ++i) {
+                Z3_ast   child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                uint64_t m     = mult;
+                if (decl_kind == Z3_OP_BSUB && i > 0)
+                    m = -mult;
+                if (!__lin_parse(ctx, sys, child, m, row))
+                    return 0;
+            }
+            return 1;
+        }
+        case Z3_OP_BNEG:
+            return __lin_parse(ctx, sys, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                               -mult, row);
+        case Z3_OP_BMUL: {
+            Z3_ast term = NULL;
+            for (i = 0; i < nargs; ++i) {
+                Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                if (Z3_get_ast_kind(ctx->z3_ctx, child) == Z3_NUMERAL_AST) {
+                    if (!Z3_get_numeral_uint64(ctx->z3_ctx, child, &v))
+                        return 0;
+                    mult *= v;
+                } else if (term == NULL)
+                    term = child;
+                else
+                    return 0; // non linear
+            }
+            if (term == NULL) {
+                row->konst += mult;
+                return 1;
+            }
+            return __lin_parse(ctx, sys, term, mult, row);
+        }
+        case Z3_OP_BSHL: {
+            Z3_ast shift = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            if (Z3_get_ast_kind(ctx->z3_ctx, shift) != Z3_NUMERAL_AST ||
+                !Z3_get_numeral_uint64(ctx->z3_ctx, shift, &v))
+                return 0;
+            if (v >= 64)
+                return 1; // shifted out
+            return __lin_parse(ctx, sys, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                               mult << v, row);
+        }
+        default:
+            break;
+    }
+
+    index_group_t ig = {0};
+    if (__lin_detect_group(ctx, node, &ig)) {
+        int var = __lin_get_var(sys, &ig);
+        if (var < 0)
+            return 0;
+        row->coeff[var] += mult;
+        return 1;
+    }
+    // the low bits of a sum depend only on the low bits of the addends
+    if (decl_kind == Z3_OP_EXTRACT &&
+        Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1) == 0)
+        return __lin_parse(ctx, sys, Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                           mult, row);
+    return 0;
+}
+
+// parse the comparison c as a new row of sys. An inequality is solved on its
+// boundary (e.g., a < b as a - b == -1). If only_eq is set, c must be an
+// equality
+static int __lin_add_row(fuzzy_ctx_t* ctx, lin_system_t* sys, Z3_ast c,
+                         int only_eq)
+{
+    if (sys->n_rows == LIN_MAX_ROWS ||
+        Z3_get_ast_kind(ctx->z3_ctx, c) != Z3_APP_AST)
+        return 0;
+
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, c);
+    Z3_decl_kind decl_kind =
+        Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app));
+    int          is_not    = 0;
+    while (decl_kind == Z3_OP_NOT) {
+        c = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+        if (Z3_get_ast_kind(ctx->z3_ctx, c) != Z3_APP_AST)
+            return 0;
+        app       = Z3_to_app(ctx->z3_ctx, c);
+        decl_kind = Z3_get_decl_kind(ctx->z3_ctx,
+                                     Z3_get_app_decl(ctx->z3_ctx, app));
+        is_not    = !is_not;
+    }
+    if (Z3_get_app_num_args(ctx->z3_ctx, app) != 2 ||
+        (only_eq && (decl_kind != Z3_OP_EQ || is_not)))
+        return 0;
+
+    Z3_ast  a    = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+    Z3_ast  b    = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+    Z3_sort sort = Z3_get_sort(ctx->z3_ctx, a);
+    if (Z3_get_sort_kind(ctx->z3_ctx, sort) != Z3_BV_SORT)
+        return 0;
+    unsigned width = Z3_get_bv_sort_size(ctx->z3_ctx, sort);
+    if (width > 64)
+        return 0;
+
+    lin_row_t* row = &sys->rows[sys->n_rows];
+    memset(row, 0, sizeof(lin_row_t));
+    switch (decl_kind) {
+        case Z3_OP_EQ:
+            row->deltas[0] = is_not ? 1 : 0;
+            row->deltas[1] = -1;
+            row->n_deltas  = is_not ? 2 : 1;
+            row->is_eq     = !is_not;
+            break;
+        case Z3_OP_ULT:
+        case Z3_OP_SLT:
+            row->deltas[0] = is_not ? 0 : -1;
+            row->deltas[1] = 1;
+            row->n_deltas  = is_not ? 2 : 1;
+            break;
+        case Z3_OP_ULEQ:
+        case Z3_OP_SLEQ:
+            row->deltas[0] = is_not ? 1 : 0;
+            row->deltas[1] = -1;
+            row->n_deltas  = is_not ? 1 : 2;
+            break;
+        case Z3_OP_UGT:
+        case Z3_OP_SGT:
+            row->deltas[0] = is_not ? 0 : 1;
+            row->deltas[1] = -1;
+            row->n_deltas  = is_not ? 2 : 1;
+            break;
+        case Z3_OP_UGEQ:
+        case Z3_OP_SGEQ:
+            row->deltas[0] = is_not ? -1 : 0;
+            row->deltas[1] = 1;
+            row->n_deltas  = is_not ? 1 : 2;
+            break;
+        default:
+            return 0;
+    }
+
+    unsigned n_vars = sys->n_vars;
+    if (!__lin_parse(ctx, sys, a, 1, row) ||
+        !__lin_parse(ctx, sys, b, -1, row)) {
+        sys->n_vars = n_vars;
+        return 0;
+    }
+
+    unsigned i, shift = 64 - width;
+    for (i = 0; i < sys->n_vars; ++i)
+        row->coeff[i] <<= shift;
+    row->konst <<= shift;
+    row->deltas[0] <<= shift;
+    row->deltas[1] <<= shift;
+    sys->n_rows++;
+    return 1;
+}
+
+static inline uint64_t __lin_inverse(uint64_t u)
+{
+    // inverse of an odd u, every Newton step doubles the correct low bits
+    uint64_t inv = u;
+    int      i;
+    for (i = 0; i < 5; ++i)
+        inv *= 2 - u * inv;
+    return inv;
+}
+
+static inline uint64_t __lin_var_max(index_group_t* ig)
+{
+    return ig->n >= 8 ? 0xffffffffffffffffUL : (1UL << (ig->n * 8)) - 1;
+}
+
+// solve sys taking from every row the delta of the given round. The bits not
+// fixed by the rows (free variables, high bits of a variable with an even
+// coefficient) are taken from hints. Returns 1 and the solution in x, 0 if
+// there is no solution within the widths of the groups for these hints, 2 if
+// the rows are inconsistent
+static int __lin_solve(lin_system_t* sys, unsigned round, uint64_t* hints,
+                       uint64_t* x)
+{
+    uint64_t a[LIN_MAX_ROWS][LIN_MAX_VARS], tmp[LIN_MAX_VARS];
+    uint64_t b[LIN_MAX_ROWS], f, rhs, mask;
+    unsigned pivots[LIN_MAX_ROWS], rank = 0;
+    unsigned r, c, i, best, tz;
+
+    for (r = 0; r < sys->n_rows; ++r) {
+        lin_row_t* row = &sys->rows[r];
+        memcpy(a[r], row->coeff, sizeof(a[r]));
+        b[r] = row->deltas[round < row->n_deltas ? round : 0] - row->konst;
+    }
+
+    // echelon form: the pivot of a column is the coefficient with the fewest
+    // trailing zeros. Its odd part is invertible and the other coefficients
+    // of the column are multiples of its power of two
+    for (c = 0; c < sys->n_vars && rank < sys->n_rows; ++c) {
+        best = sys->n_rows;
+        tz   = 64;
+        for (r = rank; r < sys->n_rows; ++r)
+            if (a[r][c] != 0 && (unsigned)__builtin_ctzl(a[r][c]) < tz) {
+                best = r;
+                tz   = __builtin_ctzl(a[r][c]);
+            }
+        if (best == sys->n_rows)
+            continue;
+
+        memcpy(tmp, a[best], sizeof(tmp));
+        memcpy(a[best], a[rank], sizeof(tmp));
+        memcpy(a[rank], tmp, sizeof(tmp));
+        f       = b[best];
+        b[best] = b[rank];
+        b[rank] = f;
+
+        uint64_t inv = __lin_inverse(a[rank][c] >> tz);
+        for (r = rank + 1; r < sys->n_rows; ++r) {
+            if (a[r][c] == 0)
+                continue;
+            f = (a[r][c] >> tz) * inv;
+            for (i = c; i < sys->n_vars; ++i)
+                a[r][i] -= f * a[rank][i];
+            b[r] -= f * b[rank];
+        }
+        pivots[rank++] = c;
+    }
+    for (r = rank; r < sys->n_rows; ++r)
+        if (b[r] != 0)
+            return 2;
+
+    // back substitution
+    memcpy(x, hints, sizeof(uint64_t) * sys->n_vars);
+    for (r = rank; r-- > 0;) {
+        c   = pivots[r];
+        rhs = b[r];
+        for (i = c + 1; i < sys->n_vars; ++i)
+            rhs -= a[r][i] * x[i];
+        tz = __builtin_ctzl(a[r][c]);
+        if (tz > 0 && (rhs & ((1UL << tz) - 1)) != 0)
+            return 0;
+        mask = tz == 0 ? 0xffffffffffffffffUL : (1UL << (64 - tz)) - 1;
+        x[c] = (((rhs >> tz) * __lin_inverse(a[r][c] >> tz)) & mask) |
+               (hints[c] & ~mask);
+    }
+    for (i = 0; i < sys->n_vars; ++i)
+        if (x[i] > __lin_var_max(&sys->vars[i]))
+            return 0;
+    return 1;
+}
+
+static __always_inline int PHASE_linear_math(fuzzy_ctx_t* ctx, Z3_ast query,
+                                             Z3_ast branch_condition,
+                                             unsigned char const** proof,
+                                             unsigned long*        proof_size)
+{
+    if (unlikely(skip_linear_math))
+        return 0;
+    if (ast_data.inputs->linear_arithmetic_operations == 0 ||
+        ast_data.inputs->nonlinear_arithmetic_operations > 0)
+        return 0;
+
+    lin_system_t  sys;
+    unsigned long i;
+    int           with_not, parsed = 1;
+    sys.n_vars = 0;
+    sys.n_rows = 0;
+    if (is_and_constraint(ctx, branch_condition, &with_not)) {
+        da__Z3_ast args;
+        da_init__Z3_ast(&args);
+        flatten_and_args(ctx, branch_condition, &args);
+        for (i = 0; i < args.size; ++i) {
+            if (parsed && !__lin_add_row(ctx, &sys, args.data[i], 0))
+                parsed = 0;
+            Z3_dec_ref(ctx->z3_ctx, args.data[i]);
+        }
+        da_free__Z3_ast(&args, NULL);
+    } else
+        parsed = __lin_add_row(ctx, &sys, branch_condition, 0);
+    if (!parsed || sys.n_vars == 0)
+        return 0;
+
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Linear Math\n");
+#endif
+
+    // the equalities of the path on the same variables
+    Z3_ast path = query == sliced_query ? query_slice : query;
+    if (Z3_get_ast_kind(ctx->z3_ctx, path) == Z3_APP_AST) {
+        Z3_app app = Z3_to_app(ctx->z3_ctx, path);
+        if (Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app)) ==
+            Z3_OP_AND) {
+            unsigned nargs = Z3_get_app_num_args(ctx->z3_ctx, app);
+            for (i = 0; i < nargs && sys.n_rows < LIN_MAX_ROWS; ++i) {
+                unsigned n_vars = sys.n_vars;
+                if (!__lin_add_row(ctx, &sys,
+                                   Z3_get_app_arg(ctx->z3_ctx, app, i), 1))
+                    continue;
+                if (sys.n_vars != n_vars) {
+                    sys.n_vars = n_vars;
+                    sys.n_rows--;
+                }
+            }
+        }
+    }
+
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    uint64_t    hints[LIN_MAX_VARS], x[LIN_MAX_VARS];
+    unsigned    round, hint, k;
+
+    unsigned n_rounds = 1;
+    int      all_eq   = 1;
+    for (i = 0; i < sys.n_rows; ++i) {
+        if (sys.rows[i].n_deltas > n_rounds)
+            n_rounds = sys.rows[i].n_deltas;
+        all_eq &= sys.rows[i].is_eq;
+    }
+
+    for (round = 0; round < n_rounds; ++round) {
+        // the bits left free are taken from the seed, then set, then cleared
+        for (hint = 0; hint < 3; ++hint) {
+            for (i = 0; i < sys.n_vars; ++i) {
+                if (hint == 0)
+                    hints[i] = index_group_to_value(&sys.vars[i],
+                                                    current_testcase->values);
+                else
+                    hints[i] = hint == 1 ? __lin_var_max(&sys.vars[i]) : 0;
+            }
+
+            int solved = __lin_solve(&sys, round, hints, x);
+            if (solved == 2 && all_eq)
+                return 2; // the equalities have no solution
+            if (solved == 2)
+                break;
+            if (solved == 0)
+                continue;
+
+            int valid_eval = 1;
+            for (i = 0; i < sys.n_vars; ++i) {
+                index_group_t* ig = &sys.vars[i];
+                for (k = 0; k < ig->n; ++k)
+                    set_tmp_input(ig->indexes[ig->n - k - 1],
+                                  __extract_from_long(x[i], k));
+                valid_eval &= is_valid_eval_group(
+                    ctx, ig, tmp_input, current_testcase->value_sizes,
+                    current_testcase->values_len);
+            }
+            if (!valid_eval)
+                continue;
+
+            int eval_v = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (eval_v == 1) {
+#ifdef PRINT_SAT
+                Z3FUZZ_LOG("[check light - linear math] Query is SAT\n");
+#endif
+                ctx->stats.linear_math++;
+                ctx->stats.num_sat++;
+                __set_proof(ctx, tmp_input);
+                *proof      = tmp_proof;
+                *proof_size = current_testcase->testcase_len;
+                return 1;
+            } else if (unlikely(eval_v == TIMEOUT_V))
+                return TIMEOUT_V;
+        }
+    }
+    return 0;
+}
+
+static __always_inline int PHASE_input_to_state_extended(
+    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+    unsigned char const** proof, unsigned long* proof_size)
+{
+    if (unlikely(skip_input_to_state_extended))
+        return 0;
+
+    ASSERT_OR_ABORT(ast_data.values.size > 0 ||
+                        ast_data.inputs->inp_to_state_ite.size > 0,
+                    "PHASE_input_to_state_extended  no early constants");
+
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Input to State Extended\n");
+#endif
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+
+    index_group_t* group;
+    unsigned int   index;
+    unsigned       i;
+    unsigned       k;
+
+    da__index_group_t* groups = __get_query_groups();
+    unsigned long      gi;
+    for (i = 0; i < ast_data.values.size; ++i) {
+        for (gi = 0; gi < groups->size; ++gi) {
+            group = &groups->data[gi];
+            // little endian
+            for (k = 0; k < group->n; ++k) {
                 unsigned int  index = group->indexes[group->n - k - 1];
                 unsigned char b =
                     __extract_from_long(ast_data.values.data[i], k);
@@ -3549,7 +5871,7 @@ static __always_inline int PHASE_input_to_state_extended(
                 if (tmp_input[index] == (unsigned long)b)
                     continue;
 
-                tmp_input[index] = b;
+                set_tmp_input(index, b);
             }
             int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
                                                  current_testcase->value_sizes,
@@ -3566,8 +5888,7 @@ static __always_inline int PHASE_input_to_state_extended(
 #endif
                     ctx->stats.input_to_state_ext++;
                     ctx->stats.num_sat++;
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     *proof      = tmp_proof;
                     *proof_size = current_testcase->values_len;
                     return 1;
@@ -3586,7 +5907,7 @@ static __always_inline int PHASE_input_to_state_extended(
                 if (tmp_input[index] == (unsigned long)b)
                     continue;
 
-                tmp_input[index] = b;
+                set_tmp_input(index, b);
             }
             valid_eval = is_valid_eval_group(ctx, group, tmp_input,
                                              current_testcase->value_sizes,
@@ -3603,8 +5924,7 @@ static __always_inline int PHASE_input_to_state_extended(
 #endif
                     ctx->stats.input_to_state_ext++;
                     ctx->stats.num_sat++;
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     *proof      = tmp_proof;
                     *proof_size = current_testcase->values_len;
                     return 1;
@@ -3614,7 +5934,7 @@ static __always_inline int PHASE_input_to_state_extended(
             // restore tmp_input
             for (k = 0; k < group->n; ++k) {
                 index            = group->indexes[k];
-                tmp_input[index] = current_testcase->values[index];
+                set_tmp_input(index, current_testcase->values[index]);
             }
         }
     }
@@ -3634,8 +5954,7 @@ static __always_inline int PHASE_input_to_state_extended(
 #endif
         ctx->stats.input_to_state_ext++;
         ctx->stats.num_sat++;
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *proof      = tmp_proof;
         *proof_size = current_testcase->values_len;
         return 1;
@@ -3647,7 +5966,7 @@ static __always_inline int PHASE_input_to_state_extended(
         ite_its_t* its_el = &ast_data.inputs->inp_to_state_ite.data[i];
         for (k = 0; k < its_el->ig.n; ++k) {
             index            = its_el->ig.indexes[k];
-            tmp_input[index] = current_testcase->values[index];
+            set_tmp_input(index, current_testcase->values[index]);
         }
     }
     return 0;
@@ -3674,7 +5993,7 @@ static __always_inline int PHASE_brute_force(fuzzy_ctx_t* ctx, Z3_ast query,
     set_iter_next__ulong(&ast_data.inputs->indexes, 0, &uniq_index);
 
     for (i = 0; i < 256; ++i) {
-        tmp_input[*uniq_index] = i;
+        set_tmp_input(*uniq_index, i);
         int eval_v             = __evaluate_branch_query(
             ctx, query, branch_condition, tmp_input,
             current_testcase->value_sizes, current_testcase->values_len);
@@ -3685,8 +6004,7 @@ static __always_inline int PHASE_brute_force(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.brute_force++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             return 1;
@@ -3722,6 +6040,8 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
     ASSERT_OR_ABORT(valid_eval == 1, "eval should be always valid here");
 
     eval_set_ctx(&ew);
+    gd_reset_optimizer(ast_data.values.data, ast_data.values.size);
+    unsigned long num_evaluate_start = ctx->stats.num_evaluate;
     set__digest_t digest_set;
     set_init__digest_t(&digest_set, digest_64bit_hash, digest_equals);
 
@@ -3743,8 +6063,7 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
 #endif
             ctx->stats.gradient_descend++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             res         = 1;
@@ -3759,289 +6078,233 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         goto OUT;
     }
 
-    __gd_restore_tmp_input(current_testcase);
 OUT:
+    ctx->stats.gd_evaluate += ctx->stats.num_evaluate - num_evaluate_start;
+    gd_variant_stats_t vs;
+    gd_get_variant_stats(&vs);
+    ctx->stats.gd_bisect_evaluate += vs.bisect_evals;
+    ctx->stats.gd_momentum_evaluate += vs.momentum_evals;
+    ctx->stats.gd_restart_evaluate += vs.restart_evals;
+    if (res == 1) {
+        ctx->stats.gd_bisect_sat += vs.bisect_hits > 0;
+        ctx->stats.gd_momentum_sat += vs.momentum_hits > 0;
+        ctx->stats.gd_restart_sat += vs.restart_hits > 0;
+    }
     Z3_dec_ref(ctx->z3_ctx, out_ast);
     set_free__digest_t(&digest_set, NULL);
     __gd_free_eval(&ew);
     return res;
 }
 
-static __always_inline int SUBPHASE_afl_det_single_waliking_bit(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size,
-    unsigned long input_index)
+// Candidates of a multi-byte deterministic stage: each value is written
+// little-endian over the group indexes. They are generated up front so that
+// values produced by more than one mutation (e.g., LE and BE arithmetics on
+// symmetric words) are evaluated only once.
+#define DET_MAX_CANDIDATES 256
+#define DET_SEEN_SIZE      512
+
+typedef struct det_candidate_t {
+    uint64_t       value;
+    unsigned long* stat;
+    const char*    name;
+} det_candidate_t;
+
+static det_candidate_t det_candidates[DET_MAX_CANDIDATES];
+static unsigned        det_candidates_size;
+static uint64_t        det_candidates_mask;
+static uint64_t        det_seen[DET_SEEN_SIZE];
+static unsigned char   det_seen_used[DET_SEEN_SIZE];
+
+static inline void __det_candidates_init(unsigned n_bytes)
 {
-    if (unlikely(skip_afl_det_single_walking_bit))
-        return 0;
+    det_candidates_size = 0;
+    det_candidates_mask =
+        n_bytes >= 8 ? 0xffffffffffffffffUL : (1UL << (n_bytes * 8)) - 1;
+    memset(det_seen_used, 0, sizeof(det_seen_used));
+}
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index];
-    unsigned char tmp_byte;
-    unsigned      i;
+static inline uint64_t __det_swap(uint64_t value, unsigned n_bytes)
+{
+    return __builtin_bswap64(value) >> (64 - n_bytes * 8);
+}
 
-    // single walking bit
-    for (i = 0; i < 8; ++i) {
-        tmp_byte               = FLIP_BIT(input_byte_0, i);
-        tmp_input[input_index] = (unsigned long)tmp_byte;
-        int valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - flip1] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.flip1++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+static inline void __det_candidates_add(uint64_t value, unsigned long* stat,
+                                        const char* name)
+{
+    value      = value & det_candidates_mask;
+    unsigned h = (unsigned)((value * 0x9e3779b97f4a7c15UL) >> 55);
+    while (det_seen_used[h]) {
+        if (det_seen[h] == value)
+            return;
+        h = (h + 1) & (DET_SEEN_SIZE - 1);
     }
-    return 0;
+    det_seen_used[h] = 1;
+    det_seen[h]      = value;
+
+    ASSERT_OR_ABORT(det_candidates_size < DET_MAX_CANDIDATES,
+                    "too many deterministic candidates");
+    det_candidates[det_candidates_size].value = value;
+    det_candidates[det_candidates_size].stat  = stat;
+    det_candidates[det_candidates_size].name  = name;
+    det_candidates_size++;
 }
 
-static __always_inline int SUBPHASE_afl_det_two_waliking_bits(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size,
-    unsigned long input_index)
+static int __det_eval_candidates(fuzzy_ctx_t* ctx, Z3_ast query,
+                                 Z3_ast               branch_condition,
+                                 unsigned char const** proof,
+                                 unsigned long* proof_size,
+                                 unsigned long* indexes, unsigned n_indexes)
 {
-    if (unlikely(skip_afl_det_two_walking_bit))
-        return 0;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index];
-    unsigned char tmp_byte;
-    unsigned      i;
-    for (i = 0; i < 7; ++i) {
-        tmp_byte               = FLIP_BIT(input_byte_0, i);
-        tmp_byte               = FLIP_BIT(tmp_byte, i + 1);
-        tmp_input[input_index] = (unsigned long)tmp_byte;
-        int valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
+    unsigned i, k;
+    for (i = 0; i < det_candidates_size; ++i) {
+        det_candidate_t* c = &det_candidates[i];
+        for (k = 0; k < n_indexes; ++k)
+            set_tmp_input(indexes[k], (c->value >> (k * 8)) & 0xffUL);
+
+        int valid_eval = 1;
+        for (k = 0; k < n_indexes && valid_eval; ++k)
+            valid_eval = is_valid_eval_index(ctx, indexes[k], tmp_input,
                                              current_testcase->value_sizes,
                                              current_testcase->values_len);
-        if (valid_eval) {
+        if (!valid_eval)
+            continue;
 
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
+        int eval_v = __evaluate_branch_query(ctx, query, branch_condition,
+                                             tmp_input,
+                                             current_testcase->value_sizes,
+                                             current_testcase->values_len);
+        if (eval_v == 1) {
 #ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - flip2] "
-                           "Query is SAT\n");
+            Z3FUZZ_LOG("[check light - %s] Query is SAT\n", c->name);
 #endif
-                ctx->stats.flip2++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+            (*c->stat)++;
+            ctx->stats.num_sat++;
+            __set_proof(ctx, tmp_input);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
     }
     return 0;
 }
 
-static __always_inline int SUBPHASE_afl_det_four_waliking_bits(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size,
-    unsigned long input_index)
+static inline uint64_t __det_read_value(testcase_t*    current_testcase,
+                                        unsigned long* indexes,
+                                        unsigned       n_indexes)
 {
-    if (unlikely(skip_afl_det_four_walking_bit))
-        return 0;
+    uint64_t value = 0;
+    unsigned k;
+    for (k = 0; k < n_indexes; ++k)
+        value |= (current_testcase->values[indexes[k]] & 0xffUL) << (k * 8);
+    return value;
+}
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index];
-    unsigned char tmp_byte;
-    unsigned      i;
+static inline void __det_add_arith(uint64_t value, unsigned n_bytes,
+                                   unsigned long* sum_LE, unsigned long* sub_LE,
+                                   unsigned long* sum_BE, unsigned long* sub_BE,
+                                   const char** names)
+{
+    uint64_t value_BE = __det_swap(value, n_bytes);
 
-    for (i = 0; i < 5; ++i) {
-        tmp_byte               = FLIP_BIT(input_byte_0, i);
-        tmp_byte               = FLIP_BIT(tmp_byte, i + 1);
-        tmp_byte               = FLIP_BIT(tmp_byte, i + 2);
-        tmp_byte               = FLIP_BIT(tmp_byte, i + 3);
-        tmp_input[input_index] = (unsigned long)tmp_byte;
-        int valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - flip4] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.flip4++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+    unsigned i;
+    for (i = 1; i < 35; ++i) {
+        __det_candidates_add(value + i, sum_LE, names[0]);
+        __det_candidates_add(value - i, sub_LE, names[1]);
+        __det_candidates_add(__det_swap(value_BE + i, n_bytes), sum_BE,
+                             names[2]);
+        __det_candidates_add(__det_swap(value_BE - i, n_bytes), sub_BE,
+                             names[3]);
     }
-    return 0;
 }
 
-static __always_inline int
-SUBPHASE_afl_det_byte_flip(fuzzy_ctx_t* ctx, Z3_ast query,
-                           Z3_ast branch_condition, unsigned char const** proof,
-                           unsigned long* proof_size, unsigned long input_index)
+static inline void __det_add_walking_bits(uint64_t value, unsigned n_bits,
+                                          unsigned long* stat,
+                                          const char*    name)
 {
-    if (unlikely(skip_afl_det_byte_flip))
-        return 0;
-
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index];
+    uint64_t mask = (1UL << n_bits) - 1;
+    unsigned i;
+    for (i = 0; i + n_bits <= 8; ++i)
+        __det_candidates_add(value ^ (mask << i), stat, name);
+}
 
-    tmp_input[input_index] = (unsigned long)input_byte_0 ^ 0xffUL;
-    int valid_eval         = is_valid_eval_index(ctx, input_index, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-    if (valid_eval) {
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - flip8] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.flip8++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
-    return 0;
+static inline void __det_add_byte_flip(fuzzy_ctx_t* ctx, uint64_t value)
+{
+    if (unlikely(skip_afl_det_byte_flip))
+        return;
+    __det_candidates_add(value ^ 0xffUL, &ctx->stats.flip8, "flip8");
 }
 
-static __always_inline int
-SUBPHASE_afl_det_arith8(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-                        unsigned char const** proof, unsigned long* proof_size,
-                        unsigned long input_index)
+static inline void __det_add_arith8(fuzzy_ctx_t* ctx, uint64_t value)
 {
     if (unlikely(skip_afl_det_arith8))
-        return 0;
+        return;
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index];
     unsigned i;
-
     for (i = 1; i < 35; ++i) {
-        tmp_input[input_index] = (unsigned char)(input_byte_0 + i);
-        int valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith8-sum] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith8_sum++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp_input[input_index] = (unsigned char)(input_byte_0 - i);
-        valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
+        __det_candidates_add(value + i, &ctx->stats.arith8_sum, "arith8-sum");
+        __det_candidates_add(value - i, &ctx->stats.arith8_sub, "arith8-sub");
+    }
+}
 
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith8-sub] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith8_sub++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+// every byte stage of input_index (walking bits, [byte flip, 8-bit
+// arithmetics,] interesting 8) in a single deduplicated batch. A value
+// produced by more than one stage is credited to the first one
+static __always_inline int
+SUBPHASE_afl_det_byte(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+                      unsigned char const** proof, unsigned long* proof_size,
+                      unsigned long input_index, int with_arith)
+{
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    uint64_t    value = current_testcase->values[input_index] & 0xffUL;
+
+    __det_candidates_init(1);
+    if (!skip_afl_det_single_walking_bit)
+        __det_add_walking_bits(value, 1, &ctx->stats.flip1, "flip1");
+    if (!skip_afl_det_two_walking_bit)
+        __det_add_walking_bits(value, 2, &ctx->stats.flip2, "flip2");
+    if (!skip_afl_det_four_walking_bit)
+        __det_add_walking_bits(value, 4, &ctx->stats.flip4, "flip4");
+    if (with_arith) {
+        __det_add_byte_flip(ctx, value);
+        __det_add_arith8(ctx, value);
+    }
+    if (!skip_afl_det_int8) {
+        unsigned i;
+        for (i = 0; i < sizeof(interesting8); ++i)
+            __det_candidates_add((uint64_t)interesting8[i], &ctx->stats.int8,
+                                 "int8");
     }
-    return 0;
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, &input_index, 1);
 }
 
-static __always_inline int SUBPHASE_afl_det_int8(fuzzy_ctx_t* ctx, Z3_ast query,
-                                                 Z3_ast branch_condition,
-                                                 unsigned char const** proof,
-                                                 unsigned long* proof_size,
-                                                 unsigned long  input_index)
+static __always_inline int
+SUBPHASE_afl_det_byte_flip(fuzzy_ctx_t* ctx, Z3_ast query,
+                           Z3_ast branch_condition, unsigned char const** proof,
+                           unsigned long* proof_size, unsigned long input_index)
 {
-    if (unlikely(skip_afl_det_int8))
-        return 0;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+
+    __det_candidates_init(1);
+    __det_add_byte_flip(ctx, current_testcase->values[input_index]);
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, &input_index, 1);
+}
 
+static __always_inline int
+SUBPHASE_afl_det_arith8(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+                        unsigned char const** proof, unsigned long* proof_size,
+                        unsigned long input_index)
+{
     testcase_t* current_testcase = &ctx->testcases.data[0];
-    unsigned    i;
 
-    for (i = 0; i < sizeof(interesting8); ++i) {
-        tmp_input[input_index] = (unsigned char)(interesting8[i]);
-        int valid_eval = is_valid_eval_index(ctx, input_index, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int8] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int8++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-    }
-    return 0;
+    __det_candidates_init(1);
+    __det_add_arith8(ctx, current_testcase->values[input_index]);
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, &input_index, 1);
 }
 
 static __always_inline int SUBPHASE_afl_det_flip_short(
@@ -4052,41 +6315,16 @@ static __always_inline int SUBPHASE_afl_det_flip_short(
     if (unlikely(skip_afl_det_flip_short))
         return 0;
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-
-    // flip short
-    tmp_input[input_index_0] = (unsigned long)input_byte_0 ^ 0xffUL;
-    tmp_input[input_index_1] = (unsigned long)input_byte_1 ^ 0xffUL;
-    int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-    if (valid_eval) {
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - flip16] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.flip16++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
-    return 0;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+
+    unsigned long indexes[] = {input_index_0, input_index_1};
+
+    __det_candidates_init(2);
+    __det_candidates_add(__det_read_value(current_testcase, indexes, 2) ^
+                             0xffffUL,
+                         &ctx->stats.flip16, "flip16");
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 2);
 }
 
 static __always_inline int
@@ -4098,133 +6336,20 @@ SUBPHASE_afl_det_arith16(fuzzy_ctx_t* ctx, Z3_ast query,
     if (unlikely(skip_afl_det_arith16))
         return 0;
 
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-    unsigned short input_word_LE = (input_byte_1 << 8) | input_byte_0;
-    unsigned short input_word_BE = (input_byte_0 << 8) | input_byte_1;
-
-    unsigned short tmp;
-    unsigned       i;
-    for (i = 1; i < 35; ++i) {
-        tmp                      = input_word_LE + i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
+    static const char* names[] = {"arith16-sum-LE", "arith16-sub-LE",
+                                  "arith16-sum-BE", "arith16-sub-BE"};
 
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith16-sum-LE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith16_sum_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_word_LE - i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith16-sub-LE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith16_sub_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_word_BE + i;
-        tmp_input[input_index_1] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 8) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith16-sum-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith16_sum_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+    testcase_t* current_testcase = &ctx->testcases.data[0];
 
-        tmp                      = input_word_BE - i;
-        tmp_input[input_index_1] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 8) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith16-sub-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith32_sub_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-    }
-    return 0;
+    unsigned long indexes[] = {input_index_0, input_index_1};
+
+    __det_candidates_init(2);
+    __det_add_arith(__det_read_value(current_testcase, indexes, 2), 2,
+                    &ctx->stats.arith16_sum_LE, &ctx->stats.arith16_sub_LE,
+                    &ctx->stats.arith16_sum_BE, &ctx->stats.arith16_sub_BE,
+                    names);
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 2);
 }
 
 static __always_inline int
@@ -4234,70 +6359,16 @@ SUBPHASE_afl_det_int16(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
 {
     if (unlikely(skip_afl_det_int16))
         return 0;
-    testcase_t* current_testcase = &ctx->testcases.data[0];
 
+    unsigned long indexes[] = {input_index_0, input_index_1};
+
+    __det_candidates_init(2);
     unsigned i;
-    for (i = 0; i < sizeof(interesting16) / sizeof(short); ++i) {
-        tmp_input[input_index_0] = (unsigned long)(interesting16[i]) & 0xffUL;
-        tmp_input[input_index_1] =
-            (unsigned long)(interesting16[i] >> 8) & 0xffUL;
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int16] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int16++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-#if 0
-        tmp_input[input_index_1] = (unsigned long)(interesting16[i]) & 0xffUL;
-        tmp_input[input_index_0] =
-            (unsigned long)(interesting16[i] >> 8) & 0xffUL;
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int16] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int16++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-#endif
-    }
-    return 0;
+    for (i = 0; i < sizeof(interesting16) / sizeof(short); ++i)
+        __det_candidates_add((uint64_t)interesting16[i], &ctx->stats.int16,
+                             "int16");
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 2);
 }
 
 static __always_inline int SUBPHASE_afl_det_flip_int(
@@ -4311,51 +6382,15 @@ static __always_inline int SUBPHASE_afl_det_flip_int(
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
 
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-    unsigned char input_byte_2 =
-        (unsigned char)current_testcase->values[input_index_2];
-    unsigned char input_byte_3 =
-        (unsigned char)current_testcase->values[input_index_3];
-
-    tmp_input[input_index_0] = (unsigned long)input_byte_0 ^ 0xffUL;
-    tmp_input[input_index_1] = (unsigned long)input_byte_1 ^ 0xffUL;
-    tmp_input[input_index_2] = (unsigned long)input_byte_2 ^ 0xffUL;
-    tmp_input[input_index_3] = (unsigned long)input_byte_3 ^ 0xffUL;
-    int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-    if (valid_eval) {
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - flip32] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.flip32++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
-    return 0;
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3};
+
+    __det_candidates_init(4);
+    __det_candidates_add(__det_read_value(current_testcase, indexes, 4) ^
+                             0xffffffffUL,
+                         &ctx->stats.flip32, "flip32");
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 4);
 }
 
 static __always_inline int SUBPHASE_afl_det_arith32(
@@ -4367,171 +6402,21 @@ static __always_inline int SUBPHASE_afl_det_arith32(
     if (unlikely(skip_afl_det_arith32))
         return 0;
 
-    testcase_t* current_testcase = &ctx->testcases.data[0];
+    static const char* names[] = {"arith32-sum-LE", "arith32-sub-LE",
+                                  "arith32-sum-BE", "arith32-sub-BE"};
 
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-    unsigned char input_byte_2 =
-        (unsigned char)current_testcase->values[input_index_2];
-    unsigned char input_byte_3 =
-        (unsigned char)current_testcase->values[input_index_3];
-    unsigned input_dword_LE = (input_byte_3 << 24) | (input_byte_2 << 16) |
-                              (input_byte_1 << 8) | input_byte_0;
-    unsigned input_dword_BE = (input_byte_0 << 24) | (input_byte_1 << 16) |
-                              (input_byte_2 << 8) | input_byte_3;
-
-    unsigned i, tmp;
-    for (i = 1; i < 35; ++i) {
-        tmp                      = input_dword_LE + i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 24) & 0xffUL);
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith32-sum-LE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith32_sum_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+    testcase_t* current_testcase = &ctx->testcases.data[0];
 
-        tmp                      = input_dword_LE - i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 24) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith32-sub-LE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith32_sub_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3};
 
-        tmp                      = input_dword_BE + i;
-        tmp_input[input_index_3] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 24) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith32-sum-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith32_sum_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_dword_BE - i;
-        tmp_input[input_index_3] = (unsigned long)(tmp & 0xffU);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 8) & 0xffU);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 16) & 0xffU);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 24) & 0xffU);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith32-sub-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith32_sub_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-    }
-    return 0;
+    __det_candidates_init(4);
+    __det_add_arith(__det_read_value(current_testcase, indexes, 4), 4,
+                    &ctx->stats.arith32_sum_LE, &ctx->stats.arith32_sub_LE,
+                    &ctx->stats.arith32_sum_BE, &ctx->stats.arith32_sub_BE,
+                    names);
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 4);
 }
 
 static __always_inline int
@@ -4543,90 +6428,18 @@ SUBPHASE_afl_det_int32(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
     if (unlikely(skip_afl_det_int32))
         return 0;
 
-    testcase_t* current_testcase = &ctx->testcases.data[0];
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3};
 
+    __det_candidates_init(4);
     unsigned i;
     for (i = 0; i < sizeof(interesting32) / sizeof(int); ++i) {
-        tmp_input[input_index_0] = (unsigned long)(interesting32[i]) & 0xffU;
-        tmp_input[input_index_1] =
-            (unsigned long)(interesting32[i] >> 8) & 0xffU;
-        tmp_input[input_index_2] =
-            (unsigned long)(interesting32[i] >> 16) & 0xffU;
-        tmp_input[input_index_3] =
-            (unsigned long)(interesting32[i] >> 24) & 0xffU;
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int32] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int32++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            }
-        }
-
-#if 1
-        tmp_input[input_index_3] = (unsigned long)(interesting32[i]) & 0xffU;
-        tmp_input[input_index_2] =
-            (unsigned long)(interesting32[i] >> 8) & 0xffU;
-        tmp_input[input_index_1] =
-            (unsigned long)(interesting32[i] >> 16) & 0xffU;
-        tmp_input[input_index_0] =
-            (unsigned long)(interesting32[i] >> 24) & 0xffU;
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int32] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int32++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-#endif
+        uint64_t value = (uint64_t)interesting32[i];
+        __det_candidates_add(value, &ctx->stats.int32, "int32");
+        __det_candidates_add(__det_swap(value, 4), &ctx->stats.int32, "int32");
     }
-    return 0;
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 4);
 }
 
 static __always_inline int SUBPHASE_afl_det_flip_long(
@@ -4642,75 +6455,15 @@ static __always_inline int SUBPHASE_afl_det_flip_long(
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
 
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-    unsigned char input_byte_2 =
-        (unsigned char)current_testcase->values[input_index_2];
-    unsigned char input_byte_3 =
-        (unsigned char)current_testcase->values[input_index_3];
-    unsigned char input_byte_4 =
-        (unsigned char)current_testcase->values[input_index_4];
-    unsigned char input_byte_5 =
-        (unsigned char)current_testcase->values[input_index_5];
-    unsigned char input_byte_6 =
-        (unsigned char)current_testcase->values[input_index_6];
-    unsigned char input_byte_7 =
-        (unsigned char)current_testcase->values[input_index_7];
-
-    tmp_input[input_index_0] = (unsigned long)input_byte_0 ^ 0xffUL;
-    tmp_input[input_index_1] = (unsigned long)input_byte_1 ^ 0xffUL;
-    tmp_input[input_index_2] = (unsigned long)input_byte_2 ^ 0xffUL;
-    tmp_input[input_index_3] = (unsigned long)input_byte_3 ^ 0xffUL;
-    tmp_input[input_index_4] = (unsigned long)input_byte_4 ^ 0xffUL;
-    tmp_input[input_index_5] = (unsigned long)input_byte_5 ^ 0xffUL;
-    tmp_input[input_index_6] = (unsigned long)input_byte_6 ^ 0xffUL;
-    tmp_input[input_index_7] = (unsigned long)input_byte_7 ^ 0xffUL;
-    int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-    if (valid_eval) {
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - flip64] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.flip64++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
-    return 0;
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3, input_index_4, input_index_5,
+                               input_index_6, input_index_7};
+
+    __det_candidates_init(8);
+    __det_candidates_add(~__det_read_value(current_testcase, indexes, 8),
+                         &ctx->stats.flip64, "flip64");
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 8);
 }
 
 static __always_inline int SUBPHASE_afl_det_arith64(
@@ -4724,442 +6477,112 @@ static __always_inline int SUBPHASE_afl_det_arith64(
     if (unlikely(skip_afl_det_arith64))
         return 0;
 
+    static const char* names[] = {"arith64-sum-LE", "arith64-sub-LE",
+                                  "arith64-sum-BE", "arith64-sub-BE"};
+
     testcase_t* current_testcase = &ctx->testcases.data[0];
 
-    unsigned char input_byte_0 =
-        (unsigned char)current_testcase->values[input_index_0];
-    unsigned char input_byte_1 =
-        (unsigned char)current_testcase->values[input_index_1];
-    unsigned char input_byte_2 =
-        (unsigned char)current_testcase->values[input_index_2];
-    unsigned char input_byte_3 =
-        (unsigned char)current_testcase->values[input_index_3];
-    unsigned char input_byte_4 =
-        (unsigned char)current_testcase->values[input_index_4];
-    unsigned char input_byte_5 =
-        (unsigned char)current_testcase->values[input_index_5];
-    unsigned char input_byte_6 =
-        (unsigned char)current_testcase->values[input_index_6];
-    unsigned char input_byte_7 =
-        (unsigned char)current_testcase->values[input_index_7];
-
-    unsigned long input_qword_LE =
-        ((ulong)input_byte_7 << 56) | ((ulong)input_byte_6 << 48) |
-        ((ulong)input_byte_5 << 40) | ((ulong)input_byte_4 << 32) |
-        ((ulong)input_byte_3 << 24) | ((ulong)input_byte_2 << 16) |
-        ((ulong)input_byte_1 << 8) | (ulong)input_byte_0;
-    unsigned long input_qword_BE =
-        ((ulong)input_byte_0 << 56) | ((ulong)input_byte_1 << 48) |
-        ((ulong)input_byte_2 << 40) | ((ulong)input_byte_3 << 32) |
-        ((ulong)input_byte_4 << 24) | ((ulong)input_byte_5 << 16) |
-        ((ulong)input_byte_6 << 8) | (ulong)input_byte_7;
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3, input_index_4, input_index_5,
+                               input_index_6, input_index_7};
+
+    __det_candidates_init(8);
+    __det_add_arith(__det_read_value(current_testcase, indexes, 8), 8,
+                    &ctx->stats.arith64_sum_LE, &ctx->stats.arith64_sub_LE,
+                    &ctx->stats.arith64_sum_BE, &ctx->stats.arith64_sub_BE,
+                    names);
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 8);
+}
 
-    unsigned long tmp;
+static __always_inline int
+SUBPHASE_afl_det_int64(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+                       unsigned char const** proof, unsigned long* proof_size,
+                       unsigned long input_index_0, unsigned long input_index_1,
+                       unsigned long input_index_2, unsigned long input_index_3,
+                       unsigned long input_index_4, unsigned long input_index_5,
+                       unsigned long input_index_6, unsigned long input_index_7)
+{
+    if (unlikely(skip_afl_det_int32))
+        return 0;
+
+    unsigned long indexes[] = {input_index_0, input_index_1, input_index_2,
+                               input_index_3, input_index_4, input_index_5,
+                               input_index_6, input_index_7};
+
+    __det_candidates_init(8);
+    unsigned i;
+    for (i = 0; i < sizeof(interesting64) / sizeof(long); ++i)
+        __det_candidates_add((uint64_t)interesting64[i], &ctx->stats.int64,
+                             "int64");
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, 8);
+}
+
+static __always_inline int SUBPHASE_afl_det_dictionary(
+    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+    unsigned char const** proof, unsigned long* proof_size, index_group_t* g)
+{
+    if (det_tokens_size == 0)
+        return 0;
+    if (g->n != 1 && g->n != 2 && g->n != 4 && g->n != 8)
+        return 0;
+
+    unsigned long indexes[MAX_GROUP_SIZE];
     unsigned      i;
-    for (i = 1; i < 35; ++i) {
-        tmp                      = input_qword_LE + i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 24) & 0xffUL);
-        tmp_input[input_index_4] = (unsigned long)((tmp >> 32) & 0xffUL);
-        tmp_input[input_index_5] = (unsigned long)((tmp >> 40) & 0xffUL);
-        tmp_input[input_index_6] = (unsigned long)((tmp >> 48) & 0xffUL);
-        tmp_input[input_index_7] = (unsigned long)((tmp >> 56) & 0xffUL);
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith64-sum-LE] "
-                           "Query is SAT\n");
+    for (i = 0; i < g->n; ++i)
+        indexes[i] = g->indexes[i];
+
+    __det_candidates_init(g->n);
+    for (i = 0; i < det_tokens_size; ++i) {
+        unsigned long token = det_tokens[i];
+        if (__token_width(token) > g->n)
+            continue;
+        __det_candidates_add(token, &ctx->stats.dictionary, "dictionary");
+        if (g->n > 1)
+            __det_candidates_add(__det_swap(token, g->n),
+                                 &ctx->stats.dictionary, "dictionary");
+    }
+    return __det_eval_candidates(ctx, query, branch_condition, proof,
+                                 proof_size, indexes, g->n);
+}
+
+static __always_inline int PHASE_afl_deterministic_groups(
+    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+    unsigned char const** proof, unsigned long* proof_size)
+{
+    if (unlikely(skip_afl_deterministic))
+        return 0;
+
+    int            ret;
+    testcase_t*    current_testcase = &ctx->testcases.data[0];
+    index_group_t* g;
+
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying AFL Deterministic (groups)\n");
 #endif
-                ctx->stats.arith64_sum_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_qword_LE - i;
-        tmp_input[input_index_0] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 24) & 0xffUL);
-        tmp_input[input_index_4] = (unsigned long)((tmp >> 32) & 0xffUL);
-        tmp_input[input_index_5] = (unsigned long)((tmp >> 40) & 0xffUL);
-        tmp_input[input_index_6] = (unsigned long)((tmp >> 48) & 0xffUL);
-        tmp_input[input_index_7] = (unsigned long)((tmp >> 56) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith64-sub-LE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith64_sub_LE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_qword_BE + i;
-        tmp_input[input_index_7] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_6] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_5] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_4] = (unsigned long)((tmp >> 24) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 32) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 40) & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 48) & 0xffUL);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 56) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith64-sum-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith64_sum_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-        tmp                      = input_qword_BE - i;
-        tmp_input[input_index_7] = (unsigned long)(tmp & 0xffUL);
-        tmp_input[input_index_6] = (unsigned long)((tmp >> 8) & 0xffUL);
-        tmp_input[input_index_5] = (unsigned long)((tmp >> 16) & 0xffUL);
-        tmp_input[input_index_4] = (unsigned long)((tmp >> 24) & 0xffUL);
-        tmp_input[input_index_3] = (unsigned long)((tmp >> 32) & 0xffUL);
-        tmp_input[input_index_2] = (unsigned long)((tmp >> 40) & 0xffUL);
-        tmp_input[input_index_1] = (unsigned long)((tmp >> 48) & 0xffUL);
-        tmp_input[input_index_0] = (unsigned long)((tmp >> 56) & 0xffUL);
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len) &&
-                     is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - arith64-sub-BE] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.arith64_sub_BE++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-    }
-    return 0;
-}
-
-static __always_inline int
-SUBPHASE_afl_det_int64(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-                       unsigned char const** proof, unsigned long* proof_size,
-                       unsigned long input_index_0, unsigned long input_index_1,
-                       unsigned long input_index_2, unsigned long input_index_3,
-                       unsigned long input_index_4, unsigned long input_index_5,
-                       unsigned long input_index_6, unsigned long input_index_7)
-{
-    if (unlikely(skip_afl_det_int32))
-        return 0;
-
-    testcase_t* current_testcase = &ctx->testcases.data[0];
-
-    unsigned i;
-    for (i = 0; i < sizeof(interesting64) / sizeof(long); ++i) {
-        tmp_input[input_index_0] = (unsigned long)(interesting64[i]) & 0xffU;
-        tmp_input[input_index_1] =
-            (unsigned long)(interesting64[i] >> 8) & 0xffU;
-        tmp_input[input_index_2] =
-            (unsigned long)(interesting64[i] >> 16) & 0xffU;
-        tmp_input[input_index_3] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_4] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_5] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_6] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_7] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        int valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int64] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int64++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-
-#if 0
-        tmp_input[input_index_7] = (unsigned long)(interesting64[i]) & 0xffU;
-        tmp_input[input_index_6] =
-            (unsigned long)(interesting64[i] >> 8) & 0xffU;
-        tmp_input[input_index_5] =
-            (unsigned long)(interesting64[i] >> 16) & 0xffU;
-        tmp_input[input_index_4] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_3] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_2] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_1] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        tmp_input[input_index_0] =
-            (unsigned long)(interesting64[i] >> 24) & 0xffU;
-        valid_eval = is_valid_eval_index(ctx, input_index_0, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_1, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_2, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_3, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_4, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_5, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_6, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len) &&
-                         is_valid_eval_index(ctx, input_index_7, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - int64] "
-                           "Query is SAT\n");
-#endif
-                ctx->stats.int64++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-#endif
-    }
-    return 0;
-}
-
-static __always_inline int PHASE_afl_deterministic_groups(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size)
-{
-    if (unlikely(skip_afl_deterministic))
-        return 0;
-
-    int            ret;
-    testcase_t*    current_testcase = &ctx->testcases.data[0];
-    index_group_t* g;
-
-#ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying AFL Deterministic (groups)\n");
-#endif
-
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 1);
-    while (
-        set_iter_next__index_group_t(&ast_data.inputs->index_groups, 1, &g)) {
-        unsigned i;
-        // flip 1/2/4 int8 -> do for every group type
-        for (i = 0; i < g->n; ++i) {
-            unsigned long input_index = g->indexes[i];
-
-            ret = SUBPHASE_afl_det_single_waliking_bit(
-                ctx, query, branch_condition, proof, proof_size, input_index);
-            if (unlikely(ret == TIMEOUT_V))
-                return TIMEOUT_V;
-            if (ret)
-                return 1;
-
-            ret = SUBPHASE_afl_det_two_waliking_bits(
-                ctx, query, branch_condition, proof, proof_size, input_index);
-            if (unlikely(ret == TIMEOUT_V))
-                return TIMEOUT_V;
-            if (ret)
-                return 1;
-
-            ret = SUBPHASE_afl_det_four_waliking_bits(
-                ctx, query, branch_condition, proof, proof_size, input_index);
-            if (unlikely(ret == TIMEOUT_V))
-                return TIMEOUT_V;
-            if (ret)
-                return 1;
-
-            ret = SUBPHASE_afl_det_int8(ctx, query, branch_condition, proof,
-                                        proof_size, input_index);
-            if (unlikely(ret == TIMEOUT_V))
+
+    __det_tokens_prepare(ctx);
+
+    da__index_group_t* groups = __get_query_groups();
+    unsigned long      gi;
+    for (gi = 0; gi < groups->size; ++gi) {
+        g = &groups->data[gi];
+        unsigned i;
+        unsigned checkpoint = checkpoint_tmp_input();
+        // flip 1/2/4 int8 -> do for every group type
+        for (i = 0; i < g->n; ++i) {
+            unsigned long input_index = g->indexes[i];
+
+            ret = SUBPHASE_afl_det_byte(ctx, query, branch_condition, proof,
+                                        proof_size, input_index, 0);
+            if (unlikely(ret == TIMEOUT_V))
                 return TIMEOUT_V;
             if (ret)
                 return 1;
 
-            tmp_input[input_index] =
-                (unsigned long)current_testcase->values[input_index];
+            set_tmp_input(input_index,
+                          (unsigned long)current_testcase->values[input_index]);
         }
 
         switch (g->n) {
@@ -5205,16 +6628,16 @@ static __always_inline int PHASE_afl_deterministic_groups(
                     if (ret)
                         return 1;
 
-                    tmp_input[g->indexes[1] + 1] =
-                        current_testcase->values[g->indexes[1] + 1];
-                    tmp_input[g->indexes[1] + 2] =
-                        current_testcase->values[g->indexes[1] + 2];
+                    set_tmp_input(g->indexes[1] + 1,
+                                  current_testcase->values[g->indexes[1] + 1]);
+                    set_tmp_input(g->indexes[1] + 2,
+                                  current_testcase->values[g->indexes[1] + 2]);
                 }
 
-                tmp_input[g->indexes[0]] =
-                    current_testcase->values[g->indexes[0]];
-                tmp_input[g->indexes[1]] =
-                    current_testcase->values[g->indexes[1]];
+                set_tmp_input(g->indexes[0],
+                              current_testcase->values[g->indexes[0]]);
+                set_tmp_input(g->indexes[1],
+                              current_testcase->values[g->indexes[1]]);
                 break;
             }
             case 4: {
@@ -5263,24 +6686,24 @@ static __always_inline int PHASE_afl_deterministic_groups(
                         return TIMEOUT_V;
                     if (ret)
                         return 1;
-                    tmp_input[g->indexes[3] + 1] =
-                        current_testcase->values[g->indexes[3] + 1];
-                    tmp_input[g->indexes[3] + 2] =
-                        current_testcase->values[g->indexes[3] + 2];
-                    tmp_input[g->indexes[3] + 3] =
-                        current_testcase->values[g->indexes[3] + 3];
-                    tmp_input[g->indexes[3] + 4] =
-                        current_testcase->values[g->indexes[3] + 4];
+                    set_tmp_input(g->indexes[3] + 1,
+                                  current_testcase->values[g->indexes[3] + 1]);
+                    set_tmp_input(g->indexes[3] + 2,
+                                  current_testcase->values[g->indexes[3] + 2]);
+                    set_tmp_input(g->indexes[3] + 3,
+                                  current_testcase->values[g->indexes[3] + 3]);
+                    set_tmp_input(g->indexes[3] + 4,
+                                  current_testcase->values[g->indexes[3] + 4]);
                 }
 
-                tmp_input[g->indexes[0]] =
-                    current_testcase->values[g->indexes[0]];
-                tmp_input[g->indexes[1]] =
-                    current_testcase->values[g->indexes[1]];
-                tmp_input[g->indexes[2]] =
-                    current_testcase->values[g->indexes[2]];
-                tmp_input[g->indexes[3]] =
-                    current_testcase->values[g->indexes[3]];
+                set_tmp_input(g->indexes[0],
+                              current_testcase->values[g->indexes[0]]);
+                set_tmp_input(g->indexes[1],
+                              current_testcase->values[g->indexes[1]]);
+                set_tmp_input(g->indexes[2],
+                              current_testcase->values[g->indexes[2]]);
+                set_tmp_input(g->indexes[3],
+                              current_testcase->values[g->indexes[3]]);
 
                 break;
             }
@@ -5315,22 +6738,22 @@ static __always_inline int PHASE_afl_deterministic_groups(
                 if (ret)
                     return 1;
 
-                tmp_input[g->indexes[0]] =
-                    current_testcase->values[g->indexes[0]];
-                tmp_input[g->indexes[1]] =
-                    current_testcase->values[g->indexes[1]];
-                tmp_input[g->indexes[2]] =
-                    current_testcase->values[g->indexes[2]];
-                tmp_input[g->indexes[3]] =
-                    current_testcase->values[g->indexes[3]];
-                tmp_input[g->indexes[4]] =
-                    current_testcase->values[g->indexes[4]];
-                tmp_input[g->indexes[5]] =
-                    current_testcase->values[g->indexes[5]];
-                tmp_input[g->indexes[6]] =
-                    current_testcase->values[g->indexes[6]];
-                tmp_input[g->indexes[7]] =
-                    current_testcase->values[g->indexes[7]];
+                set_tmp_input(g->indexes[0],
+                              current_testcase->values[g->indexes[0]]);
+                set_tmp_input(g->indexes[1],
+                              current_testcase->values[g->indexes[1]]);
+                set_tmp_input(g->indexes[2],
+                              current_testcase->values[g->indexes[2]]);
+                set_tmp_input(g->indexes[3],
+                              current_testcase->values[g->indexes[3]]);
+                set_tmp_input(g->indexes[4],
+                              current_testcase->values[g->indexes[4]]);
+                set_tmp_input(g->indexes[5],
+                              current_testcase->values[g->indexes[5]]);
+                set_tmp_input(g->indexes[6],
+                              current_testcase->values[g->indexes[6]]);
+                set_tmp_input(g->indexes[7],
+                              current_testcase->values[g->indexes[7]]);
                 break;
             }
             default: {
@@ -5404,40 +6827,53 @@ static __always_inline int PHASE_afl_deterministic_groups(
                                 if (ret)
                                     return 1;
 
-                                tmp_input[g->indexes[i] + 4] =
-                                    (unsigned long)current_testcase
-                                        ->values[g->indexes[i] + 4];
-                                tmp_input[g->indexes[i] + 5] =
-                                    (unsigned long)current_testcase
-                                        ->values[g->indexes[i] + 5];
-                                tmp_input[g->indexes[i] + 6] =
-                                    (unsigned long)current_testcase
-                                        ->values[g->indexes[i] + 6];
-                                tmp_input[g->indexes[i] + 7] =
-                                    (unsigned long)current_testcase
-                                        ->values[g->indexes[i] + 7];
+                                set_tmp_input(
+                                    g->indexes[i] + 4,
+                                    current_testcase
+                                        ->values[g->indexes[i] + 4]);
+                                set_tmp_input(
+                                    g->indexes[i] + 5,
+                                    current_testcase
+                                        ->values[g->indexes[i] + 5]);
+                                set_tmp_input(
+                                    g->indexes[i] + 6,
+                                    current_testcase
+                                        ->values[g->indexes[i] + 6]);
+                                set_tmp_input(
+                                    g->indexes[i] + 7,
+                                    current_testcase
+                                        ->values[g->indexes[i] + 7]);
                             }
 
-                            tmp_input[g->indexes[i] + 2] =
-                                (unsigned long)
-                                    current_testcase->values[g->indexes[i] + 2];
-                            tmp_input[g->indexes[i] + 3] =
-                                (unsigned long)
-                                    current_testcase->values[g->indexes[i] + 3];
+                            set_tmp_input(
+                                g->indexes[i] + 2,
+                                current_testcase->values[g->indexes[i] + 2]);
+                            set_tmp_input(
+                                g->indexes[i] + 3,
+                                current_testcase->values[g->indexes[i] + 3]);
                         }
 #endif
 
-                        tmp_input[g->indexes[i] + 1] =
-                            (unsigned long)
-                                current_testcase->values[g->indexes[i] + 1];
+                        set_tmp_input(
+                            g->indexes[i] + 1,
+                            current_testcase->values[g->indexes[i] + 1]);
                     }
 
-                    tmp_input[g->indexes[i]] =
-                        (unsigned long)current_testcase->values[g->indexes[i]];
+                    set_tmp_input(g->indexes[i],
+                                  current_testcase->values[g->indexes[i]]);
                 }
                 break;
             }
         }
+
+        // dictionary tokens
+        ret = SUBPHASE_afl_det_dictionary(ctx, query, branch_condition, proof,
+                                          proof_size, g);
+        if (unlikely(ret == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (ret)
+            return 1;
+        rollback_tmp_input(checkpoint);
     }
     return 0;
 }
@@ -5466,56 +6902,16 @@ PHASE_afl_deterministic(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         // ***** byte *****
         // ****************
 
-        // single waling bit
-        ret = SUBPHASE_afl_det_single_waliking_bit(
-            ctx, query, branch_condition, proof, proof_size, input_index_0);
-        if (unlikely(ret == TIMEOUT_V))
-            return TIMEOUT_V;
-        if (ret)
-            return 1;
-
-        // two walking bits
-        ret = SUBPHASE_afl_det_two_waliking_bits(
-            ctx, query, branch_condition, proof, proof_size, input_index_0);
-        if (unlikely(ret == TIMEOUT_V))
-            return TIMEOUT_V;
-        if (ret)
-            return 1;
-
-        // four walking bits
-        ret = SUBPHASE_afl_det_four_waliking_bits(
-            ctx, query, branch_condition, proof, proof_size, input_index_0);
-        if (unlikely(ret == TIMEOUT_V))
-            return TIMEOUT_V;
-        if (ret)
-            return 1;
-
-        // byte flip
-        ret = SUBPHASE_afl_det_byte_flip(ctx, query, branch_condition, proof,
-                                         proof_size, input_index_0);
-        if (unlikely(ret == TIMEOUT_V))
-            return TIMEOUT_V;
-        if (ret)
-            return 1;
-
-        // 8-bit arithmetics
-        ret = SUBPHASE_afl_det_arith8(ctx, query, branch_condition, proof,
-                                      proof_size, input_index_0);
-        if (unlikely(ret == TIMEOUT_V))
-            return TIMEOUT_V;
-        if (ret)
-            return 1;
-
-        // interesting 8
-        ret = SUBPHASE_afl_det_int8(ctx, query, branch_condition, proof,
-                                    proof_size, input_index_0);
+        // walking bits, byte flip, 8-bit arithmetics and interesting 8
+        ret = SUBPHASE_afl_det_byte(ctx, query, branch_condition, proof,
+                                    proof_size, input_index_0, 1);
         if (unlikely(ret == TIMEOUT_V))
             return TIMEOUT_V;
         if (ret)
             return 1;
 
-        tmp_input[input_index_0] =
-            (unsigned long)current_testcase->values[input_index_0];
+        set_tmp_input(input_index_0,
+                      (unsigned long)current_testcase->values[input_index_0]);
         if (!set_check__ulong(&ast_data.inputs->indexes, input_index_0 + 1))
             continue; // only one byte. Skip
 
@@ -5550,8 +6946,8 @@ PHASE_afl_deterministic(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         if (ret)
             return 1;
 
-        tmp_input[input_index_0] = current_testcase->values[input_index_0];
-        tmp_input[input_index_1] = current_testcase->values[input_index_1];
+        set_tmp_input(input_index_0, current_testcase->values[input_index_0]);
+        set_tmp_input(input_index_1, current_testcase->values[input_index_1]);
 
         if (!set_check__ulong(&ast_data.inputs->indexes, input_index_0 + 2) ||
             !set_check__ulong(&ast_data.inputs->indexes, input_index_0 + 3))
@@ -5590,10 +6986,10 @@ PHASE_afl_deterministic(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         if (ret)
             return 1;
 
-        tmp_input[input_index_0] = current_testcase->values[input_index_0];
-        tmp_input[input_index_1] = current_testcase->values[input_index_1];
-        tmp_input[input_index_2] = current_testcase->values[input_index_2];
-        tmp_input[input_index_3] = current_testcase->values[input_index_3];
+        set_tmp_input(input_index_0, current_testcase->values[input_index_0]);
+        set_tmp_input(input_index_1, current_testcase->values[input_index_1]);
+        set_tmp_input(input_index_2, current_testcase->values[input_index_2]);
+        set_tmp_input(input_index_3, current_testcase->values[input_index_3]);
     }
 
     return 0;
@@ -5661,9 +7057,9 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
     while (set_iter_next__ulong(&ast_data.inputs->indexes, 1, &p)) {
         indexes[i++] = *p;
     }
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 1);
-    while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 1,
-                                        &group)) {
+    da__index_group_t* groups = __get_query_groups();
+    for (i = 0; i < groups->size; ++i) {
+        group = &groups->data[i];
         switch (group->n) {
             case 1:
                 break;
@@ -5690,33 +7086,40 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
             case 0: {
                 // flip bit
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] =
-                    (unsigned long)FLIP_BIT(tmp_input[random_index], UR(8));
+                set_tmp_input(random_index,
+                              FLIP_BIT(tmp_input[random_index], UR(8)));
                 break;
             }
             case 1: {
                 // set interesting byte
-                random_index            = indexes[UR(indexes_size)];
-                tmp_input[random_index] = (unsigned long)
-                    interesting8[UR(sizeof(interesting8) / sizeof(char))];
+                random_index = indexes[UR(indexes_size)];
+                set_tmp_input(
+                    random_index,
+                    (unsigned long)interesting8[UR(sizeof(interesting8))]);
                 break;
             }
             case 2: {
                 // random subtract byte
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] -= (unsigned char)(UR(35) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] -
+                                  (unsigned char)(UR(35) + 1));
                 break;
             }
             case 3: {
                 // random add byte
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] += (unsigned char)(UR(35) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] +
+                                  (unsigned char)(UR(35) + 1));
                 break;
             }
             case 4: {
                 // random, byte set
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] ^= (unsigned char)(UR(255) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] ^
+                                  (unsigned char)(UR(255) + 1));
                 break;
             }
             case 5: {
@@ -5750,8 +7153,8 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                     index_0 = index_1;
                     index_1 = tmp;
                 }
-                tmp_input[index_0] = val_0;
-                tmp_input[index_1] = val_1;
+                set_tmp_input(index_0, val_0);
+                set_tmp_input(index_1, val_1);
                 break;
             }
             case 6: {
@@ -5783,8 +7186,8 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                 }
                 short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val -= UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
                 break;
             }
             case 7: {
@@ -5816,8 +7219,8 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                 }
                 short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val += UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
                 break;
             }
             case 8: {
@@ -5855,10 +7258,10 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                     index_2 = index_3;
                     index_3 = tmp;
                 }
-                tmp_input[index_0] = val_0;
-                tmp_input[index_1] = val_1;
-                tmp_input[index_2] = val_2;
-                tmp_input[index_3] = val_3;
+                set_tmp_input(index_0, val_0);
+                set_tmp_input(index_1, val_1);
+                set_tmp_input(index_2, val_2);
+                set_tmp_input(index_3, val_3);
                 break;
             }
             case 9: {
@@ -5894,10 +7297,10 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                           (tmp_input[index_2] << 16) |
                           (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val -= UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
-                tmp_input[index_2] = (val >> 16) & 0xff;
-                tmp_input[index_3] = (val >> 24) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
+                set_tmp_input(index_2, (val >> 16) & 0xff);
+                set_tmp_input(index_3, (val >> 24) & 0xff);
                 break;
             }
             case 10: {
@@ -5933,10 +7336,10 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
                           (tmp_input[index_2] << 16) |
                           (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val += UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
-                tmp_input[index_2] = (val >> 16) & 0xff;
-                tmp_input[index_3] = (val >> 24) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
+                set_tmp_input(index_2, (val >> 16) & 0xff);
+                set_tmp_input(index_3, (val >> 24) & 0xff);
                 break;
             }
             default: {
@@ -5954,8 +7357,7 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.havoc++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             havoc_res   = 1;
@@ -5972,6 +7374,45 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
     return havoc_res;
 }
 
+// write a dictionary token in a random group (or byte) that can hold it
+static inline void
+__havoc_set_token(fuzzy_ctx_t* ctx, unsigned long* indexes,
+                  unsigned long indexes_size, index_group_t** ig_16,
+                  unsigned long ig_16_size, index_group_t** ig_32,
+                  unsigned long ig_32_size, index_group_t** ig_64,
+                  unsigned long ig_64_size)
+{
+    unsigned long token = __token_dict_pick(ctx);
+    unsigned      width = __token_width(token);
+
+    if (width <= 1) {
+        set_tmp_input(indexes[UR(indexes_size)], token & 0xffUL);
+        return;
+    }
+
+    unsigned long n_16 = width <= 2 ? ig_16_size : 0;
+    unsigned long n_32 = width <= 4 ? ig_32_size : 0;
+    if (n_16 + n_32 + ig_64_size == 0)
+        return;
+
+    index_group_t* group;
+    unsigned long  pool = UR(n_16 + n_32 + ig_64_size);
+    if (pool < n_16)
+        group = ig_16[pool];
+    else if (pool < n_16 + n_32)
+        group = ig_32[pool - n_16];
+    else
+        group = ig_64[pool - n_16 - n_32];
+
+    unsigned offset = UR(group->n - width + 1);
+    int      be     = UR(2);
+    unsigned k;
+    for (k = 0; k < width; ++k) {
+        unsigned long index = group->indexes[offset + (be ? width - k - 1 : k)];
+        set_tmp_input(index, (token >> (k * 8)) & 0xffUL);
+    }
+}
+
 static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                                            Z3_ast branch_condition,
                                            unsigned char const** proof,
@@ -5999,6 +7440,7 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
     unsigned        tmp;
     unsigned        random_tmp;
     unsigned        mutation_pool;
+    unsigned        use_tokens;
     unsigned        score;
     unsigned long*  indexes;
     unsigned long   indexes_size;
@@ -6034,9 +7476,9 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
     while (set_iter_next__ulong(&ast_data.inputs->indexes, 1, &p)) {
         indexes[i++] = *p;
     }
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 1);
-    while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 1,
-                                        &group)) {
+    da__index_group_t* groups = __get_query_groups();
+    for (i = 0; i < groups->size; ++i) {
+        group = &groups->data[i];
         switch (group->n) {
             case 1:
                 break;
@@ -6055,41 +7497,56 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
     havoc_res     = 0;
     mutation_pool = 5 + (ig_64_size + ig_32_size + ig_16_size > 0 ? 3 : 0) +
                     (ig_64_size + ig_32_size > 0 ? 3 : 0);
+    use_tokens = __token_dict_available(ctx);
     score = ast_data.inputs->indexes.size * HAVOC_C;
     for (i = 0; i < score; ++i) {
         unsigned K = 1 << (1 + UR(HAVOC_STACK_POW2));
         for (j = 0; j < K; ++j) {
-            switch (UR(mutation_pool)) {
+            unsigned mutation = UR(mutation_pool + use_tokens);
+            if (mutation == mutation_pool) {
+                // set dictionary token
+                __havoc_set_token(ctx, indexes, indexes_size, ig_16, ig_16_size,
+                                  ig_32, ig_32_size, ig_64, ig_64_size);
+                continue;
+            }
+            switch (mutation) {
                 case 0: {
                     // flip bit
                     random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] =
-                        (unsigned long)FLIP_BIT(tmp_input[random_index], UR(8));
+                    set_tmp_input(random_index,
+                                  FLIP_BIT(tmp_input[random_index], UR(8)));
                     break;
                 }
                 case 1: {
                     // set interesting byte
-                    random_index            = indexes[UR(indexes_size)];
-                    tmp_input[random_index] = (unsigned long)
-                        interesting8[UR(sizeof(interesting8) / sizeof(char))];
+                    random_index = indexes[UR(indexes_size)];
+                    set_tmp_input(
+                        random_index,
+                        (unsigned long)interesting8[UR(sizeof(interesting8))]);
                     break;
                 }
                 case 2: {
                     // random subtract byte
                     random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] -= (unsigned char)(UR(35) + 1);
+                    set_tmp_input(random_index,
+                                  tmp_input[random_index] -
+                                      (unsigned char)(UR(35) + 1));
                     break;
                 }
                 case 3: {
                     // random add byte
                     random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] += (unsigned char)(UR(35) + 1);
+                    set_tmp_input(random_index,
+                                  tmp_input[random_index] +
+                                      (unsigned char)(UR(35) + 1));
                     break;
                 }
                 case 4: {
                     // random, byte set
                     random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] ^= (unsigned char)(UR(255) + 1);
+                    set_tmp_input(random_index,
+                                  tmp_input[random_index] ^
+                                      (unsigned char)(UR(255) + 1));
                     break;
                 }
                 case 5: {
@@ -6123,8 +7580,8 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                         index_0 = index_1;
                         index_1 = tmp;
                     }
-                    tmp_input[index_0] = val_0;
-                    tmp_input[index_1] = val_1;
+                    set_tmp_input(index_0, val_0);
+                    set_tmp_input(index_1, val_1);
                     break;
                 }
                 case 6: {
@@ -6156,8 +7613,8 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                     }
                     short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                     val -= UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
+                    set_tmp_input(index_0, val & 0xff);
+                    set_tmp_input(index_1, (val >> 8) & 0xff);
                     break;
                 }
                 case 7: {
@@ -6189,8 +7646,8 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                     }
                     short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                     val += UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
+                    set_tmp_input(index_0, val & 0xff);
+                    set_tmp_input(index_1, (val >> 8) & 0xff);
                     break;
                 }
                 case 8: {
@@ -6228,10 +7685,10 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                         index_2 = index_3;
                         index_3 = tmp;
                     }
-                    tmp_input[index_0] = val_0;
-                    tmp_input[index_1] = val_1;
-                    tmp_input[index_2] = val_2;
-                    tmp_input[index_3] = val_3;
+                    set_tmp_input(index_0, val_0);
+                    set_tmp_input(index_1, val_1);
+                    set_tmp_input(index_2, val_2);
+                    set_tmp_input(index_3, val_3);
                     break;
                 }
                 case 9: {
@@ -6267,10 +7724,10 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                               (tmp_input[index_2] << 16) |
                               (tmp_input[index_1] << 8) | tmp_input[index_0];
                     val -= UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    tmp_input[index_2] = (val >> 16) & 0xff;
-                    tmp_input[index_3] = (val >> 24) & 0xff;
+                    set_tmp_input(index_0, val & 0xff);
+                    set_tmp_input(index_1, (val >> 8) & 0xff);
+                    set_tmp_input(index_2, (val >> 16) & 0xff);
+                    set_tmp_input(index_3, (val >> 24) & 0xff);
                     break;
                 }
                 case 10: {
@@ -6306,10 +7763,10 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
                               (tmp_input[index_2] << 16) |
                               (tmp_input[index_1] << 8) | tmp_input[index_0];
                     val += UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    tmp_input[index_2] = (val >> 16) & 0xff;
-                    tmp_input[index_3] = (val >> 24) & 0xff;
+                    set_tmp_input(index_0, val & 0xff);
+                    set_tmp_input(index_1, (val >> 8) & 0xff);
+                    set_tmp_input(index_2, (val >> 16) & 0xff);
+                    set_tmp_input(index_3, (val >> 24) & 0xff);
                     break;
                 }
                 default: {
@@ -6328,8 +7785,7 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.havoc++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             havoc_res   = 1;
@@ -6460,33 +7916,40 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
             case 0: {
                 // flip bit
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] =
-                    (unsigned long)FLIP_BIT(tmp_input[random_index], UR(8));
+                set_tmp_input(random_index,
+                              FLIP_BIT(tmp_input[random_index], UR(8)));
                 break;
             }
             case 1: {
                 // set interesting byte
-                random_index            = indexes[UR(indexes_size)];
-                tmp_input[random_index] = (unsigned long)
-                    interesting8[UR(sizeof(interesting8) / sizeof(char))];
+                random_index = indexes[UR(indexes_size)];
+                set_tmp_input(
+                    random_index,
+                    (unsigned long)interesting8[UR(sizeof(interesting8))]);
                 break;
             }
             case 2: {
                 // random subtract byte
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] -= (unsigned char)(UR(35) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] -
+                                  (unsigned char)(UR(35) + 1));
                 break;
             }
             case 3: {
                 // random add byte
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] += (unsigned char)(UR(35) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] +
+                                  (unsigned char)(UR(35) + 1));
                 break;
             }
             case 4: {
                 // random, byte set
                 random_index = indexes[UR(indexes_size)];
-                tmp_input[random_index] ^= (unsigned char)(UR(255) + 1);
+                set_tmp_input(random_index,
+                              tmp_input[random_index] ^
+                                  (unsigned char)(UR(255) + 1));
                 break;
             }
             case 5: {
@@ -6520,8 +7983,8 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                     index_0 = index_1;
                     index_1 = tmp;
                 }
-                tmp_input[index_0] = val_0;
-                tmp_input[index_1] = val_1;
+                set_tmp_input(index_0, val_0);
+                set_tmp_input(index_1, val_1);
                 break;
             }
             case 6: {
@@ -6553,8 +8016,8 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                 }
                 short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val -= UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
                 break;
             }
             case 7: {
@@ -6586,8 +8049,8 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                 }
                 short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val += UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
                 break;
             }
             case 8: {
@@ -6625,10 +8088,10 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                     index_2 = index_3;
                     index_3 = tmp;
                 }
-                tmp_input[index_0] = val_0;
-                tmp_input[index_1] = val_1;
-                tmp_input[index_2] = val_2;
-                tmp_input[index_3] = val_3;
+                set_tmp_input(index_0, val_0);
+                set_tmp_input(index_1, val_1);
+                set_tmp_input(index_2, val_2);
+                set_tmp_input(index_3, val_3);
                 break;
             }
             case 9: {
@@ -6664,10 +8127,10 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                           (tmp_input[index_2] << 16) |
                           (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val -= UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
-                tmp_input[index_2] = (val >> 16) & 0xff;
-                tmp_input[index_3] = (val >> 24) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
+                set_tmp_input(index_2, (val >> 16) & 0xff);
+                set_tmp_input(index_3, (val >> 24) & 0xff);
                 break;
             }
             case 10: {
@@ -6703,10 +8166,10 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
                           (tmp_input[index_2] << 16) |
                           (tmp_input[index_1] << 8) | tmp_input[index_0];
                 val += UR(35) + 1;
-                tmp_input[index_0] = val & 0xff;
-                tmp_input[index_1] = (val >> 8) & 0xff;
-                tmp_input[index_2] = (val >> 16) & 0xff;
-                tmp_input[index_3] = (val >> 24) & 0xff;
+                set_tmp_input(index_0, val & 0xff);
+                set_tmp_input(index_1, (val >> 8) & 0xff);
+                set_tmp_input(index_2, (val >> 16) & 0xff);
+                set_tmp_input(index_3, (val >> 24) & 0xff);
                 break;
             }
             default: {
@@ -6724,8 +8187,7 @@ static __always_inline int PHASE_afl_havoc_whole_pi(fuzzy_ctx_t* ctx,
 #endif
             ctx->stats.havoc++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             havoc_res   = 1;
@@ -6771,45 +8233,40 @@ PHASE_range_bruteforce(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         ig->n > 0,
         "PHASE_range_bruteforce() - group size <= 0. It shouldn't happen");
 
-    wrapped_interval_t* interval =
+    wrapped_interval_set_t* interval =
         interval_group_get_interval(group_intervals, ig);
     if (interval == 0)
         return 0; // no interval
 
-    if (wi_get_range(interval) > RANGE_MAX_WIDTH_BRUTE_FORCE)
+    if (wis_get_range(interval) > RANGE_MAX_WIDTH_BRUTE_FORCE)
         goto TRY_MIN_MAX; // range too wide
 
-    wrapped_interval_iter_t it = wi_init_iter_values(interval);
-    uint64_t                val;
-    while (wi_iter_get_next(&it, &val)) {
-        set_tmp_input_group_to_value(ig, val);
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
+    wrapped_interval_iter_t it = wis_init_iter_values(interval);
+    int eval_v = __range_bruteforce_group(ctx, query, branch_condition, ig,
+                                          &it, RANGE_MAX_WIDTH_BRUTE_FORCE + 1);
+    if (eval_v == 1) {
 #ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - range bruteforce] Query is SAT\n");
+        Z3FUZZ_LOG("[check light - range bruteforce] Query is SAT\n");
 #endif
-            ctx->stats.range_brute_force++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
-    }
+        ctx->stats.range_brute_force++;
+        ctx->stats.num_sat++;
+        __set_proof(ctx, tmp_input);
+        *proof      = tmp_proof;
+        *proof_size = current_testcase->testcase_len;
+        return 1;
+    } else if (unlikely(eval_v == TIMEOUT_V))
+        return TIMEOUT_V;
 
     // the query is unsat
     return 2;
 
 TRY_MIN_MAX:
-    for (j = 0; j < 2; ++j) {
-        if (j == 0)
-            c = interval->min;
+    // try the bounds of every interval
+    for (j = 0; j < 2 * (int)interval->n; ++j) {
+        if ((j & 1) == 0)
+            c = interval->intervals[j / 2].min;
         else
-            c = interval->max;
+            c = interval->intervals[j / 2].max;
 
         for (k = 0; k < ig->n; ++k) {
             unsigned int  index = ig->indexes[ig->n - k - 1];
@@ -6818,102 +8275,1001 @@ TRY_MIN_MAX:
 #ifdef DEBUG_CHECK_LIGHT
             Z3FUZZ_LOG("range bruteforce - inj byte: 0x%x @ %d\n", b, index);
 #endif
-            if (current_testcase->values[index] == (unsigned long)b)
+            // the byte already holds the value (e.g. it is the seed one)
+            if (tmp_input[index] == (unsigned long)b)
                 continue;
 
-            tmp_input[index] = b;
+            set_tmp_input(index, b);
+        }
+        int valid_eval = is_valid_eval_group(ctx, ig, tmp_input,
+                                             current_testcase->value_sizes,
+                                             current_testcase->values_len);
+        if (valid_eval) {
+            int eval_v = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (eval_v == 1) {
+#ifdef PRINT_SAT
+                Z3FUZZ_LOG("[check light - range bruteforce] Query "
+                           "is SAT\n");
+#endif
+                ctx->stats.range_brute_force++;
+                ctx->stats.num_sat++;
+                __set_proof(ctx, tmp_input);
+                *proof      = tmp_proof;
+                *proof_size = current_testcase->values_len;
+                return 1;
+            } else if (unlikely(eval_v == TIMEOUT_V))
+                return TIMEOUT_V;
+        }
+    }
+    for (k = 0; k < ig->n; ++k) {
+        i            = ig->indexes[ig->n - k - 1];
+        set_tmp_input(i, current_testcase->values[i]);
+    }
+    return 0;
+}
+
+static __always_inline int
+PHASE_range_bruteforce_opt(fuzzy_ctx_t* ctx, Z3_ast query,
+                           Z3_ast branch_condition, unsigned char const** proof,
+                           unsigned long* proof_size)
+{
+    if (unlikely(skip_range_brute_force_opt))
+        return 0;
+
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying range bruteforce optimistic\n");
+#endif
+
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+
+    wrapped_interval_set_t* interval = NULL;
+    index_group_t*          ig       = NULL;
+    da__index_group_t*      groups   = __get_query_groups();
+    unsigned long           gi;
+    for (gi = 0; gi < groups->size; ++gi) {
+        ig = &groups->data[gi];
+        ASSERT_OR_ABORT(ig->n > 0, "PHASE_range_bruteforce_opt() - group size "
+                                   "< 0. It shouldn't happen");
+
+        interval = interval_group_get_interval(group_intervals, ig);
+        if (interval == 0)
+            continue; // no interval
+
+        wrapped_interval_iter_t it = wis_init_iter_values(interval);
+        int                     eval_v =
+            __range_bruteforce_group(ctx, query, branch_condition, ig, &it,
+                                     RANGE_MAX_WIDTH_BRUTE_FORCE / 4 + 1);
+        if (eval_v == 1) {
+#ifdef PRINT_SAT
+            Z3FUZZ_LOG("[check light - range bruteforce opt] Query is SAT\n");
+#endif
+            ctx->stats.range_brute_force_opt++;
+            ctx->stats.num_sat++;
+            __set_proof(ctx, tmp_input);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
+    }
+    return 0;
+}
+
+// abstract interpretation of the branch condition over known bits and wrapped
+// intervals. The inputs are seeded with the facts learned from the notified
+// constraints: a univocally defined input has the value of the seed, a group
+// with a learned interval is in the hull of the interval. A boolean is a
+// 1-bit value. Terms wider than 64 bits are not tracked (range of size 0)
+static inline uint64_t __abs_mask(unsigned size)
+{
+    return size >= 64 ? ~0UL : (1UL << size) - 1;
+}
+
+static inline abs_value_t __abs_top(unsigned size)
+{
+    abs_value_t res = {.zeros = 0, .ones = 0};
+    if (size > 64)
+        size = 0;
+    res.range.min  = 0;
+    res.range.max  = __abs_mask(size);
+    res.range.size = size;
+    return res;
+}
+
+static inline abs_value_t __abs_const(uint64_t v, unsigned size)
+{
+    abs_value_t res;
+    v              = v & __abs_mask(size);
+    res.zeros      = ~v & __abs_mask(size);
+    res.ones       = v;
+    res.range.min  = v;
+    res.range.max  = v;
+    res.range.size = size;
+    return res;
+}
+
+static inline int __abs_is_const(abs_value_t* a)
+{
+    return a->range.size > 0 &&
+           (a->zeros | a->ones) == __abs_mask(a->range.size);
+}
+
+// 1 if the boolean a is true, 0 if it is false, -1 if unknown
+static inline int __abs_truth(abs_value_t* a)
+{
+    if (a->range.size != 1)
+        return -1;
+    return a->ones ? 1 : (a->zeros ? 0 : -1);
+}
+
+static inline abs_value_t __abs_bool(int v)
+{
+    return v == -1 ? __abs_top(1) : __abs_const(v, 1);
+}
+
+// unsigned bounds of a
+static inline uint64_t __abs_umin(abs_value_t* a)
+{
+    uint64_t min = a->range.min <= a->range.max ? a->range.min : 0;
+    return min > a->ones ? min : a->ones;
+}
+
+static inline uint64_t __abs_umax(abs_value_t* a)
+{
+    uint64_t mask = __abs_mask(a->range.size);
+    uint64_t max  = a->range.min <= a->range.max ? a->range.max : mask;
+    return max < (~a->zeros & mask) ? max : ~a->zeros & mask;
+}
+
+// tighten the range with the known bits and vice versa
+static void __abs_normalize(abs_value_t* a)
+{
+    unsigned size = a->range.size;
+    uint64_t mask = __abs_mask(size);
+    if (size == 0 || (a->zeros & a->ones) != 0) {
+        *a = __abs_top(size);
+        return;
+    }
+    if (a->range.min > a->range.max)
+        return;
+
+    uint64_t min = __abs_umin(a);
+    uint64_t max = __abs_umax(a);
+    if (min > max) {
+        // no value is compatible with the facts, give up on them
+        *a = __abs_top(size);
+        return;
+    }
+    a->range.min = min;
+    a->range.max = max;
+
+    // the bits above the most significant one that differs in min and max
+    // are the same in the whole range
+    uint64_t known = mask;
+    if (min != max)
+        known &= ~((2UL << (63 - __builtin_clzl(min ^ max))) - 1);
+    a->zeros |= ~min & known;
+    a->ones |= min & known;
+}
+
+static abs_value_t __abs_join(abs_value_t* a, abs_value_t* b)
+{
+    abs_value_t res = __abs_top(a->range.size);
+    if (res.range.size == 0)
+        return res;
+
+    res.zeros = a->zeros & b->zeros;
+    res.ones  = a->ones & b->ones;
+    if (a->range.min <= a->range.max && b->range.min <= b->range.max) {
+        res.range.min =
+            a->range.min < b->range.min ? a->range.min : b->range.min;
+        res.range.max =
+            a->range.max > b->range.max ? a->range.max : b->range.max;
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_not(abs_value_t* a)
+{
+    uint64_t    mask = __abs_mask(a->range.size);
+    abs_value_t res  = *a;
+    res.zeros        = a->ones;
+    res.ones         = a->zeros;
+    res.range.min    = mask - a->range.max;
+    res.range.max    = mask - a->range.min;
+    return res;
+}
+
+// a + b + carry. The carries of the known bits are propagated as in
+// computeForAddCarry() of LLVM
+static abs_value_t __abs_add(abs_value_t* a, abs_value_t* b, uint64_t carry)
+{
+    unsigned    size = a->range.size;
+    uint64_t    mask = __abs_mask(size);
+    abs_value_t res  = __abs_top(size);
+    if (size == 0)
+        return res;
+
+    uint64_t sum_max     = (~a->zeros + ~b->zeros + carry) & mask;
+    uint64_t sum_min     = (a->ones + b->ones + carry) & mask;
+    uint64_t carry_zeros = ~(sum_max ^ a->zeros ^ b->zeros);
+    uint64_t carry_ones  = sum_min ^ a->ones ^ b->ones;
+    uint64_t known       = (a->zeros | a->ones) & (b->zeros | b->ones) &
+                     (carry_zeros | carry_ones) & mask;
+    res.zeros = ~sum_max & known;
+    res.ones  = sum_min & known;
+
+    // the sum of two wrapped intervals is a wrapped interval if it does not
+    // cover the whole domain
+    uint64_t count_a = (a->range.max - a->range.min) & mask;
+    uint64_t count_b = (b->range.max - b->range.min) & mask;
+    if (count_a <= mask - count_b) {
+        res.range.min = (a->range.min + b->range.min + carry) & mask;
+        res.range.max = (a->range.max + b->range.max + carry) & mask;
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_mul(abs_value_t* a, abs_value_t* b)
+{
+    unsigned    size = a->range.size;
+    uint64_t    mask = __abs_mask(size);
+    abs_value_t res  = __abs_top(size);
+    if (size == 0)
+        return res;
+    if (__abs_is_const(a) && __abs_is_const(b))
+        return __abs_const(a->ones * b->ones, size);
+
+    // the trailing zeros of the factors add up
+    uint64_t nz_a = ~a->zeros & mask;
+    uint64_t nz_b = ~b->zeros & mask;
+    if (nz_a == 0 || nz_b == 0)
+        return __abs_const(0, size);
+    unsigned tz = __builtin_ctzl(nz_a) + __builtin_ctzl(nz_b);
+    if (tz >= size)
+        return __abs_const(0, size);
+    res.zeros = (1UL << tz) - 1;
+
+    // a constant factor scales a range that does not overflow
+    abs_value_t* c = __abs_is_const(a) ? a : (__abs_is_const(b) ? b : NULL);
+    abs_value_t* x = c == a ? b : a;
+    uint64_t     max;
+    if (c != NULL && !__builtin_mul_overflow(__abs_umax(x), c->ones, &max) &&
+        max <= mask) {
+        res.range.min = __abs_umin(x) * c->ones;
+        res.range.max = max;
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_bitwise(Z3_decl_kind kind, abs_value_t* a,
+                                 abs_value_t* b)
+{
+    abs_value_t res = __abs_top(a->range.size);
+    if (res.range.size == 0)
+        return res;
+
+    uint64_t max_a = __abs_umax(a), max_b = __abs_umax(b);
+    uint64_t min_a = __abs_umin(a), min_b = __abs_umin(b);
+    switch (kind) {
+        case Z3_OP_BAND:
+            res.zeros     = a->zeros | b->zeros;
+            res.ones      = a->ones & b->ones;
+            res.range.max = max_a < max_b ? max_a : max_b;
+            break;
+        case Z3_OP_BOR:
+            res.zeros     = a->zeros & b->zeros;
+            res.ones      = a->ones | b->ones;
+            res.range.min = min_a > min_b ? min_a : min_b;
+            break;
+        default: // xor
+            res.zeros = (a->zeros & b->zeros) | (a->ones & b->ones);
+            res.ones  = (a->zeros & b->ones) | (a->ones & b->zeros);
+            break;
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_concat(abs_value_t* hi, abs_value_t* lo)
+{
+    unsigned    shift = lo->range.size;
+    abs_value_t res   = __abs_top(hi->range.size + shift);
+    res.zeros         = (hi->zeros << shift) | lo->zeros;
+    res.ones          = (hi->ones << shift) | lo->ones;
+    res.range.min     = (__abs_umin(hi) << shift) | __abs_umin(lo);
+    res.range.max     = (__abs_umax(hi) << shift) | __abs_umax(lo);
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_extract(abs_value_t* a, unsigned hig, unsigned low)
+{
+    unsigned    size = hig - low + 1;
+    uint64_t    mask = __abs_mask(size);
+    abs_value_t res  = __abs_top(size);
+    if (a->range.size == 0)
+        return res;
+
+    res.zeros = (a->zeros >> low) & mask;
+    res.ones  = (a->ones >> low) & mask;
+
+    // the range survives the truncation if it has at most 2^size values
+    if (low == 0 || a->range.min <= a->range.max) {
+        uint64_t min = a->range.min >> low;
+        uint64_t max = a->range.max >> low;
+        if (((max - min) & __abs_mask(a->range.size)) <= mask) {
+            res.range.min = min & mask;
+            res.range.max = max & mask;
+        }
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+static abs_value_t __abs_extend(abs_value_t* a, unsigned size, int is_signed)
+{
+    abs_value_t res = __abs_top(size);
+    if (a->range.size == 0)
+        return res;
+
+    uint64_t ext  = __abs_mask(size) & ~__abs_mask(a->range.size);
+    uint64_t sign = 1UL << (a->range.size - 1);
+    res.zeros     = a->zeros;
+    res.ones      = a->ones;
+    if (!is_signed || (a->zeros & sign))
+        res.zeros |= ext;
+    else if (a->ones & sign)
+        res.ones |= ext;
+
+    if (a->range.min <= a->range.max) {
+        if (!is_signed || a->range.max < sign) {
+            res.range.min = a->range.min;
+            res.range.max = a->range.max;
+        } else if (a->range.min >= sign) {
+            res.range.min = a->range.min | ext;
+            res.range.max = a->range.max | ext;
+        }
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+// shifts and unsigned divisions by the constant c
+static abs_value_t __abs_const_op(Z3_decl_kind kind, abs_value_t* a,
+                                  uint64_t c)
+{
+    unsigned    size = a->range.size;
+    uint64_t    mask = __abs_mask(size);
+    uint64_t    min  = __abs_umin(a);
+    uint64_t    max  = __abs_umax(a);
+    abs_value_t res  = __abs_top(size);
+
+    switch (kind) {
+        case Z3_OP_BSHL:
+            if (c >= size)
+                return __abs_const(0, size);
+            res.zeros = ((a->zeros << c) | ((1UL << c) - 1)) & mask;
+            res.ones  = (a->ones << c) & mask;
+            if (max <= mask >> c) {
+                res.range.min = min << c;
+                res.range.max = max << c;
+            }
+            break;
+        case Z3_OP_BLSHR:
+            if (c >= size)
+                return __abs_const(0, size);
+            res.zeros     = (a->zeros >> c) | (mask & ~(mask >> c));
+            res.ones      = a->ones >> c;
+            res.range.min = min >> c;
+            res.range.max = max >> c;
+            break;
+        case Z3_OP_BUDIV:
+        case Z3_OP_BUDIV_I:
+            if (c == 0)
+                return res;
+            res.range.min = min / c;
+            res.range.max = max / c;
+            break;
+        case Z3_OP_BUREM:
+        case Z3_OP_BUREM_I:
+            if (c == 0)
+                return res;
+            if (max < c)
+                return *a;
+            res.range.max = c - 1;
+            break;
+        default:
+            break;
+    }
+    __abs_normalize(&res);
+    return res;
+}
+
+// 1 if a == b for all the values, 0 if for none, -1 if unknown
+static int __abs_eq(abs_value_t* a, abs_value_t* b)
+{
+    if (a->range.size == 0 || a->range.size != b->range.size)
+        return -1;
+    if ((a->ones & b->zeros) || (a->zeros & b->ones))
+        return 0;
+    if (__abs_umax(a) < __abs_umin(b) || __abs_umax(b) < __abs_umin(a))
+        return 0;
+    if (__abs_is_const(a) && __abs_is_const(b))
+        return 1;
+    return -1;
+}
+
+// 1 if a < b (a <= b if or_equal) for all the values, 0 if for none, -1 if
+// unknown
+static int __abs_ult(abs_value_t* a, abs_value_t* b, int or_equal)
+{
+    if (a->range.size == 0 || a->range.size != b->range.size)
+        return -1;
+
+    uint64_t min_a = __abs_umin(a), max_a = __abs_umax(a);
+    uint64_t min_b = __abs_umin(b), max_b = __abs_umax(b);
+    if (max_a < min_b || (or_equal && max_a == min_b))
+        return 1;
+    if (min_a > max_b || (!or_equal && min_a == max_b))
+        return 0;
+    return -1;
+}
+
+// restrict a to the interval in abs_facts of the group that node is equal to
+static void __abs_add_group_facts(fuzzy_ctx_t* ctx, Z3_ast node,
+                                  abs_value_t* a)
+{
+    index_group_t ig = {0};
+    unsigned      i;
+    if (abs_facts.size == 0 || !__lin_detect_group(ctx, node, &ig))
+        return;
+
+    for (i = 0; i < abs_facts.size; ++i) {
+        interval_group_t* el = &abs_facts.data[i];
+        if (el->interval.n == 0 || !index_group_equals(&el->group, &ig))
+            continue;
+
+        uint64_t min = wis_get_min(&el->interval);
+        uint64_t max = wis_get_max(&el->interval);
+        if (a->range.min <= a->range.max) {
+            min = min > a->range.min ? min : a->range.min;
+            max = max < a->range.max ? max : a->range.max;
+            if (min > max)
+                continue;
+        }
+        a->range.min = min;
+        a->range.max = max;
+        __abs_normalize(a);
+    }
+}
+
+static abs_value_t __abs_eval(fuzzy_ctx_t* ctx, Z3_ast node);
+
+static abs_value_t __abs_eval_app(fuzzy_ctx_t* ctx, Z3_ast node,
+                                  unsigned size)
+{
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     nargs     = Z3_get_app_num_args(ctx->z3_ctx, app);
+    abs_value_t  res       = __abs_top(size);
+    abs_value_t  a, b;
+    unsigned     i;
+    int          v;
+
+    if (nargs > 0)
+        a = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0));
+    if (nargs > 1 && decl_kind != Z3_OP_AND && decl_kind != Z3_OP_OR &&
+        decl_kind != Z3_OP_ITE)
+        b = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 1));
+
+    switch (decl_kind) {
+        case Z3_OP_TRUE:
+            return __abs_const(1, 1);
+        case Z3_OP_FALSE:
+            return __abs_const(0, 1);
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
+            if (nargs > 0 ||
+                Z3_get_symbol_kind(ctx->z3_ctx, s) != Z3_INT_SYMBOL)
+                return res;
+
+            int idx = Z3_get_symbol_int(ctx->z3_ctx, s);
+            if (idx >= ctx->testcases.data[0].testcase_len &&
+                idx < ctx->size_assignments && ctx->assignments[idx] != NULL)
+                res = __abs_eval(ctx, ctx->assignments[idx]);
+            break;
+        }
+        case Z3_OP_NOT:
+        case Z3_OP_BNOT:
+            return __abs_not(&a);
+        case Z3_OP_AND:
+        case Z3_OP_OR: {
+            // stop at the first argument with the absorbing value
+            int absorbing = decl_kind == Z3_OP_OR;
+            int all_known = 1;
+            for (i = 0; i < nargs; ++i) {
+                if (i > 0)
+                    a = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, i));
+                v = __abs_truth(&a);
+                if (v == absorbing)
+                    return __abs_const(absorbing, 1);
+                if (v == -1)
+                    all_known = 0;
+            }
+            return all_known ? __abs_const(!absorbing, 1) : __abs_top(1);
+        }
+        case Z3_OP_IMPLIES:
+            if (__abs_truth(&a) == 0 || __abs_truth(&b) == 1)
+                return __abs_const(1, 1);
+            if (__abs_truth(&a) == 1 && __abs_truth(&b) == 0)
+                return __abs_const(0, 1);
+            return __abs_top(1);
+        case Z3_OP_ITE:
+            v = __abs_truth(&a);
+            if (v != -1)
+                return __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app,
+                                                      v == 1 ? 1 : 2));
+            a = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 1));
+            b = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, 2));
+            return __abs_join(&a, &b);
+        case Z3_OP_EQ:
+            return __abs_bool(__abs_eq(&a, &b));
+        case Z3_OP_DISTINCT:
+            if (nargs != 2)
+                return res;
+            v = __abs_eq(&a, &b);
+            return __abs_bool(v == -1 ? -1 : !v);
+        case Z3_OP_SLEQ:
+        case Z3_OP_SLT:
+        case Z3_OP_SGEQ:
+        case Z3_OP_SGT: {
+            // flip the sign bit and compare as unsigned
+            if (a.range.size == 0)
+                return res;
+            abs_value_t sign = __abs_const(1UL << (a.range.size - 1),
+                                           a.range.size);
+            a = __abs_add(&a, &sign, 0);
+            b = __abs_add(&b, &sign, 0);
+        }
+        // fall through
+        case Z3_OP_ULEQ:
+        case Z3_OP_ULT:
+        case Z3_OP_UGEQ:
+        case Z3_OP_UGT: {
+            int or_equal = decl_kind == Z3_OP_ULEQ || decl_kind == Z3_OP_UGEQ ||
+                           decl_kind == Z3_OP_SLEQ || decl_kind == Z3_OP_SGEQ;
+            if (decl_kind == Z3_OP_UGEQ || decl_kind == Z3_OP_UGT ||
+                decl_kind == Z3_OP_SGEQ || decl_kind == Z3_OP_SGT)
+                return __abs_bool(__abs_ult(&b, &a, or_equal));
+            return __abs_bool(__abs_ult(&a, &b, or_equal));
+        }
+        case Z3_OP_BNEG: {
+            abs_value_t zero = __abs_const(0, size);
+            b                = __abs_not(&a);
+            return __abs_add(&zero, &b, 1);
+        }
+        case Z3_OP_BADD:
+        case Z3_OP_BSUB:
+        case Z3_OP_BMUL:
+        case Z3_OP_BAND:
+        case Z3_OP_BOR:
+        case Z3_OP_BXOR:
+        case Z3_OP_XOR:
+        case Z3_OP_CONCAT:
+            for (i = 1; i < nargs; ++i) {
+                if (i > 1)
+                    b = __abs_eval(ctx, Z3_get_app_arg(ctx->z3_ctx, app, i));
+                if (decl_kind == Z3_OP_BADD)
+                    a = __abs_add(&a, &b, 0);
+                else if (decl_kind == Z3_OP_BSUB) {
+                    b = __abs_not(&b);
+                    a = __abs_add(&a, &b, 1);
+                } else if (decl_kind == Z3_OP_BMUL)
+                    a = __abs_mul(&a, &b);
+                else if (decl_kind == Z3_OP_CONCAT)
+                    a = __abs_concat(&a, &b);
+                else
+                    a = __abs_bitwise(decl_kind, &a, &b);
+            }
+            res = a;
+            break;
+        case Z3_OP_EXTRACT:
+            return __abs_extract(
+                &a, Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 0),
+                Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1));
+        case Z3_OP_ZERO_EXT:
+        case Z3_OP_SIGN_EXT:
+            res = __abs_extend(&a, size, decl_kind == Z3_OP_SIGN_EXT);
+            break;
+        case Z3_OP_BSHL:
+        case Z3_OP_BLSHR:
+        case Z3_OP_BUDIV:
+        case Z3_OP_BUDIV_I:
+        case Z3_OP_BUREM:
+        case Z3_OP_BUREM_I:
+            if (__abs_is_const(&b))
+                return __abs_const_op(decl_kind, &a, b.ones);
+            return res;
+        default:
+            return res;
+    }
+
+    if (decl_kind == Z3_OP_UNINTERPRETED || decl_kind == Z3_OP_CONCAT ||
+        decl_kind == Z3_OP_ZERO_EXT)
+        __abs_add_group_facts(ctx, node, &res);
+    return res;
+}
+
+static abs_value_t __abs_eval(fuzzy_ctx_t* ctx, Z3_ast node)
+{
+    unsigned     id  = Z3_get_ast_id(ctx->z3_ctx, node);
+    abs_value_t* ref = dict_get_ref__abs_value_t(&abs_values, id);
+    if (ref != NULL)
+        return *ref;
+
+    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, node);
+    unsigned    size = 0;
+    uint64_t    v;
+    abs_value_t res;
+
+    if (kind == Z3_NUMERAL_AST || kind == Z3_APP_AST) {
+        Z3_sort sort = Z3_get_sort(ctx->z3_ctx, node);
+        switch (Z3_get_sort_kind(ctx->z3_ctx, sort)) {
+            case Z3_BOOL_SORT:
+                size = 1;
+                break;
+            case Z3_BV_SORT:
+                size = Z3_get_bv_sort_size(ctx->z3_ctx, sort);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (size == 0 || size > 64)
+        res = __abs_top(0);
+    else if (kind == Z3_NUMERAL_AST)
+        res = Z3_get_numeral_uint64(ctx->z3_ctx, node, &v)
+                  ? __abs_const(v, size)
+                  : __abs_top(size);
+    else
+        res = __abs_eval_app(ctx, node, size);
+
+    dict_set__abs_value_t(&abs_values, id, res);
+    return res;
+}
+
+// add to abs_facts the ranges implied by the conjuncts of e. Returns 0 if they
+// contradict the facts already there
+static int __abs_add_conjunct_facts(fuzzy_ctx_t* ctx, Z3_ast e)
+{
+    unsigned i;
+    if (Z3_get_ast_kind(ctx->z3_ctx, e) != Z3_APP_AST)
+        return 1;
+
+    Z3_app app = Z3_to_app(ctx->z3_ctx, e);
+    if (Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app)) ==
+        Z3_OP_AND) {
+        for (i = 0; i < Z3_get_app_num_args(ctx->z3_ctx, app); ++i)
+            if (!__abs_add_conjunct_facts(ctx,
+                                          Z3_get_app_arg(ctx->z3_ctx, app, i)))
+                return 0;
+        return 1;
+    }
+
+    interval_group_t fact = {0};
+    if (!__get_range_intervals(ctx, e, &fact.group, &fact.interval))
+        return 1;
+
+    for (i = 0; i < abs_facts.size; ++i)
+        if (index_group_equals(&abs_facts.data[i].group, &fact.group))
+            return wis_intersect_set(&abs_facts.data[i].interval,
+                                     &fact.interval);
+    da_add_item__interval_group_t(&abs_facts, fact);
+    return 1;
+}
+
+// 1 if no input satisfies both the query and the branch condition: the ranges
+// implied by their conjuncts contradict each other, or the branch condition is
+// false under them. The facts learned from the notified constraints are not
+// used, they may come from another path than the one of the query
+static int __abs_branch_is_false(fuzzy_ctx_t* ctx, Z3_ast query,
+                                 Z3_ast branch_condition)
+{
+    if (skip_abstract_interpretation || performing_aggressive_optimistic)
+        return 0; // the aggressive optimistic search ignores the facts
+
+    da_remove_all__interval_group_t(&abs_facts, NULL);
+    if (!__abs_add_conjunct_facts(ctx, query) ||
+        !__abs_add_conjunct_facts(ctx, branch_condition))
+        return 1;
+
+    dict_remove_all__abs_value_t(&abs_values);
+    abs_value_t res = __abs_eval(ctx, branch_condition);
+    return __abs_truth(&res) == 0;
+}
+
+// memcmp/strcmp-like branches: a conjunction of equalities between input
+// bytes and constants, possibly folded in an OR of XORs compared with zero or
+// in a concat of (ite (= inp_i const_i) #b1 #b0) bits compared with a
+// constant (see __detect_strcmp_pattern). The required bytes are written in
+// tmp_input while walking the branch condition, a byte already written in
+// checkpoint must keep its value
+static int __eq_chain_set_byte(unsigned checkpoint, unsigned long index,
+                               unsigned char value, int* changed)
+{
+    if (tmp_input_stamps[index] == tmp_input_epochs[checkpoint])
+        return tmp_input[index] == value;
+
+    *changed |= tmp_input[index] != value;
+    set_tmp_input(index, value);
+    return 1;
+}
+
+static int __eq_chain_bool(fuzzy_ctx_t* ctx, unsigned checkpoint, Z3_ast node,
+                           int value, int* changed);
+
+// node (at most 64 bits) must be equal to value
+static int __eq_chain_value(fuzzy_ctx_t* ctx, unsigned checkpoint, Z3_ast node,
+                            uint64_t value, int* changed)
+{
+    Z3_sort  sort = Z3_get_sort(ctx->z3_ctx, node);
+    unsigned size = Z3_get_bv_sort_size(ctx->z3_ctx, sort);
+    uint64_t mask = size >= 64 ? ~0UL : (1UL << size) - 1;
+    uint64_t v;
+    unsigned i;
+
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) == Z3_NUMERAL_AST)
+        return Z3_get_numeral_uint64(ctx->z3_ctx, node, &v) && v == value;
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST || size > 64)
+        return 0;
+
+    index_group_t ig = {0};
+    if (__lin_detect_group(ctx, node, &ig)) {
+        if (ig.n < 8 && (value >> (ig.n * 8)) != 0)
+            return 0;
+        for (i = 0; i < ig.n; ++i)
+            if (!__eq_chain_set_byte(checkpoint, ig.indexes[ig.n - i - 1],
+                                     __extract_from_long(value, i), changed))
+                return 0;
+        return 1;
+    }
+
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     nargs     = Z3_get_app_num_args(ctx->z3_ctx, app);
+
+    switch (decl_kind) {
+        case Z3_OP_BXOR:
+        case Z3_OP_BADD:
+        case Z3_OP_BSUB: {
+            // one symbolic argument and a constant
+            if (nargs != 2)
+                return 0;
+            Z3_ast   a = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            Z3_ast   b = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            uint64_t c;
+            if (Z3_get_ast_kind(ctx->z3_ctx, b) == Z3_NUMERAL_AST &&
+                Z3_get_numeral_uint64(ctx->z3_ctx, b, &c)) {
+                if (decl_kind == Z3_OP_BXOR)
+                    v = value ^ c;
+                else
+                    v = decl_kind == Z3_OP_BADD ? value - c : value + c;
+                return __eq_chain_value(ctx, checkpoint, a, v & mask,
+                                        changed);
+            }
+            if (Z3_get_ast_kind(ctx->z3_ctx, a) == Z3_NUMERAL_AST &&
+                Z3_get_numeral_uint64(ctx->z3_ctx, a, &c)) {
+                if (decl_kind == Z3_OP_BXOR)
+                    v = value ^ c;
+                else
+                    v = decl_kind == Z3_OP_BADD ? value - c : c - value;
+                return __eq_chain_value(ctx, checkpoint, b, v & mask,
+                                        changed);
+            }
+            return 0;
+        }
+        case Z3_OP_BNOT:
+            return __eq_chain_value(ctx, checkpoint,
+                                    Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                    ~value & mask, changed);
+        case Z3_OP_BOR:
+        case Z3_OP_BAND: {
+            // all the arguments are zero (all ones)
+            if ((decl_kind == Z3_OP_BOR && value != 0) ||
+                (decl_kind == Z3_OP_BAND && value != mask))
+                return 0;
+
+            da__Z3_ast args;
+            da_init__Z3_ast(&args);
+            if (decl_kind == Z3_OP_BOR)
+                flatten_bor_args(ctx, node, &args);
+            else
+                for (i = 0; i < nargs; ++i) {
+                    Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                    Z3_inc_ref(ctx->z3_ctx, child);
+                    da_add_item__Z3_ast(&args, child);
+                }
+
+            int res = 1;
+            for (i = 0; i < args.size; ++i) {
+                if (res && !__eq_chain_value(ctx, checkpoint, args.data[i],
+                                             value, changed))
+                    res = 0;
+                Z3_dec_ref(ctx->z3_ctx, args.data[i]);
+            }
+            da_free__Z3_ast(&args, NULL);
+            return res;
         }
-        int valid_eval = is_valid_eval_group(ctx, ig, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
-#ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - range bruteforce] Query "
-                           "is SAT\n");
-#endif
-                ctx->stats.range_brute_force++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->values_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
+        case Z3_OP_CONCAT: {
+            unsigned shift = 0;
+            for (i = nargs; i > 0; --i) {
+                Z3_ast   child = Z3_get_app_arg(ctx->z3_ctx, app, i - 1);
+                unsigned width = Z3_get_bv_sort_size(
+                    ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, child));
+                uint64_t child_mask = width >= 64 ? ~0UL : (1UL << width) - 1;
+                if (!__eq_chain_value(ctx, checkpoint, child,
+                                      (value >> shift) & child_mask, changed))
+                    return 0;
+                shift += width;
+            }
+            return 1;
+        }
+        case Z3_OP_ZERO_EXT: {
+            Z3_ast   child = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            unsigned width = Z3_get_bv_sort_size(
+                ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, child));
+            if ((value >> width) != 0)
+                return 0;
+            return __eq_chain_value(ctx, checkpoint, child, value, changed);
+        }
+        case Z3_OP_ITE: {
+            // (ite cond c1 c2), the value selects the branch
+            Z3_ast   iftrue  = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            Z3_ast   iffalse = Z3_get_app_arg(ctx->z3_ctx, app, 2);
+            uint64_t iftrue_v, iffalse_v;
+            if (Z3_get_ast_kind(ctx->z3_ctx, iftrue) != Z3_NUMERAL_AST ||
+                Z3_get_ast_kind(ctx->z3_ctx, iffalse) != Z3_NUMERAL_AST ||
+                !Z3_get_numeral_uint64(ctx->z3_ctx, iftrue, &iftrue_v) ||
+                !Z3_get_numeral_uint64(ctx->z3_ctx, iffalse, &iffalse_v) ||
+                iftrue_v == iffalse_v)
+                return 0;
+            if (value != iftrue_v && value != iffalse_v)
+                return 0;
+            return __eq_chain_bool(ctx, checkpoint,
+                                   Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                   value == iftrue_v, changed);
         }
+        default:
+            return 0;
     }
-    for (k = 0; k < ig->n; ++k) {
-        i            = ig->indexes[ig->n - k - 1];
-        tmp_input[i] = current_testcase->values[i];
+}
+
+// (= a b) with a constant side
+static int __eq_chain_eq(fuzzy_ctx_t* ctx, unsigned checkpoint, Z3_ast a,
+                         Z3_ast b, int value, int* changed)
+{
+    uint64_t c;
+    if (Z3_get_ast_kind(ctx->z3_ctx, a) == Z3_NUMERAL_AST) {
+        Z3_ast tmp = a;
+        a          = b;
+        b          = tmp;
+    }
+    if (Z3_get_sort_kind(ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, a)) !=
+            Z3_BV_SORT ||
+        Z3_get_ast_kind(ctx->z3_ctx, b) != Z3_NUMERAL_AST ||
+        !Z3_get_numeral_uint64(ctx->z3_ctx, b, &c))
+        return 0;
+
+    if (!value) {
+        // only a bit has a single value different from c
+        if (Z3_get_bv_sort_size(ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, a)) != 1)
+            return 0;
+        c = !c;
     }
-    return 0;
+    return __eq_chain_value(ctx, checkpoint, a, c, changed);
 }
 
-static __always_inline int
-PHASE_range_bruteforce_opt(fuzzy_ctx_t* ctx, Z3_ast query,
-                           Z3_ast branch_condition, unsigned char const** proof,
-                           unsigned long* proof_size)
+// the boolean node must evaluate to value
+static int __eq_chain_bool(fuzzy_ctx_t* ctx, unsigned checkpoint, Z3_ast node,
+                           int value, int* changed)
 {
-    if (unlikely(skip_range_brute_force_opt))
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
         return 0;
 
-#ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying range bruteforce optimistic\n");
-#endif
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     nargs     = Z3_get_app_num_args(ctx->z3_ctx, app);
+    unsigned     i;
 
-    set__interval_group_ptr* group_intervals =
-        (set__interval_group_ptr*)ctx->group_intervals;
-    testcase_t* current_testcase = &ctx->testcases.data[0];
+    switch (decl_kind) {
+        case Z3_OP_TRUE:
+            return value;
+        case Z3_OP_FALSE:
+            return !value;
+        case Z3_OP_NOT:
+            return __eq_chain_bool(ctx, checkpoint,
+                                   Z3_get_app_arg(ctx->z3_ctx, app, 0), !value,
+                                   changed);
+        case Z3_OP_AND:
+        case Z3_OP_OR:
+            // a true conjunction or a false disjunction
+            if ((decl_kind == Z3_OP_AND) != value)
+                return 0;
+            for (i = 0; i < nargs; ++i)
+                if (!__eq_chain_bool(ctx, checkpoint,
+                                     Z3_get_app_arg(ctx->z3_ctx, app, i),
+                                     value, changed))
+                    return 0;
+            return 1;
+        case Z3_OP_EQ:
+        case Z3_OP_DISTINCT:
+            if (nargs != 2)
+                return 0;
+            return __eq_chain_eq(ctx, checkpoint,
+                                 Z3_get_app_arg(ctx->z3_ctx, app, 0),
+                                 Z3_get_app_arg(ctx->z3_ctx, app, 1),
+                                 decl_kind == Z3_OP_EQ ? value : !value,
+                                 changed);
+        default:
+            return 0;
+    }
+}
 
-    wrapped_interval_t* interval = NULL;
-    index_group_t*      ig       = NULL;
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
-    while (
-        set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0, &ig)) {
-        ASSERT_OR_ABORT(ig->n > 0, "PHASE_range_bruteforce_opt() - group size "
-                                   "< 0. It shouldn't happen");
+static __always_inline int PHASE_equality_chain(fuzzy_ctx_t* ctx, Z3_ast query,
+                                                Z3_ast branch_condition,
+                                                unsigned char const** proof,
+                                                unsigned long* proof_size)
+{
+    if (unlikely(skip_equality_chain))
+        return 0;
 
-        interval = interval_group_get_interval(group_intervals, ig);
-        if (interval == 0)
-            continue; // no interval
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    unsigned    checkpoint       = checkpoint_tmp_input();
+    int         changed          = 0;
+    int         res              = 0;
 
-        int                     i  = 0;
-        wrapped_interval_iter_t it = wi_init_iter_values(interval);
-        uint64_t                val;
-        while (wi_iter_get_next(&it, &val)) {
-            if (i++ > RANGE_MAX_WIDTH_BRUTE_FORCE / 4)
-                break;
-            set_tmp_input_group_to_value(ig, val);
-            int eval_v = __evaluate_branch_query(
-                ctx, query, branch_condition, tmp_input,
-                current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
+    if (__eq_chain_bool(ctx, checkpoint, branch_condition, 1, &changed) &&
+        changed) {
+#ifdef DEBUG_CHECK_LIGHT
+        Z3FUZZ_LOG("Trying Equality Chain\n");
+#endif
+        res = __evaluate_branch_query(
+            ctx, query, branch_condition, tmp_input,
+            current_testcase->value_sizes, current_testcase->values_len);
+        if (res == 1) {
 #ifdef PRINT_SAT
-                Z3FUZZ_LOG(
-                    "[check light - range bruteforce opt] Query is SAT\n");
+            Z3FUZZ_LOG("[check light - equality chain] Query is SAT\n");
 #endif
-                ctx->stats.range_brute_force_opt++;
-                ctx->stats.num_sat++;
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
-                *proof      = tmp_proof;
-                *proof_size = current_testcase->testcase_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
+            ctx->stats.equality_chain++;
+            ctx->stats.num_sat++;
+            __set_proof(ctx, tmp_input);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            release_tmp_input(checkpoint);
+            return 1;
         }
     }
-    return 0;
+    rollback_tmp_input(checkpoint);
+    return res == TIMEOUT_V ? TIMEOUT_V : 0;
 }
 
-static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
-                               Z3_ast                branch_condition,
-                               unsigned char const** proof,
-                               unsigned long*        proof_size)
+static int __query_check_light_phases(fuzzy_ctx_t* ctx, Z3_ast query,
+                                      Z3_ast                branch_condition,
+                                      unsigned char const** proof,
+                                      unsigned long*        proof_size,
+                                      unsigned              checkpoint)
 {
     // 1 -> succeded
 #ifdef DEBUG_CHECK_LIGHT
@@ -6936,8 +9292,7 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
         Z3FUZZ_LOG("sat in seed... [opt_found = %d]\n", opt_found);
 #endif
         ctx->stats.sat_in_seed++;
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *proof      = tmp_proof;
         *proof_size = current_testcase->testcase_len;
         return 1;
@@ -6965,8 +9320,7 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
             ctx, query, branch_condition, tmp_input,
             current_testcase->value_sizes, current_testcase->values_len);
         if (eval_v == 1) {
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             return 1;
@@ -6975,6 +9329,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
         return 0;
     }
 
+    undo_tmp_input(checkpoint);
+
     // Input to State
     if (ast_data.is_input_to_state) {
         // input to state detected
@@ -6988,6 +9344,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
             return 1;
     }
 
+    undo_tmp_input(checkpoint);
+
     // Simple math
     res = PHASE_simple_math(ctx, query, branch_condition, proof, proof_size);
     if (unlikely(res == TIMEOUT_V))
@@ -6997,6 +9355,19 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     if (res == 2)
         return 0;
 
+    undo_tmp_input(checkpoint);
+
+    // Linear math
+    res = PHASE_linear_math(ctx, query, branch_condition, proof, proof_size);
+    if (unlikely(res == TIMEOUT_V))
+        return TIMEOUT_V;
+    if (res == 1)
+        return 1;
+    if (res == 2)
+        return 0;
+
+    undo_tmp_input(checkpoint);
+
     // Range bruteforce
     res =
         PHASE_range_bruteforce(ctx, query, branch_condition, proof, proof_size);
@@ -7007,6 +9378,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     if (res == 1)
         return 1;
 
+    undo_tmp_input(checkpoint);
+
     // Range bruteforce optimistic
     res = PHASE_range_bruteforce_opt(ctx, query, branch_condition, proof,
                                      proof_size);
@@ -7015,6 +9388,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     if (res == 1)
         return 1;
 
+    undo_tmp_input(checkpoint);
+
     // Input to State Extended
     if (ast_data.values.size > 0 ||
         ast_data.inputs->inp_to_state_ite.size > 0) {
@@ -7026,6 +9401,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
             return 1;
     }
 
+    undo_tmp_input(checkpoint);
+
     // Pure Brute Force - Only One Byte is Involved
     if (ast_data.inputs->indexes.size == 1) {
         // if the fase fails, we exit -> the query is UNSAT
@@ -7037,6 +9414,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
             return res;
     }
 
+    undo_tmp_input(checkpoint);
+
     // Gradient Based Transformation
     res =
         PHASE_gradient_descend(ctx, query, branch_condition, proof, proof_size);
@@ -7045,6 +9424,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     if (res)
         return 1;
 
+    undo_tmp_input(checkpoint);
+
         // Afl Deterministic Transformations
 #ifdef USE_AFL_DET_GROUPS
     res = PHASE_afl_deterministic_groups(ctx, query, branch_condition, proof,
@@ -7058,6 +9439,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     if (res)
         return 1;
 
+    undo_tmp_input(checkpoint);
+
         // Afl Havoc Transformation
 #ifndef USE_HAVOC_ON_WHOLE_PI
     res = PHASE_afl_havoc(ctx, query, branch_condition, proof, proof_size);
@@ -7075,6 +9458,24 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     return 0;
 }
 
+static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
+                               Z3_ast                branch_condition,
+                               unsigned char const** proof,
+                               unsigned long*        proof_size)
+{
+    // the phases can leave tmp_input dirty when they fail: the journal
+    // restores only the bytes they touched
+    unsigned checkpoint = checkpoint_tmp_input();
+    int      res        = __query_check_light_phases(
+        ctx, query, branch_condition, proof, proof_size, checkpoint);
+    if (res == 1)
+        release_tmp_input(checkpoint);
+    else
+        rollback_tmp_input(checkpoint);
+    return res;
+}
+
+
 static inline int ig_has_index(index_group_t* ig, ulong idx)
 {
     unsigned i;
@@ -7087,12 +9488,12 @@ static inline int ig_has_index(index_group_t* ig, ulong idx)
 
 static inline int find_group_with_all_inputs(index_group_t* ig)
 {
-    ulong*         p;
-    index_group_t* tmp_ig;
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
-    while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0,
-                                        &tmp_ig)) {
-        int has_all = 1;
+    ulong*             p;
+    da__index_group_t* groups = __get_query_groups();
+    unsigned long      gi;
+    for (gi = 0; gi < groups->size; ++gi) {
+        index_group_t* tmp_ig  = &groups->data[gi];
+        int            has_all = 1;
         set_reset_iter__ulong(&ast_data.inputs->indexes, 0);
         while (set_iter_next__ulong(&ast_data.inputs->indexes, 0, &p)) {
             if (!ig_has_index(tmp_ig, *p)) {
@@ -7142,8 +9543,7 @@ static inline int PHASE_freeze_neighbours(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.multigoal++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             return 1;
@@ -7165,8 +9565,7 @@ static inline int PHASE_freeze_neighbours(fuzzy_ctx_t* ctx, Z3_ast query,
 #endif
             ctx->stats.multigoal++;
             ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
+            __set_proof(ctx, tmp_input);
             *proof      = tmp_proof;
             *proof_size = current_testcase->testcase_len;
             return 1;
@@ -7180,14 +9579,10 @@ static inline int PHASE_freeze_neighbours(fuzzy_ctx_t* ctx, Z3_ast query,
 static inline int check_if_range_for_indexes(fuzzy_ctx_t* ctx,
                                              set__ulong*  indexes)
 {
-    dict__da__interval_group_ptr* index_to_group_intervals =
-        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
-
     ulong* i;
     set_reset_iter__ulong(indexes, 0);
     while (set_iter_next__ulong(indexes, 0, &i)) {
-        if (dict_get_ref__da__interval_group_ptr(index_to_group_intervals,
-                                                 *i) != NULL)
+        if (get_byte_meta(ctx, *i) & BYTE_HAS_INTERVALS)
             return 1;
     }
     return 0;
@@ -7305,8 +9700,8 @@ static inline int query_check_light_and_multigoal(fuzzy_ctx_t* ctx,
     memcpy(&bk_stats, &ctx->stats, sizeof(fuzzy_stats_t));
 
     // set tmp_input to the input that made the branch condition true
-    memcpy(tmp_input, tmp_opt_input,
-           curr_t->values_len * sizeof(unsigned long));
+    __materialize_opt(ctx);
+    reset_tmp_input(tmp_opt_input, curr_t->values_len);
 
     // ast_info of the branch condition
     ast_info_ptr branch_ast_info = ast_data.inputs;
@@ -7396,8 +9791,8 @@ static inline int query_check_light_and_multigoal(fuzzy_ctx_t* ctx,
                     }
                 }
 #endif
-                memcpy(tmp_input, tmp_opt_input,
-                       curr_t->values_len * sizeof(unsigned long));
+                __materialize_opt(ctx);
+                reset_tmp_input(tmp_opt_input, curr_t->values_len);
                 while (set_iter_next__ulong(&ast_info->indexes, 0, &p))
                     set_add__ulong(&black_indexes, *p);
                 ast_info_reset(new_ast_info);
@@ -7416,6 +9811,7 @@ static inline int query_check_light_and_multigoal(fuzzy_ctx_t* ctx,
     // solution
     opt_found                      = 1;
     bk_stats.num_evaluate          = ctx->stats.num_evaluate;
+    bk_stats.num_invalid_eval      = ctx->stats.num_invalid_eval;
     bk_stats.conflicting_fallbacks = ctx->stats.conflicting_fallbacks;
     bk_stats.conflicting_fallbacks_no_true =
         ctx->stats.conflicting_fallbacks_no_true;
@@ -7558,10 +9954,10 @@ static inline int handle_and_constraint(fuzzy_ctx_t* ctx, Z3_ast query,
     return res;
 }
 
-int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
-                             Z3_ast                branch_condition,
-                             unsigned char const** proof,
-                             unsigned long*        proof_size)
+fuzzy_check_res_t z3fuzz_query_check(fuzzy_ctx_t* ctx, Z3_ast query,
+                                     Z3_ast                branch_condition,
+                                     unsigned char const** proof,
+                                     unsigned long*        proof_size)
 {
     Z3_inc_ref(ctx->z3_ctx, query);
     Z3_inc_ref(ctx->z3_ctx, branch_condition);
@@ -7571,13 +9967,47 @@ int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     z3fuzz_print_expr(ctx, branch_condition);
 #endif
 
-    int res;
+    int res, unsat = 0;
     *proof_size = 0;
+    // the nested query of aggressive_optimistic keeps the slice and the DAG
+    // of the outer one, that has the same branch condition
+    int nested = performing_aggressive_optimistic;
+
+    // the caller holds a reference to the original asts
+    Z3_ast canon = __canonicalize(ctx, query);
+    Z3_dec_ref(ctx->z3_ctx, query);
+    query = canon;
+    canon = __canonicalize(ctx, branch_condition);
+    Z3_dec_ref(ctx->z3_ctx, branch_condition);
+    branch_condition = canon;
+
+    if (unlikely(snapshot_pid != 0) && getpid() != snapshot_pid) {
+        // first query of a worker forked from a snapshot, do not replay the
+        // random sequence of the other workers
+        snapshot_pid = getpid();
+        rand_cnt     = 0;
+    }
 
     timer_start_wrapper(ctx);
     g_prev_num_evaluate = ctx->stats.num_evaluate;
 
+    __deferred_process(ctx, branch_condition);
     __init_global_data(ctx, query, branch_condition);
+    if (__abs_branch_is_false(ctx, query, branch_condition)) {
+        ctx->stats.num_unsat++;
+        res   = 0;
+        unsat = 1;
+        goto OUT;
+    }
+    if (!nested) {
+        __slice_query(ctx, query, branch_condition);
+        __prepare_query_dag(ctx, query, branch_condition);
+    }
+
+    // memcmp-like branches, before they are split in conjuncts
+    res = PHASE_equality_chain(ctx, query, branch_condition, proof, proof_size);
+    if (res != 0)
+        goto OUT;
 
     int with_not;
     if (is_and_constraint(ctx, branch_condition, &with_not))
@@ -7587,12 +10017,30 @@ int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
         res = query_check_light_and_multigoal(ctx, query, branch_condition,
                                               proof, proof_size);
 
+OUT:
     if (opt_found)
         ctx->stats.opt_sat += 1;
+    if (res == 1 && !skip_afl_dictionary)
+        __token_dict_add_values(ctx, &ast_data.values);
 
+    if (!nested) {
+        __release_query_dag();
+        __release_query_slice(ctx);
+    }
     Z3_dec_ref(ctx->z3_ctx, query);
     Z3_dec_ref(ctx->z3_ctx, branch_condition);
-    return res;
+    if (unsat)
+        return Z3FUZZ_UNSAT;
+    return res == 1 ? Z3FUZZ_SAT : Z3FUZZ_UNKNOWN;
+}
+
+int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
+                             Z3_ast                branch_condition,
+                             unsigned char const** proof,
+                             unsigned long*        proof_size)
+{
+    return z3fuzz_query_check(ctx, query, branch_condition, proof,
+                              proof_size) == Z3FUZZ_SAT;
 }
 
 void z3fuzz_add_assignment(fuzzy_ctx_t* ctx, int idx, Z3_ast assignment_value)
@@ -7664,6 +10112,7 @@ void z3fuzz_add_assignment(fuzzy_ctx_t* ctx, int idx, Z3_ast assignment_value)
 
     if (old_len < ctx->testcases.data[0].values_len) {
         init_global_context(ctx->testcases.data[0].values_len);
+        __byte_meta_grow(ctx, ctx->testcases.data[0].values_len);
     }
 }
 
@@ -7704,7 +10153,7 @@ static inline unsigned long __minimize_maximize_inner_greedy(
             if (i == original_byte)
                 continue;
 
-            tmp_input[*p] = (unsigned long)i;
+            set_tmp_input(*p, (unsigned long)i);
             if (!ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                  current_testcase->value_sizes,
                                  current_testcase->values_len, NULL))
@@ -7718,10 +10167,10 @@ static inline unsigned long __minimize_maximize_inner_greedy(
                 max_min      = tmp;
             }
         }
-        tmp_input[*p] = (unsigned long)max_min_byte;
+        set_tmp_input(*p, (unsigned long)max_min_byte);
     }
 
-    __vals_long_to_char(tmp_input, tmp_proof, current_testcase->testcase_len);
+    __set_proof(ctx, tmp_input);
     *out_values = tmp_proof;
     return max_min;
 }
@@ -7731,9 +10180,10 @@ unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
                               unsigned long*        out_len)
 {
     Z3_inc_ref(ctx->z3_ctx, pi);
+    __deferred_process(ctx, to_maximize);
 
-    memcpy(tmp_input, ctx->testcases.data[0].values,
-           ctx->testcases.data[0].values_len * sizeof(unsigned long));
+    reset_tmp_input(ctx->testcases.data[0].values,
+                    ctx->testcases.data[0].values_len);
 
     *out_len = ctx->testcases.data[0].testcase_len;
     if (use_greedy_mamin)
@@ -7775,13 +10225,13 @@ unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
         res = ctx->model_eval(ctx->z3_ctx, original_to_maximize, tmp_input,
                               current_testcase->value_sizes,
                               current_testcase->values_len, NULL);
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *out_values = tmp_proof;
         goto OUT;
     }
 
     eval_set_ctx(&ew);
+    gd_reset_optimizer(ast_data.values.data, ast_data.values.size);
 
     timer_start_wrapper(ctx);
     unsigned long max_val;
@@ -7791,8 +10241,7 @@ unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
         res = ctx->model_eval(ctx->z3_ctx, original_to_maximize, tmp_input,
                               current_testcase->value_sizes,
                               current_testcase->values_len, NULL);
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *out_values = tmp_proof;
         goto OUT;
     }
@@ -7801,7 +10250,7 @@ unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
     res = ctx->model_eval(ctx->z3_ctx, original_to_maximize, tmp_input,
                           current_testcase->value_sizes,
                           current_testcase->values_len, NULL);
-    __vals_long_to_char(tmp_input, tmp_proof, *out_len);
+    __set_proof(ctx, tmp_input);
     *out_values = tmp_proof;
 
 OUT:
@@ -7809,8 +10258,7 @@ OUT:
     Z3_dec_ref(ctx->z3_ctx, to_maximize);
     Z3_dec_ref(ctx->z3_ctx, original_to_maximize);
     __gd_free_eval(&ew);
-    memcpy(tmp_input, current_testcase->values,
-           current_testcase->values_len * sizeof(unsigned long));
+    reset_tmp_input(current_testcase->values, current_testcase->values_len);
     return res;
 }
 
@@ -7819,8 +10267,9 @@ unsigned long z3fuzz_minimize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_minimize,
                               unsigned long*        out_len)
 {
     Z3_inc_ref(ctx->z3_ctx, pi);
-    memcpy(tmp_input, ctx->testcases.data[0].values,
-           ctx->testcases.data[0].values_len * sizeof(unsigned long));
+    __deferred_process(ctx, to_minimize);
+    reset_tmp_input(ctx->testcases.data[0].values,
+                    ctx->testcases.data[0].values_len);
 
     *out_len = ctx->testcases.data[0].testcase_len;
     if (use_greedy_mamin)
@@ -7849,12 +10298,12 @@ unsigned long z3fuzz_minimize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_minimize,
         unsigned long res = ctx->model_eval(ctx->z3_ctx, to_minimize, tmp_input,
                                             current_testcase->value_sizes,
                                             current_testcase->values_len, NULL);
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *out_values = tmp_proof;
         return res;
     }
     eval_set_ctx(&ew);
+    gd_reset_optimizer(ast_data.values.data, ast_data.values.size);
 
     timer_start_wrapper(ctx);
     unsigned long res;
@@ -7865,8 +10314,7 @@ unsigned long z3fuzz_minimize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_minimize,
         res = ctx->model_eval(ctx->z3_ctx, to_minimize, tmp_input,
                               current_testcase->value_sizes,
                               current_testcase->values_len, NULL);
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
         *out_values = tmp_proof;
         goto OUT;
     }
@@ -7875,7 +10323,7 @@ unsigned long z3fuzz_minimize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_minimize,
     res = ctx->model_eval(ctx->z3_ctx, to_minimize_original, tmp_input,
                           current_testcase->value_sizes,
                           current_testcase->values_len, NULL);
-    __vals_long_to_char(tmp_input, tmp_proof, *out_len);
+    __set_proof(ctx, tmp_input);
     *out_values = tmp_proof;
 OUT:
     Z3_dec_ref(ctx->z3_ctx, pi);
@@ -7892,10 +10340,10 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
 {
     Z3_inc_ref(ctx->z3_ctx, pi);
     Z3_inc_ref(ctx->z3_ctx, expr);
+    __deferred_process(ctx, expr);
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
-    memcpy(tmp_input, current_testcase->values,
-           current_testcase->values_len * sizeof(unsigned long));
+    reset_tmp_input(current_testcase->values, current_testcase->values_len);
     __reset_ast_data();
     detect_involved_inputs_wrapper(ctx, expr, &ast_data.inputs);
 
@@ -7903,7 +10351,7 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
     set_init__ulong(&output_vals, index_hash, index_equals);
 
     // Perform the first evaluation in the seed
-    __vals_long_to_char(tmp_input, tmp_proof, current_testcase->testcase_len);
+    __set_proof(ctx, tmp_input);
     unsigned long value_in_seed = ctx->model_eval(
         ctx->z3_ctx, expr, tmp_input, current_testcase->value_sizes,
         current_testcase->values_len, NULL);
@@ -7912,31 +10360,29 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
     if (res_seed_call == Z3FUZZ_STOP)
         goto END;
 
-    index_group_t* g;
-
-    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 1);
-    while (
-        set_iter_next__index_group_t(&ast_data.inputs->index_groups, 1, &g)) {
+    da__index_group_t* groups = __get_query_groups();
+    unsigned long      gi;
+    for (gi = 0; gi < groups->size; ++gi) {
+        index_group_t* g = &groups->data[gi];
 
         unsigned long original_val =
             index_group_to_value(g, current_testcase->values);
 
         set__interval_group_ptr* group_intervals =
             (set__interval_group_ptr*)ctx->group_intervals;
-        wrapped_interval_t* interval =
+        wrapped_interval_set_t* interval =
             interval_group_get_interval(group_intervals, g);
 
-        if (interval != NULL && wi_get_range(interval) < 256) {
+        if (interval != NULL && wis_get_range(interval) < 256) {
             // the group is within a (small) known interval, brute force it
-            wrapped_interval_iter_t it = wi_init_iter_values(interval);
+            wrapped_interval_iter_t it = wis_init_iter_values(interval);
             uint64_t                val;
             while (wi_iter_get_next(&it, &val)) {
                 set_tmp_input_group_to_value(g, val);
                 if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                     current_testcase->value_sizes,
                                     current_testcase->values_len, NULL)) {
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     unsigned long expr_val =
                         ctx->model_eval(ctx->z3_ctx, expr, tmp_input,
                                         current_testcase->value_sizes,
@@ -7955,8 +10401,7 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                 if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                     current_testcase->value_sizes,
                                     current_testcase->values_len, NULL)) {
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     unsigned long expr_val =
                         ctx->model_eval(ctx->z3_ctx, expr, tmp_input,
                                         current_testcase->value_sizes,
@@ -7979,8 +10424,7 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                    ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                    current_testcase->value_sizes,
                                    current_testcase->values_len, NULL)) {
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
+                __set_proof(ctx, tmp_input);
                 unsigned long expr_val = ctx->model_eval(
                     ctx->z3_ctx, expr, tmp_input, current_testcase->value_sizes,
                     current_testcase->values_len, NULL);
@@ -8005,8 +10449,7 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                    ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                    current_testcase->value_sizes,
                                    current_testcase->values_len, NULL)) {
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
+                __set_proof(ctx, tmp_input);
                 unsigned long expr_val = ctx->model_eval(
                     ctx->z3_ctx, expr, tmp_input, current_testcase->value_sizes,
                     current_testcase->values_len, NULL);
@@ -8027,14 +10470,13 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
             for (j = 0; j < g->n - 1; ++j) {
                 unsigned long original_val = tmp_input[g->indexes[j]];
                 unsigned long byte_val     = original_val + 1;
-                tmp_input[g->indexes[j]]   = byte_val;
-                i                          = 0;
+                set_tmp_input(g->indexes[j], byte_val);
+                i = 0;
                 while (i++ < max_iter &&
                        ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                        current_testcase->value_sizes,
                                        current_testcase->values_len, NULL)) {
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     unsigned long expr_val =
                         ctx->model_eval(ctx->z3_ctx, expr, tmp_input,
                                         current_testcase->value_sizes,
@@ -8048,19 +10490,18 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                     if (res == Z3FUZZ_STOP)
                         goto END;
                     byte_val += 1;
-                    tmp_input[g->indexes[j]] = byte_val;
+                    set_tmp_input(g->indexes[j], byte_val);
                 }
 
-                tmp_input[g->indexes[j]] = original_val;
-                byte_val                 = original_val - 1;
-                tmp_input[g->indexes[j]] = byte_val;
-                i                        = 0;
+                set_tmp_input(g->indexes[j], original_val);
+                byte_val = original_val - 1;
+                set_tmp_input(g->indexes[j], byte_val);
+                i = 0;
                 while (i++ < max_iter &&
                        ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                        current_testcase->value_sizes,
                                        current_testcase->values_len, NULL)) {
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
+                    __set_proof(ctx, tmp_input);
                     unsigned long expr_val =
                         ctx->model_eval(ctx->z3_ctx, expr, tmp_input,
                                         current_testcase->value_sizes,
@@ -8074,18 +10515,17 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                     if (res == Z3FUZZ_STOP)
                         goto END;
                     byte_val -= 1;
-                    tmp_input[g->indexes[j]] = byte_val;
+                    set_tmp_input(g->indexes[j], byte_val);
                 }
             }
 
             // set deterministic
             for (j = 0; j < g->n; ++j)
-                tmp_input[g->indexes[j]] = 0;
+                set_tmp_input(g->indexes[j], 0);
             if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                 current_testcase->value_sizes,
                                 current_testcase->values_len, NULL)) {
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
+                __set_proof(ctx, tmp_input);
                 unsigned long expr_val = ctx->model_eval(
                     ctx->z3_ctx, expr, tmp_input, current_testcase->value_sizes,
                     current_testcase->values_len, NULL);
@@ -8099,12 +10539,11 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
                     goto END;
             }
             for (j = 0; j < g->n; ++j)
-                tmp_input[g->indexes[j]] = 0xff;
+                set_tmp_input(g->indexes[j], 0xff);
             if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                 current_testcase->value_sizes,
                                 current_testcase->values_len, NULL)) {
-                __vals_long_to_char(tmp_input, tmp_proof,
-                                    current_testcase->testcase_len);
+                __set_proof(ctx, tmp_input);
                 unsigned long expr_val = ctx->model_eval(
                     ctx->z3_ctx, expr, tmp_input, current_testcase->value_sizes,
                     current_testcase->values_len, NULL);
@@ -8135,6 +10574,7 @@ void z3fuzz_find_all_values_gd(
 {
     Z3_inc_ref(ctx->z3_ctx, expr);
     Z3_inc_ref(ctx->z3_ctx, pi);
+    __deferred_process(ctx, expr);
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
     Z3_ast      expr_original    = expr;
@@ -8159,6 +10599,7 @@ void z3fuzz_find_all_values_gd(
         goto OUT_2;
 
     eval_set_ctx(&ew);
+    gd_reset_optimizer(ast_data.values.data, ast_data.values.size);
     timer_start_wrapper(ctx);
 
     uint64_t max_grad;
@@ -8204,8 +10645,7 @@ void z3fuzz_find_all_values_gd(
         last_val      = ctx->model_eval(ctx->z3_ctx, expr_original, tmp_input,
                                    current_testcase->value_sizes,
                                    current_testcase->values_len, NULL);
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
+        __set_proof(ctx, tmp_input);
 
         if (no_callback)
             continue;
@@ -8233,7 +10673,9 @@ OUT_2:
 
 void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
 {
-    // this is a visit of the AST of the constraint... Too slow? I don't know
+    // repeated constraints are dropped by hash before visiting them. With
+    // Z3FUZZ_DEFER_NOTIFY=1 the visit is postponed to the first query that
+    // involves the inputs of the constraint (see __deferred_process)
     if (unlikely(skip_notify))
         return;
 
@@ -8274,22 +10716,272 @@ void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
         return;
     }
 
-    if (__check_univocally_defined(ctx, constraint)) {
-        ctx->stats.num_univocally_defined++;
+    if (defer_notify) {
+        // the reference is released by __deferred_free
+        da_add_item__Z3_ast(&__deferred_get(ctx)->queued, constraint);
+        return;
+    }
 
-        // invalidate ast_info_cache
-        dict__ast_info_ptr* ast_info_cache =
-            (dict__ast_info_ptr*)ctx->ast_info_cache;
-        dict_remove_all__ast_info_ptr(ast_info_cache);
-    } else {
-        ctx->stats.num_conflicting +=
-            __check_conflicting_constraint(ctx, constraint);
+    __analyze_constraint(ctx, constraint);
+    Z3_dec_ref(ctx->z3_ctx, constraint);
+}
 
-        ctx->stats.num_range_constraints +=
-            __check_range_constraint(ctx, constraint);
+static session_t* __session_get(fuzzy_ctx_t* ctx)
+{
+    session_t* session = (session_t*)ctx->session;
+    if (session == NULL) {
+        session = (session_t*)malloc(sizeof(session_t));
+        ASSERT_OR_ABORT(session != NULL, "__session_get(): failed malloc");
+        da_init__Z3_ast(&session->constraints);
+        da_init__session_frame_t(&session->frames);
+
+        // the base frame, it cannot be popped
+        session_frame_t base = {
+            .n_constraints = 0, .query = NULL, .learned = 0, .snapshot = NULL};
+        da_add_item__session_frame_t(&session->frames, base);
+        ctx->session = session;
+    }
+    return session;
+}
+
+static inline unsigned long __learned_state_counter(fuzzy_ctx_t* ctx)
+{
+    return ctx->stats.num_univocally_defined + ctx->stats.num_conflicting +
+           ctx->stats.num_range_constraints;
+}
+
+static learned_snapshot_t* __snapshot_take(fuzzy_ctx_t* ctx)
+{
+    learned_snapshot_t* snapshot =
+        (learned_snapshot_t*)malloc(sizeof(learned_snapshot_t));
+    ASSERT_OR_ABORT(snapshot != NULL, "__snapshot_take(): failed malloc");
+    da_init__ulong(&snapshot->processed_constraints);
+    da_init__ulong(&snapshot->univocally_defined_inputs);
+    da_init__ulong(&snapshot->conflicting_indexes);
+    da_init__Z3_ast(&snapshot->conflicting_asts);
+    da_init__interval_group_t(&snapshot->group_intervals);
+
+    set__ulong* processed_constraints = (set__ulong*)ctx->processed_constraints;
+    set__ulong* univocally_defined_inputs =
+        (set__ulong*)ctx->univocally_defined_inputs;
+    dict__conflicting_ptr* conflicting_asts =
+        (dict__conflicting_ptr*)ctx->conflicting_asts;
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
+
+    ulong* el;
+    set_reset_iter__ulong(processed_constraints, 0);
+    while (set_iter_next__ulong(processed_constraints, 0, &el))
+        da_add_item__ulong(&snapshot->processed_constraints, *el);
+    set_reset_iter__ulong(univocally_defined_inputs, 0);
+    while (set_iter_next__ulong(univocally_defined_inputs, 0, &el))
+        da_add_item__ulong(&snapshot->univocally_defined_inputs, *el);
+
+    unsigned long i, j;
+    for (i = 0; i < conflicting_asts->filled_buckets_i; ++i) {
+        da__dict_el_conflicting_ptr* bucket =
+            &conflicting_asts->buckets[conflicting_asts->filled_buckets[i]];
+        for (j = 0; j < bucket->size; ++j) {
+            ast_ptr* ast_p;
+            set_reset_iter__ast_ptr(bucket->data[j].el, 0);
+            while (set_iter_next__ast_ptr(bucket->data[j].el, 0, &ast_p)) {
+                Z3_inc_ref(ctx->z3_ctx, ast_p->ast);
+                da_add_item__ulong(&snapshot->conflicting_indexes,
+                                   bucket->data[j].key);
+                da_add_item__Z3_ast(&snapshot->conflicting_asts, ast_p->ast);
+            }
+        }
     }
 
-    Z3_dec_ref(ctx->z3_ctx, constraint);
+    interval_group_ptr* ig;
+    set_reset_iter__interval_group_ptr(group_intervals, 0);
+    while (set_iter_next__interval_group_ptr(group_intervals, 0, &ig))
+        da_add_item__interval_group_t(&snapshot->group_intervals, **ig);
+    return snapshot;
+}
+
+static void __snapshot_restore(fuzzy_ctx_t* ctx, learned_snapshot_t* snapshot)
+{
+    set__ulong* processed_constraints = (set__ulong*)ctx->processed_constraints;
+    set__ulong* univocally_defined_inputs =
+        (set__ulong*)ctx->univocally_defined_inputs;
+    dict__conflicting_ptr* conflicting_asts =
+        (dict__conflicting_ptr*)ctx->conflicting_asts;
+
+    unsigned long i;
+    set_remove_all__ulong(processed_constraints, NULL);
+    for (i = 0; i < snapshot->processed_constraints.size; ++i)
+        set_add__ulong(processed_constraints,
+                       snapshot->processed_constraints.data[i]);
+
+    set_remove_all__ulong(univocally_defined_inputs, NULL);
+    clear_byte_meta(ctx, BYTE_UNIVOCALLY_DEFINED | BYTE_HAS_INTERVALS);
+    for (i = 0; i < snapshot->univocally_defined_inputs.size; ++i) {
+        ulong idx = snapshot->univocally_defined_inputs.data[i];
+        set_add__ulong(univocally_defined_inputs, idx);
+        set_byte_meta(ctx, idx, BYTE_UNIVOCALLY_DEFINED);
+    }
+
+    dict_remove_all__conflicting_ptr(conflicting_asts);
+    for (i = 0; i < snapshot->conflicting_asts.size; ++i)
+        add_item_to_conflicting(conflicting_asts,
+                                snapshot->conflicting_asts.data[i],
+                                snapshot->conflicting_indexes.data[i],
+                                ctx->z3_ctx);
+
+    dict_remove_all__da__interval_group_ptr(
+        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals);
+    set_remove_all__interval_group_ptr(
+        (set__interval_group_ptr*)ctx->group_intervals,
+        interval_group_set_el_free);
+    invalidate_intervals_lookup();
+    for (i = 0; i < snapshot->group_intervals.size; ++i) {
+        interval_group_t* g = &snapshot->group_intervals.data[i];
+        __add_range_fact(ctx, &g->group, &g->interval);
+    }
+
+    // the cached ast info depends on the univocally defined inputs
+    dict_remove_all__ast_info_ptr((dict__ast_info_ptr*)ctx->ast_info_cache);
+}
+
+static void __session_relearn(fuzzy_ctx_t* ctx, session_t* session)
+{
+    // drop everything that was learned and notify again the constraints that
+    // are still in the stack. Stats are not affected
+    set_remove_all__ulong((set__ulong*)ctx->processed_constraints, NULL);
+    set_remove_all__ulong((set__ulong*)ctx->univocally_defined_inputs, NULL);
+    clear_byte_meta(ctx, BYTE_UNIVOCALLY_DEFINED | BYTE_HAS_INTERVALS);
+    dict_remove_all__conflicting_ptr(
+        (dict__conflicting_ptr*)ctx->conflicting_asts);
+    dict_remove_all__da__interval_group_ptr(
+        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals);
+    set_remove_all__interval_group_ptr(
+        (set__interval_group_ptr*)ctx->group_intervals,
+        interval_group_set_el_free);
+    dict_remove_all__ast_info_ptr((dict__ast_info_ptr*)ctx->ast_info_cache);
+    invalidate_intervals_lookup();
+    __deferred_free(ctx);
+
+    unsigned long num_univocally_defined = ctx->stats.num_univocally_defined;
+    unsigned long num_conflicting        = ctx->stats.num_conflicting;
+    unsigned long num_range_constraints  = ctx->stats.num_range_constraints;
+
+    unsigned long i;
+    for (i = 0; i < session->constraints.size; ++i)
+        z3fuzz_notify_constraint(ctx, session->constraints.data[i]);
+
+    ctx->stats.num_univocally_defined = num_univocally_defined;
+    ctx->stats.num_conflicting        = num_conflicting;
+    ctx->stats.num_range_constraints  = num_range_constraints;
+}
+
+void z3fuzz_push(fuzzy_ctx_t* ctx)
+{
+    session_t*      session = __session_get(ctx);
+    session_frame_t frame   = {.n_constraints = session->constraints.size,
+                               .query         = NULL,
+                               .learned       = 0,
+                               .snapshot      = NULL};
+    da_add_item__session_frame_t(&session->frames, frame);
+}
+
+void z3fuzz_assert(fuzzy_ctx_t* ctx, Z3_ast constraint)
+{
+    session_t*       session = __session_get(ctx);
+    session_frame_t* top     = &session->frames.data[session->frames.size - 1];
+
+    Z3_inc_ref(ctx->z3_ctx, constraint);
+    da_add_item__Z3_ast(&session->constraints, constraint);
+    if (top->query != NULL) {
+        Z3_dec_ref(ctx->z3_ctx, top->query);
+        top->query = NULL;
+    }
+
+    // save the learned state before the first constraint of the frame that
+    // modifies it. A deferred constraint can be analyzed after the frame is
+    // popped, in that case the stack is notified again on pop
+    learned_snapshot_t* snapshot = NULL;
+    if (!defer_notify && top->snapshot == NULL && session->frames.size > 1)
+        snapshot = __snapshot_take(ctx);
+
+    unsigned long counter = __learned_state_counter(ctx);
+    z3fuzz_notify_constraint(ctx, constraint);
+    if (defer_notify || __learned_state_counter(ctx) != counter)
+        top->learned = 1;
+
+    if (snapshot != NULL) {
+        if (top->learned)
+            top->snapshot = snapshot;
+        else
+            __snapshot_free(ctx, snapshot);
+    }
+}
+
+void z3fuzz_pop(fuzzy_ctx_t* ctx, unsigned n_frames)
+{
+    session_t* session = __session_get(ctx);
+    ASSERT_OR_ABORT(n_frames < session->frames.size,
+                    "z3fuzz_pop(): popping more frames than pushed");
+
+    // the snapshot of the lowest popped frame is the state to go back to.
+    // Without one (deferred analysis), the stack is notified again
+    int                 relearn  = 0;
+    learned_snapshot_t* snapshot = NULL;
+    while (n_frames-- > 0) {
+        session_frame_t* top = &session->frames.data[session->frames.size - 1];
+        unsigned long    i;
+        for (i = top->n_constraints; i < session->constraints.size; ++i)
+            Z3_dec_ref(ctx->z3_ctx, session->constraints.data[i]);
+        if (top->query != NULL)
+            Z3_dec_ref(ctx->z3_ctx, top->query);
+
+        if (top->snapshot != NULL) {
+            if (snapshot != NULL)
+                __snapshot_free(ctx, snapshot);
+            snapshot = top->snapshot;
+        } else if (top->learned)
+            relearn = 1;
+        session->constraints.size = top->n_constraints;
+        session->frames.size--;
+    }
+
+    // constraints that did not modify the learned state stay in the set of
+    // the processed ones: notifying them again would be useless
+    if (relearn)
+        __session_relearn(ctx, session);
+    else if (snapshot != NULL)
+        __snapshot_restore(ctx, snapshot);
+    if (snapshot != NULL)
+        __snapshot_free(ctx, snapshot);
+}
+
+static Z3_ast __session_query(fuzzy_ctx_t* ctx, session_t* session)
+{
+    // the conjunction of the stack is computed once per frame
+    session_frame_t* top = &session->frames.data[session->frames.size - 1];
+    if (top->query == NULL) {
+        if (session->constraints.size == 0)
+            top->query = Z3_mk_true(ctx->z3_ctx);
+        else if (session->constraints.size == 1)
+            top->query = session->constraints.data[0];
+        else
+            top->query = Z3_mk_and(ctx->z3_ctx, session->constraints.size,
+                                   session->constraints.data);
+        Z3_inc_ref(ctx->z3_ctx, top->query);
+    }
+    return top->query;
+}
+
+fuzzy_check_res_t z3fuzz_check_branch(fuzzy_ctx_t*          ctx,
+                                      Z3_ast                branch_condition,
+                                      unsigned char const** proof,
+                                      unsigned long*        proof_size)
+{
+    // the query is the conjunction of the stack, without the branch condition
+    // (as the path constraint passed by fuzzy-solver), so that it is sliced
+    session_t* session = __session_get(ctx);
+    return z3fuzz_query_check(ctx, __session_query(ctx, session),
+                              branch_condition, proof, proof_size);
 }
 
 int z3fuzz_get_optimistic_sol(fuzzy_ctx_t* ctx, unsigned char const** proof,
@@ -8297,8 +10989,9 @@ int z3fuzz_get_optimistic_sol(fuzzy_ctx_t* ctx, unsigned char const** proof,
 {
     if (opt_found) {
         testcase_t* t = &ctx->testcases.data[0];
-        *proof_size   = t->testcase_len;
-        *proof        = tmp_opt_proof;
+        __materialize_opt(ctx);
+        *proof_size = t->testcase_len;
+        *proof      = tmp_opt_proof;
     }
     return opt_found;
 }
@@ -8311,17 +11004,28 @@ void z3fuzz_dump_proof(fuzzy_ctx_t* ctx, const char* filename,
 
     // Z3FUZZ_LOG("dumping proof in %s\n", filename);
 
-    unsigned long i;
-    for (i = 0; i < proof_size; i++) {
-        fwrite(&proof[i], sizeof(char), 1, fp);
-    }
+    size_t n = fwrite(proof, sizeof(char), proof_size, fp);
+    ASSERT_OR_ABORT(n == proof_size, "z3fuzz_dump_proof() write failed");
     fclose(fp);
 }
 
+unsigned long z3fuzz_get_proof_patch(fuzzy_ctx_t*          ctx,
+                                     fuzzy_patch_t const** patches)
+{
+    if (proof_seed != ctx->testcases.data[0].values) {
+        // no proof of this context in tmp_proof
+        *patches = NULL;
+        return 0;
+    }
+    *patches = proof_patch.data;
+    return proof_patch.size;
+}
+
 unsigned long z3fuzz_evaluate_expression(fuzzy_ctx_t* ctx, Z3_ast value,
                                          unsigned char* values)
 {
     __vals_char_to_long(values, tmp_input, ctx->testcases.data[0].values_len);
+    tmp_input_base = NULL;
 
     unsigned long res = ctx->model_eval(
         ctx->z3_ctx, value, tmp_input, ctx->testcases.data[0].value_sizes,
@@ -8368,6 +11072,42 @@ unsigned long z3fuzz_evaluate_expression_z3(fuzzy_ctx_t* ctx, Z3_ast query,
     return res;
 }
 
+void z3fuzz_prepare_snapshot(fuzzy_ctx_t* ctx)
+{
+    // trim the cache now: a worker trimming it would write (and copy) all its
+    // pages. The token dictionary is built for the same reason
+    dict__ast_info_ptr* ast_info_cache =
+        (dict__ast_info_ptr*)ctx->ast_info_cache;
+    if (ast_info_cache->size > max_ast_info_cache_size)
+        dict_remove_all__ast_info_ptr(ast_info_cache);
+    notify_count = 0;
+    __token_dict_get(ctx);
+
+    snapshot_pid = getpid();
+}
+
+z3fuzz_shared_store_t* z3fuzz_shared_store_create()
+{
+    z3fuzz_shared_store_t* store =
+        (z3fuzz_shared_store_t*)malloc(sizeof(z3fuzz_shared_store_t));
+    ASSERT_OR_ABORT(store != NULL,
+                    "z3fuzz_shared_store_create(): failed malloc");
+    dict_init__shared_fact_t(&store->facts, shared_fact_free);
+    return store;
+}
+
+void z3fuzz_shared_store_free(z3fuzz_shared_store_t* store)
+{
+    dict_free__shared_fact_t(&store->facts);
+    free(store);
+}
+
+void z3fuzz_attach_shared_store(fuzzy_ctx_t*           ctx,
+                                z3fuzz_shared_store_t* store)
+{
+    ctx->shared_store = store;
+}
+
 void z3fuzz_get_mem_stats(fuzzy_ctx_t* ctx, memory_impact_stats_t* stats)
 {
     stats->univocally_defined_size =
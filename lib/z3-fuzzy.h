@@ -13,19 +13,40 @@ typedef enum fuzzy_findall_res_t {
     Z3FUZZ_JUST_LAST
 } fuzzy_findall_res_t;
 
+// results of z3fuzz_query_check() and z3fuzz_check_branch()
+typedef enum fuzzy_check_res_t {
+    Z3FUZZ_UNKNOWN = 0,
+    Z3FUZZ_SAT     = 1, // the proof satisfies the query
+    Z3FUZZ_UNSAT   = 2  // the branch condition is false under the ranges
+                        // implied by the query and the branch condition
+} fuzzy_check_res_t;
+
 typedef struct fuzzy_stats_t {
     unsigned long num_evaluate;
+    unsigned long num_invalid_eval;
     unsigned long aggressive_opt_evaluate;
     unsigned long num_sat;
+    unsigned long num_unsat;
     unsigned long opt_sat;
     unsigned long reuse;
     unsigned long input_to_state;
     unsigned long simple_math;
+    unsigned long linear_math;
+    unsigned long equality_chain;
     unsigned long input_to_state_ext;
     unsigned long brute_force;
     unsigned long range_brute_force;
     unsigned long range_brute_force_opt;
     unsigned long gradient_descend;
+    unsigned long gd_evaluate;
+    // per optimizer variant: the evaluations it spent, and the gd successes
+    // in which it lowered the function at least once
+    unsigned long gd_bisect_evaluate;
+    unsigned long gd_bisect_sat;
+    unsigned long gd_momentum_evaluate;
+    unsigned long gd_momentum_sat;
+    unsigned long gd_restart_evaluate;
+    unsigned long gd_restart_sat;
     unsigned long flip1;
     unsigned long flip2;
     unsigned long flip4;
@@ -51,12 +72,14 @@ typedef struct fuzzy_stats_t {
     unsigned long arith64_sub_LE;
     unsigned long arith64_sub_BE;
     unsigned long int64;
+    unsigned long dictionary;
     unsigned long havoc;
     unsigned long multigoal;
     unsigned long sat_in_seed;
     unsigned long num_univocally_defined;
     unsigned long num_range_constraints;
     unsigned long num_conflicting;
+    unsigned long num_shared_facts; // facts taken from the shared store
     unsigned long conflicting_fallbacks;
     unsigned long conflicting_fallbacks_same_inputs;
     unsigned long conflicting_fallbacks_no_true;
@@ -91,6 +114,12 @@ typedef struct fuzzy_ctx_t {
     void* group_intervals;
     void* index_to_group_intervals;
     void* timer;
+    void* session;
+    void* token_dict;
+    void* shared_store;
+    void* deferred;
+    void* canon_cache;
+    void* byte_meta;
 } fuzzy_ctx_t;
 
 typedef struct memory_impact_stats_t {
@@ -120,6 +149,11 @@ int           z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
                                        Z3_ast                branch_condition,
                                        unsigned char const** proof,
                                        unsigned long*        proof_size);
+// like z3fuzz_query_check_light(), but it also tells apart an unsat branch
+fuzzy_check_res_t z3fuzz_query_check(fuzzy_ctx_t* ctx, Z3_ast query,
+                                     Z3_ast                branch_condition,
+                                     unsigned char const** proof,
+                                     unsigned long*        proof_size);
 int z3fuzz_get_optimistic_sol(fuzzy_ctx_t* ctx, unsigned char const** proof,
                               unsigned long* proof_size);
 unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
@@ -141,8 +175,49 @@ void z3fuzz_find_all_values_gd(
 void z3fuzz_add_assignment(fuzzy_ctx_t* ctx, int idx, Z3_ast assignment_value);
 
 void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint);
+
+// incremental path constraint. Asserted constraints are notified. Popping a
+// frame that modified the learned state rebuilds it from the constraints
+// left in the stack (constraints notified outside the session are dropped)
+void z3fuzz_push(fuzzy_ctx_t* ctx);
+void z3fuzz_assert(fuzzy_ctx_t* ctx, Z3_ast constraint);
+void z3fuzz_pop(fuzzy_ctx_t* ctx, unsigned n_frames);
+fuzzy_check_res_t z3fuzz_check_branch(fuzzy_ctx_t*          ctx,
+                                      Z3_ast                branch_condition,
+                                      unsigned char const** proof,
+                                      unsigned long*        proof_size);
 void z3fuzz_dump_proof(fuzzy_ctx_t* ctx, const char* filename,
                        unsigned char const* proof, unsigned long proof_size);
 
+// the last proof returned by the library (through proof or out_values) as
+// byte patches against the seed, sorted by offset. The patches are valid
+// until the next call to the library. Returns the number of patches
+typedef struct fuzzy_patch_t {
+    unsigned long offset;
+    unsigned char value;
+} fuzzy_patch_t;
+
+unsigned long z3fuzz_get_proof_patch(fuzzy_ctx_t*          ctx,
+                                     fuzzy_patch_t const** patches);
+
+// prepare the context to be shared by processes forked after this call (e.g.,
+// the workers of a fork server), that read the learned state copy-on-write
+void z3fuzz_prepare_snapshot(fuzzy_ctx_t* ctx);
+
+// store of the facts (univocally defined inputs and input ranges) learned
+// from the notified constraints, shared by contexts working on the same seed.
+// A fact is keyed by the constraint it comes from: a context analyzes a
+// constraint only if no other context attached to the store did it, and gets
+// the facts of a constraint only when it notifies that constraint (so nothing
+// learned on another path, or in a popped frame, is used). The store must
+// outlive the contexts attached to it, that must share the Z3 context and be
+// used from the same thread
+typedef struct z3fuzz_shared_store_t z3fuzz_shared_store_t;
+
+z3fuzz_shared_store_t* z3fuzz_shared_store_create();
+void z3fuzz_shared_store_free(z3fuzz_shared_store_t* store);
+void z3fuzz_attach_shared_store(fuzzy_ctx_t*           ctx,
+                                z3fuzz_shared_store_t* store);
+
 void z3fuzz_get_mem_stats(fuzzy_ctx_t* ctx, memory_impact_stats_t* stats);
 #endif
@@ -10,6 +10,11 @@ class evalElement(ctypes.Structure):
                 ('proof', ctypes.c_uint64),
                 ('proof_size', ctypes.c_uint64)]
 
+# fuzzy_check_res_t
+Z3FUZZ_UNKNOWN = 0
+Z3FUZZ_SAT     = 1
+Z3FUZZ_UNSAT   = 2
+
 SCRIPTDIR = os.path.realpath(os.path.dirname(__file__))
 
 libref = ctypes.cdll.LoadLibrary(
@@ -21,6 +26,26 @@ libref.z3fuzz_evaluate_expression.restype = ctypes.c_uint64
 libref.z3fuzz_maximize.restype            = ctypes.c_uint64
 libref.z3fuzz_minimize.restype            = ctypes.c_uint64
 
+def _byte_buffer(data, size:int=None):
+    # pass the memory of data to the native code without copying it: bytes
+    # are passed as they are, writable buffers (bytearray, memoryview, numpy
+    # arrays) through from_buffer. Read-only buffers other than bytes are
+    # copied once
+    if isinstance(data, bytes):
+        buf, nbytes = data, len(data)
+    else:
+        view = memoryview(data)
+        if not view.c_contiguous:
+            raise ValueError("the buffer must be contiguous")
+        nbytes = view.nbytes
+        if view.readonly:
+            buf = view.tobytes()
+        else:
+            buf = (ctypes.c_uint8 * nbytes).from_buffer(view.cast("B"))
+    if size is not None and nbytes != size:
+        raise ValueError(f"expected {size} bytes, got {nbytes}")
+    return buf
+
 class FuzzyCtx(object):
     def __init__(self, seed:str, timeout:int=0):
         native_z3_ctx  = ctypes.c_void_p(_z3_ctx().ctx.value)
@@ -45,8 +70,9 @@ class FuzzySolver(object):
             f.flush()
             self.ctx = FuzzyCtx(f.name, timeout)
 
-        self.seed = seed
+        self.seed = bytes(seed)
         self.constraints = list()
+        self.frames = list() # len(self.constraints) when each frame was pushed
         self.inputs = [BitVec(i, 8) for i in range(len(seed))]
 
     def __del__(self):
@@ -63,8 +89,21 @@ class FuzzySolver(object):
                 "the constraint is not true when evaluated in the seed")
         self.constraints.append(constraint)
 
-        libref.z3fuzz_notify_constraint(
-            self.ctx.handle_ref(), constraint.as_ast())
+        libref.z3fuzz_assert(self.ctx.handle_ref(), constraint.as_ast())
+
+    def push(self):
+        # the constraints added after this call are dropped by the next pop
+        self.frames.append(len(self.constraints))
+        libref.z3fuzz_push(self.ctx.handle_ref())
+
+    def pop(self, n:int=1):
+        if n < 0 or n > len(self.frames):
+            raise ValueError(f"cannot pop {n} frames")
+        if n == 0:
+            return
+        libref.z3fuzz_pop(self.ctx.handle_ref(), ctypes.c_uint(n))
+        del self.constraints[self.frames[-n]:]
+        del self.frames[-n:]
 
     def pi(self):
         pi = BoolVal(True)
@@ -76,41 +115,61 @@ class FuzzySolver(object):
         proof_size = ctypes.c_uint64()
         proof      = ctypes.c_uint64()
 
-        res = libref.z3fuzz_query_check_light(
+        res = libref.z3fuzz_check_branch(
             self.ctx.handle_ref(),
-            self.pi().as_ast(),
             branch_condition.as_ast(),
             ctypes.byref(proof),
             ctypes.byref(proof_size))
 
-        if res == 0:
+        if res == Z3FUZZ_UNSAT:
+            return False, False, None
+        if res == Z3FUZZ_UNKNOWN:
             optsol = libref.z3fuzz_get_optimistic_sol(
                 self.ctx.handle_ref(),
                 ctypes.byref(proof),
                 ctypes.byref(proof_size))
             if optsol == 0:
                 return False, False, None
-            return False, True, (ctypes.c_char*proof_size.value).from_address(proof.value).raw
-        return True, True, (ctypes.c_char*proof_size.value).from_address(proof.value).raw
+            return False, True, ctypes.string_at(proof.value, proof_size.value)
+        return True, True, ctypes.string_at(proof.value, proof_size.value)
 
     def eval_in_seed(self, expr:BitVecRef):
-        seed_arr = (ctypes.c_uint8 * len(self.seed))(*list(self.seed))
         return libref.z3fuzz_evaluate_expression(
             self.ctx.handle_ref(),
             expr.as_ast(),
-            seed_arr
+            self.seed
         )
 
-    def eval(self, expr:BitVecRef, data:bytes):
-        assert len(data) == len(self.seed)
-
-        data_arr = (ctypes.c_uint8 * len(data))(*list(data))
+    def eval(self, expr:BitVecRef, data):
         return libref.z3fuzz_evaluate_expression(
             self.ctx.handle_ref(),
             expr.as_ast(),
-            data_arr
+            _byte_buffer(data, len(self.seed))
         )
 
+    def eval_many(self, expr:BitVecRef, inputs):
+        # inputs is either a 2D buffer (e.g., a numpy array) with one input
+        # per row, or a sequence of buffers
+        size = len(self.seed)
+        try:
+            data = _byte_buffer(inputs)
+        except TypeError:
+            data = b"".join(_byte_buffer(inp, size) for inp in inputs)
+        nbytes = len(data) if isinstance(data, bytes) else ctypes.sizeof(data)
+        if size == 0 or nbytes % size != 0:
+            raise ValueError("the inputs must have the size of the seed")
+
+        n_inputs = nbytes // size
+        out_arr  = (ctypes.c_uint64 * n_inputs)()
+        libref.evalMany(
+            self.ctx.handle_ref(),
+            expr.as_ast(),
+            data,
+            ctypes.c_size_t(n_inputs),
+            ctypes.c_size_t(size),
+            out_arr)
+        return list(out_arr)
+
     def eval_upto_inner(self, expr:BitVecRef, n:int, mode="greedy"):
         if mode not in {"greedy", "gd_min", "gd_max"}:
             raise ValueError("unrecognised mode")
@@ -143,7 +202,7 @@ class FuzzySolver(object):
 
             inserted_vals.add(out_arr[i].val)
             res.append(
-                (out_arr[i].val, (ctypes.c_char*out_arr[i].proof_size).from_address(out_arr[i].proof).raw)
+                (out_arr[i].val, ctypes.string_at(out_arr[i].proof, out_arr[i].proof_size))
             )
 
         libref.destroyEvalElementArray(
@@ -177,7 +236,7 @@ class FuzzySolver(object):
             ctypes.byref(proof),
             ctypes.byref(proof_size))
 
-        return minval, (ctypes.c_char*proof_size.value).from_address(proof.value).raw
+        return minval, ctypes.string_at(proof.value, proof_size.value)
 
     def maximize(self, expr:BitVecRef):
         proof_size = ctypes.c_uint64()
@@ -190,4 +249,4 @@ class FuzzySolver(object):
             ctypes.byref(proof),
             ctypes.byref(proof_size))
 
-        return maxval, (ctypes.c_char*proof_size.value).from_address(proof.value).raw
+        return maxval, ctypes.string_at(proof.value, proof_size.value)
@@ -92,3 +92,13 @@ uint32_t evalUpto(fuzzy_ctx_t* fctx, Z3_ast expr, Z3_ast pi, evalElement* out,
     }
     return uptoCounter;
 }
+
+void evalMany(fuzzy_ctx_t* fctx, Z3_ast expr, uint8_t* inputs, size_t n_inputs,
+              size_t input_size, uint64_t* out)
+{
+    // inputs is a (n_inputs x input_size) matrix of bytes, one input per row
+    size_t i;
+    for (i = 0; i < n_inputs; ++i)
+        out[i] = z3fuzz_evaluate_expression(fctx, expr,
+                                            inputs + i * input_size);
+}
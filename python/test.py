@@ -30,6 +30,17 @@ print("checking %s" % (inp > 20))
 r = s.check_sat(inp > 20)
 print_sat_info(r)
 
+s.push()
+s.add(inp < 8)
+print("checking %s (with %s)" % (inp > 10, inp < 8))
+r = s.check_sat(inp > 10)
+print_sat_info(r)
+s.pop()
+
+print("checking %s" % (inp > 10))
+r = s.check_sat(inp > 10)
+print_sat_info(r)
+
 print()
 
 print("eval_upto (all):   ")
@@ -55,3 +66,6 @@ maxval, maxproof = s.maximize(inp)
 
 print("minval:", minval, "(", str(minproof), ")")
 print("maxval:", maxval, "(", str(maxproof), ")")
+print()
+print("eval_many:")
+print("   ", s.eval_many(inp, [b"\x00\x00\x00\x05", bytearray(b"\x00\x00\x01\x00")]))
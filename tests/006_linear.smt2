@@ -0,0 +1,17 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(and
+		(=
+			(bvadd
+				(bvmul #x0003 (concat k!0 k!1))
+				(bvmul #x0007 (concat k!2 k!3)))
+			#x5c6d)
+		(=
+			(bvsub
+				(concat k!0 k!1)
+				(concat k!2 k!3))
+			#x0ccd)))
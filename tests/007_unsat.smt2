@@ -0,0 +1,11 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+
+(assert
+	(and
+		(=
+			(bvmul #x0002 (concat k!0 k!1))
+			#x7000)
+		(bvult
+			(concat k!0 k!1)
+			#x3100)))
@@ -0,0 +1,21 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(and
+		(=
+			(concat
+				(ite (= k!0 #x46) #b1 #b0)
+				(ite (= k!1 #x55) #b1 #b0)
+				(ite (= k!2 #x5a) #b1 #b0)
+				(ite (= k!3 #x5a) #b1 #b0))
+			#xf)
+		(=
+			(bvor
+				(bvxor k!0 #x46)
+				(bvor
+					(bvxor k!1 #x55)
+					(bvxor k!2 #x5a)))
+			#x00)))
@@ -0,0 +1,12 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+
+(assert
+	(and
+		(bvugt k!0 #x41)
+		(bvult k!0 #x50)))
+(assert
+	(and
+		(= k!1 #x42)
+		(bvult k!0 #x50)
+		(bvule k!0 #x41)))
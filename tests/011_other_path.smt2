@@ -0,0 +1,13 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+
+; the range of k!0 learned from the first query does not hold on the path of
+; the second one
+(assert
+	(and
+		(= k!0 #x05)
+		(bvult k!0 #x10)))
+(assert
+	(and
+		(= k!0 #x20)
+		(bvugt k!1 #x00)))
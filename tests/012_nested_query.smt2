@@ -0,0 +1,57 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+; no solution and no optimistic solution: aggressive optimistic checks the
+; branch condition in a nested query
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x37ec)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x94b0)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x43ce)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x3fe8)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x729a)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x91c2)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x7840)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #xaf50)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #xa482)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
+(assert
+	(and
+		(= (bvadd (concat k!1 k!0) (bvmul (concat k!1 k!0) (concat k!1 k!0))) #x56f6)
+		(bvugt (bvmul (concat k!3 k!2) #x0003) #x0100)
+		(bvuge (concat k!1 k!0) #x0000)))
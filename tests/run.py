@@ -9,15 +9,38 @@ FUZZY_BIN  = os.path.join(SCRIPT_DIR, "../build/bin/fuzzy-solver")
 if "FUZZY_BIN" in os.environ:
     FUZZY_BIN = os.environ["FUZZY_BIN"]
 
+DAG_JIT_TEST_BIN = os.path.join(SCRIPT_DIR, "../build/bin/dag-jit-test")
+if "DAG_JIT_TEST_BIN" in os.environ:
+    DAG_JIT_TEST_BIN = os.environ["DAG_JIT_TEST_BIN"]
+
+API_TEST_BIN = os.path.join(SCRIPT_DIR, "../build/bin/api-test")
+if "API_TEST_BIN" in os.environ:
+    API_TEST_BIN = os.environ["API_TEST_BIN"]
+
 ZERO_SEED = os.path.join(SCRIPT_DIR, "zero_seed.bin")
 
 def get_path(query):
     return os.path.join(SCRIPT_DIR, query)
 
-def common(query, seed):
+def status(query, seed):
     cmd = [FUZZY_BIN, "--notui", "-q", query, "-s", seed]
     out = subprocess.check_output(cmd)
-    return b"SAT" in out
+    return out.split(b",")[0]
+
+def statuses(query, seed, jobs=0, env=None):
+    cmd = [FUZZY_BIN, "--notui", "-q", query, "-s", seed]
+    if jobs > 0:
+        cmd += ["-j", str(jobs)]
+    if env is not None:
+        env = dict(os.environ, **env)
+    out = subprocess.check_output(cmd, env=env)
+    return [l.split(b",")[0] for l in out.splitlines()]
+
+def api_test(name):
+    subprocess.check_call([API_TEST_BIN, ZERO_SEED, name])
+
+def common(query, seed):
+    return status(query, seed) == b"SAT"
 
 def test_its_000():
     assert common(get_path("001_its.smt2"), ZERO_SEED)
@@ -33,3 +56,51 @@ def test_arithm_002():
 
 def test_arithm_003():
     assert common(get_path("005_arithm.smt2"), ZERO_SEED)
+
+def test_linear_000():
+    assert common(get_path("006_linear.smt2"), ZERO_SEED)
+
+def test_unsat_000():
+    assert status(get_path("007_unsat.smt2"), ZERO_SEED) == b"UNSAT"
+
+def test_memcmp_000():
+    assert common(get_path("008_memcmp.smt2"), ZERO_SEED)
+
+def test_linear_001():
+    assert common(get_path("009_linear.smt2"), ZERO_SEED)
+
+def test_unsat_001():
+    # the range learned on the path of the first query does not refute the
+    # branch of the second one, that has another path
+    query = get_path("011_other_path.smt2")
+    for jobs in (0, 2):
+        res = statuses(query, ZERO_SEED, jobs)
+        assert res[0] == b"SAT" and res[1] != b"UNSAT"
+
+def test_fork_server_000():
+    query = get_path("010_fork_server.smt2")
+    assert statuses(query, ZERO_SEED, 2) == statuses(query, ZERO_SEED)
+
+def test_dag_eval_000():
+    # the nested query of aggressive optimistic runs while the query DAG of
+    # the outer one is in use
+    query = get_path("012_nested_query.smt2")
+    dag   = statuses(query, ZERO_SEED, env={"Z3FUZZ_DAG_EVAL": "1"})
+    assert dag == statuses(query, ZERO_SEED)
+
+def test_dag_jit_000():
+    # the native code of the DAG JIT against dag_eval on random expressions
+    subprocess.check_call([DAG_JIT_TEST_BIN], stdout=subprocess.DEVNULL)
+
+def test_deferred_notify_000():
+    api_test("deferred")
+
+def test_session_000():
+    api_test("session")
+
+def test_shared_store_000():
+    api_test("store")
+
+def test_unsat_002():
+    # random queries on different paths, every UNSAT answer checked with z3
+    api_test("unsat")
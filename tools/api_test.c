@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z3-fuzzy.h"
+
+// tests of the library API that the fuzzy-solver command line does not
+// reach. Usage: api-test seed test_name. Exits with 1 on the first failure
+
+#define TIMEOUT 1000
+
+static Z3_context ctx;
+
+#define CHECK(x)                                                               \
+    if (!(x)) {                                                                \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);  \
+        exit(1);                                                               \
+    }
+
+static Z3_ast input(unsigned i)
+{
+    return Z3_mk_const(ctx, Z3_mk_int_symbol(ctx, i), Z3_mk_bv_sort(ctx, 8));
+}
+
+static Z3_ast byte(unsigned char v)
+{
+    return Z3_mk_unsigned_int(ctx, v, Z3_mk_bv_sort(ctx, 8));
+}
+
+static int check(fuzzy_ctx_t* fctx, Z3_ast query)
+{
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    return z3fuzz_query_check_light(fctx, query, query, &proof, &proof_size);
+}
+
+// Z3FUZZ_DEFER_NOTIFY=1: a notified constraint is analyzed by the first query
+// that involves its inputs
+static void test_deferred(char* seed)
+{
+    setenv("Z3FUZZ_DEFER_NOTIFY", "1", 1);
+    fuzzy_ctx_t* fctx = z3fuzz_create(ctx, seed, TIMEOUT);
+
+    z3fuzz_notify_constraint(fctx, Z3_mk_bvult(ctx, input(0), byte(0x10)));
+    CHECK(fctx->stats.num_range_constraints == 0);
+
+    check(fctx, Z3_mk_eq(ctx, input(1), byte(0x05)));
+    CHECK(fctx->stats.num_range_constraints == 0);
+
+    check(fctx, Z3_mk_eq(ctx, input(0), byte(0x05)));
+    CHECK(fctx->stats.num_range_constraints == 1);
+
+    z3fuzz_free(fctx);
+    free(fctx);
+}
+
+// incremental path constraint: popping frames restores the learned state of
+// the frame below them
+static void test_session(char* seed)
+{
+    fuzzy_ctx_t* fctx = z3fuzz_create(ctx, seed, TIMEOUT);
+
+    unsigned char const*  proof;
+    unsigned long         proof_size;
+    memory_impact_stats_t mem;
+
+    z3fuzz_assert(fctx, Z3_mk_bvult(ctx, input(1), byte(0x80)));
+    z3fuzz_push(fctx);
+    z3fuzz_assert(fctx, Z3_mk_bvult(ctx, input(0), byte(0x10)));
+    CHECK(z3fuzz_check_branch(fctx, Z3_mk_eq(ctx, input(0), byte(0x20)),
+                              &proof, &proof_size) == Z3FUZZ_UNSAT);
+    CHECK(z3fuzz_check_branch(fctx, Z3_mk_eq(ctx, input(0), byte(0x05)),
+                              &proof, &proof_size) == Z3FUZZ_SAT);
+    CHECK(proof[0] == 0x05 && proof[1] < 0x80);
+
+    z3fuzz_push(fctx);
+    z3fuzz_assert(fctx, Z3_mk_bvugt(ctx, input(0), byte(0x08)));
+    CHECK(z3fuzz_check_branch(fctx, Z3_mk_eq(ctx, input(0), byte(0x05)),
+                              &proof, &proof_size) == Z3FUZZ_UNSAT);
+    z3fuzz_get_mem_stats(fctx, &mem);
+    CHECK(mem.group_intervals_size == 2);
+
+    z3fuzz_pop(fctx, 2);
+    z3fuzz_get_mem_stats(fctx, &mem);
+    CHECK(mem.group_intervals_size == 1);
+    CHECK(z3fuzz_check_branch(fctx, Z3_mk_eq(ctx, input(0), byte(0x20)),
+                              &proof, &proof_size) == Z3FUZZ_SAT);
+    CHECK(proof[0] == 0x20 && proof[1] < 0x80);
+
+    z3fuzz_free(fctx);
+    free(fctx);
+}
+
+// contexts attached to a shared store: a constraint analyzed by one of them is
+// not analyzed again by the others, and its facts reach only the contexts that
+// notify it
+static void test_store(char* seed)
+{
+    z3fuzz_shared_store_t* store = z3fuzz_shared_store_create();
+    fuzzy_ctx_t*           a     = z3fuzz_create(ctx, seed, TIMEOUT);
+    fuzzy_ctx_t*           b     = z3fuzz_create(ctx, seed, TIMEOUT);
+    z3fuzz_attach_shared_store(a, store);
+    z3fuzz_attach_shared_store(b, store);
+
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    Z3_ast               lt = Z3_mk_bvult(ctx, input(0), byte(0x10));
+    Z3_ast               eq = Z3_mk_eq(ctx, input(0), byte(0x20));
+
+    z3fuzz_push(a);
+    z3fuzz_assert(a, lt);
+    CHECK(a->stats.num_range_constraints == 1);
+    CHECK(a->stats.num_shared_facts == 0);
+    CHECK(z3fuzz_check_branch(a, eq, &proof, &proof_size) == Z3FUZZ_UNSAT);
+
+    // b is on another path
+    CHECK(z3fuzz_check_branch(b, eq, &proof, &proof_size) == Z3FUZZ_SAT);
+    CHECK(b->stats.num_range_constraints == 0);
+
+    // the fact of the popped frame is dropped from a, not from the store
+    z3fuzz_pop(a, 1);
+    CHECK(z3fuzz_check_branch(a, eq, &proof, &proof_size) == Z3FUZZ_SAT);
+
+    z3fuzz_push(b);
+    z3fuzz_assert(b, lt);
+    CHECK(b->stats.num_range_constraints == 1);
+    CHECK(b->stats.num_shared_facts == 1);
+    CHECK(z3fuzz_check_branch(b, eq, &proof, &proof_size) == Z3FUZZ_UNSAT);
+
+    z3fuzz_free(a);
+    free(a);
+    z3fuzz_free(b);
+    free(b);
+    z3fuzz_shared_store_free(store);
+}
+
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+static unsigned rand_below(unsigned n)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng % n;
+}
+
+// an input byte or a 16-bit group of input bytes
+static Z3_ast rand_group(unsigned n_inputs)
+{
+    unsigned i = rand_below(n_inputs);
+    if (i + 1 < n_inputs && rand_below(2))
+        return Z3_mk_concat(ctx, input(i), input(i + 1));
+    return input(i);
+}
+
+static Z3_ast rand_cmp(Z3_ast a, Z3_ast b)
+{
+    switch (rand_below(6)) {
+        case 0:
+            return Z3_mk_eq(ctx, a, b);
+        case 1:
+            return Z3_mk_not(ctx, Z3_mk_eq(ctx, a, b));
+        case 2:
+            return Z3_mk_bvult(ctx, a, b);
+        case 3:
+            return Z3_mk_bvuge(ctx, a, b);
+        case 4:
+            return Z3_mk_bvslt(ctx, a, b);
+        default:
+            return Z3_mk_bvugt(ctx, a, b);
+    }
+}
+
+static Z3_ast rand_const(Z3_ast like)
+{
+    Z3_sort sort = Z3_get_sort(ctx, like);
+    return Z3_mk_unsigned_int(
+        ctx, rand_below(1U << Z3_get_bv_sort_size(ctx, sort)), sort);
+}
+
+// a range constraint of the path
+static Z3_ast rand_range(unsigned n_inputs)
+{
+    Z3_ast g = rand_group(n_inputs);
+    return rand_cmp(g, rand_const(g));
+}
+
+// a branch condition: a comparison of an arithmetic term of a group
+static Z3_ast rand_branch(unsigned n_inputs)
+{
+    Z3_ast g = rand_group(n_inputs);
+    switch (rand_below(4)) {
+        case 0:
+            g = Z3_mk_bvadd(ctx, g, rand_const(g));
+            break;
+        case 1:
+            g = Z3_mk_bvmul(ctx, g, rand_const(g));
+            break;
+        case 2:
+            g = Z3_mk_bvand(ctx, g, rand_const(g));
+            break;
+        default:
+            break;
+    }
+    return rand_cmp(g, rand_const(g));
+}
+
+// every UNSAT answer of z3fuzz_query_check is checked with z3. The queries are
+// on different paths, whose constraints are all notified to the same context:
+// a fact learned on one path must not refute the branch of another one
+static void test_unsat(char* seed)
+{
+    fuzzy_ctx_t* fctx     = z3fuzz_create(ctx, seed, TIMEOUT);
+    unsigned     n_inputs = 4, n_unsat = 0;
+    unsigned     i, j;
+
+    for (i = 0; i < 500; ++i) {
+        Z3_ast   path[3];
+        unsigned n_path = rand_below(4);
+        for (j = 0; j < n_path; ++j) {
+            path[j] = rand_range(n_inputs);
+            z3fuzz_notify_constraint(fctx, path[j]);
+        }
+        Z3_ast query  = n_path > 0 ? Z3_mk_and(ctx, n_path, path)
+                                   : Z3_mk_true(ctx);
+        Z3_ast branch = rand_branch(n_inputs);
+
+        unsigned char const* proof;
+        unsigned long        proof_size;
+        if (z3fuzz_query_check(fctx, query, branch, &proof, &proof_size) !=
+            Z3FUZZ_UNSAT)
+            continue;
+
+        n_unsat++;
+        Z3_solver solver = Z3_mk_solver(ctx);
+        Z3_solver_inc_ref(ctx, solver);
+        Z3_solver_assert(ctx, solver, query);
+        Z3_solver_assert(ctx, solver, branch);
+        if (Z3_solver_check(ctx, solver) != Z3_L_FALSE) {
+            // Z3_ast_to_string returns a buffer that the next call reuses
+            fprintf(stderr, "false UNSAT:\n%s\n",
+                    Z3_ast_to_string(ctx, query));
+            fprintf(stderr, "%s\n", Z3_ast_to_string(ctx, branch));
+            exit(1);
+        }
+        Z3_solver_dec_ref(ctx, solver);
+    }
+    CHECK(n_unsat > 0);
+
+    z3fuzz_free(fctx);
+    free(fctx);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s seed test_name\n", argv[0]);
+        return 1;
+    }
+
+    Z3_config cfg = Z3_mk_config();
+    ctx           = Z3_mk_context(cfg);
+    Z3_del_config(cfg);
+
+    if (strcmp(argv[2], "deferred") == 0)
+        test_deferred(argv[1]);
+    else if (strcmp(argv[2], "session") == 0)
+        test_session(argv[1]);
+    else if (strcmp(argv[2], "store") == 0)
+        test_store(argv[1]);
+    else if (strcmp(argv[2], "unsat") == 0)
+        test_unsat(argv[1]);
+    else {
+        fprintf(stderr, "unknown test %s\n", argv[2]);
+        return 1;
+    }
+
+    Z3_del_context(ctx);
+    return 0;
+}
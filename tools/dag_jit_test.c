@@ -0,0 +1,222 @@
+#include "dag-eval.h"
+#include "dag-jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// differential test of the native code emitted by dag_jit_compile: random
+// expressions over N_INPUTS bytes are evaluated on random inputs both by
+// dag_eval and by the compiled root. Exits with 1 on the first mismatch
+
+#define N_INPUTS 8
+#define N_EXPRS 2000
+#define N_EVALS 64
+
+static Z3_context ctx;
+static uint64_t   rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rand_u64()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static unsigned rand_below(unsigned n) { return rand_u64() % n; }
+
+static Z3_ast mk_input(unsigned i)
+{
+    return Z3_mk_const(ctx, Z3_mk_int_symbol(ctx, i), Z3_mk_bv_sort(ctx, 8));
+}
+
+static Z3_ast mk_const(unsigned size)
+{
+    uint64_t v = rand_u64();
+    switch (rand_below(4)) {
+        case 0:
+            v &= 0xff;
+            break;
+        case 1:
+            v = rand_below(3) - 1; // 0, 1, -1
+            break;
+        default:
+            break;
+    }
+    return Z3_mk_unsigned_int64(ctx, size < 64 ? v & ((1UL << size) - 1) : v,
+                                Z3_mk_bv_sort(ctx, size));
+}
+
+// resize e (of size from) to size to
+static Z3_ast fit(Z3_ast e, unsigned from, unsigned to)
+{
+    if (from == to)
+        return e;
+    if (from > to)
+        return Z3_mk_extract(ctx, to - 1, 0, e);
+    return rand_below(2) ? Z3_mk_zero_ext(ctx, to - from, e)
+                         : Z3_mk_sign_ext(ctx, to - from, e);
+}
+
+static Z3_ast mk_bool(unsigned depth);
+
+static Z3_ast mk_bv(unsigned depth, unsigned* size)
+{
+    static const unsigned sizes[] = {8, 16, 32, 64};
+    if (depth == 0 || rand_below(5) == 0) {
+        if (rand_below(3)) {
+            *size = 8;
+            return mk_input(rand_below(N_INPUTS));
+        }
+        *size = sizes[rand_below(4)];
+        return mk_const(*size);
+    }
+
+    unsigned s1, s2;
+    Z3_ast   a = mk_bv(depth - 1, &s1);
+    Z3_ast   b = mk_bv(depth - 1, &s2);
+    b          = fit(b, s2, s1);
+    *size      = s1;
+    switch (rand_below(16)) {
+        case 0:
+            return Z3_mk_bvadd(ctx, a, b);
+        case 1:
+            return Z3_mk_bvsub(ctx, a, b);
+        case 2:
+            return Z3_mk_bvmul(ctx, a, b);
+        case 3:
+            return Z3_mk_bvand(ctx, a, b);
+        case 4:
+            return Z3_mk_bvor(ctx, a, b);
+        case 5:
+            return Z3_mk_bvxor(ctx, a, b);
+        case 6:
+            return Z3_mk_bvnot(ctx, a);
+        case 7:
+            return Z3_mk_bvneg(ctx, a);
+        case 8:
+            return Z3_mk_bvshl(ctx, a, b);
+        case 9:
+            return Z3_mk_bvlshr(ctx, a, b);
+        case 10:
+            return Z3_mk_bvashr(ctx, a, b);
+        case 11:
+            return rand_below(2) ? Z3_mk_rotate_left(ctx, rand_below(s1), a)
+                                 : Z3_mk_rotate_right(ctx, rand_below(s1), a);
+        case 12: {
+            unsigned lo = rand_below(s1);
+            unsigned hi = lo + rand_below(s1 - lo);
+            *size       = hi - lo + 1;
+            return Z3_mk_extract(ctx, hi, lo, a);
+        }
+        case 13:
+            if (s1 * 2 <= 64) {
+                *size = s1 * 2;
+                return Z3_mk_concat(ctx, a, b);
+            }
+            return a;
+        case 14:
+            return fit(a, s1, *size = sizes[rand_below(4)]);
+        default:
+            return Z3_mk_ite(ctx, mk_bool(depth - 1), a, b);
+    }
+}
+
+static Z3_ast mk_bool(unsigned depth)
+{
+    unsigned s1, s2;
+    Z3_ast   a = mk_bv(depth, &s1);
+    Z3_ast   b = mk_bv(depth, &s2);
+    Z3_ast   args[2];
+    b = fit(b, s2, s1);
+    switch (rand_below(14)) {
+        case 0:
+            return Z3_mk_eq(ctx, a, b);
+        case 1:
+            return Z3_mk_bvult(ctx, a, b);
+        case 2:
+            return Z3_mk_bvule(ctx, a, b);
+        case 3:
+            return Z3_mk_bvugt(ctx, a, b);
+        case 4:
+            return Z3_mk_bvuge(ctx, a, b);
+        case 5:
+            return Z3_mk_bvslt(ctx, a, b);
+        case 6:
+            return Z3_mk_bvsle(ctx, a, b);
+        case 7:
+            return Z3_mk_bvsgt(ctx, a, b);
+        case 8:
+            return Z3_mk_bvsge(ctx, a, b);
+        case 9:
+            args[0] = a;
+            args[1] = b;
+            return Z3_mk_distinct(ctx, 2, args);
+        case 10:
+            return Z3_mk_not(ctx, Z3_mk_eq(ctx, a, b));
+        default:
+            if (depth == 0)
+                return Z3_mk_eq(ctx, a, b);
+            args[0] = mk_bool(depth - 1);
+            args[1] = mk_bool(depth - 1);
+            switch (rand_below(3)) {
+                case 0:
+                    return Z3_mk_and(ctx, 2, args);
+                case 1:
+                    return Z3_mk_or(ctx, 2, args);
+                default:
+                    return Z3_mk_xor(ctx, args[0], args[1]);
+            }
+    }
+}
+
+int main()
+{
+    Z3_config cfg = Z3_mk_config();
+    ctx           = Z3_mk_context(cfg);
+    Z3_del_config(cfg);
+
+    dag_program_t* p = dag_create(ctx, N_INPUTS);
+    uint64_t*      slots;
+    uint64_t       inputs[N_INPUTS];
+    unsigned long  n_compiled = 0, n_evals = 0;
+    unsigned       i, j, k;
+
+    for (i = 0; i < N_EXPRS; ++i) {
+        unsigned size;
+        Z3_ast   e    = i % 2 ? mk_bool(1 + rand_below(3))
+                              : mk_bv(1 + rand_below(4), &size);
+        int      root = dag_add_root(p, e);
+        if (root < 0)
+            continue;
+        dag_jit_fn_t fn = dag_jit_compile(p, root);
+        if (fn == NULL)
+            continue;
+        n_compiled++;
+
+        // the program may grow with every root, take the scratch area now
+        slots = p->values;
+        for (j = 0; j < N_EVALS; ++j) {
+            for (k = 0; k < N_INPUTS; ++k)
+                inputs[k] = rand_u64() & 0xff;
+            uint64_t expected = dag_eval(p, root, inputs, NULL);
+            uint64_t res      = fn(inputs, slots);
+            n_evals++;
+            if (res != expected) {
+                printf("MISMATCH: jit 0x%lx, eval 0x%lx\n%s\ninputs:",
+                       (unsigned long)res, (unsigned long)expected,
+                       Z3_ast_to_string(ctx, e));
+                for (k = 0; k < N_INPUTS; ++k)
+                    printf(" %02lx", (unsigned long)inputs[k]);
+                printf("\n");
+                return 1;
+            }
+        }
+        dag_jit_free(fn);
+    }
+
+    printf("compiled %lu/%u roots, %lu evaluations, no mismatch\n",
+           n_compiled, N_EXPRS, n_evals);
+    dag_free(p);
+    Z3_del_context(ctx);
+    return 0;
+}
@@ -2,10 +2,14 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <getopt.h>
 #include "pretty-print.h"
+#include "proof-archive.h"
 #include "z3-fuzzy.h"
 
 #define BOLD(s) "\033[1m\033[37m" s "\033[0m"
@@ -144,6 +148,13 @@ static uint64_t Z3_eval(Z3_context ctx, Z3_ast query, uint64_t* data,
     return res;
 }
 
+static inline const char* check_res_string(int res)
+{
+    if (res == Z3FUZZ_SAT)
+        return "SAT";
+    return res == Z3FUZZ_UNSAT ? "UNSAT" : "UNKNOWN";
+}
+
 static inline void print_status(unsigned long current_query,
                                 unsigned long num_queries)
 {
@@ -156,7 +167,7 @@ static inline void print_status(unsigned long current_query,
         1, 2,
         "o-------------------------------------------------------------o");
     pp_printf(2, 2, "| " BOLD("num eval:") "   %ld", fctx.stats.num_evaluate);
-    pp_print_string(3, 2, "| ");
+    pp_printf(3, 2, "| " BOLD("unsat:") "      %ld", fctx.stats.num_unsat);
     pp_printf(4, 2, "| " BOLD("its:") "        %ld", fctx.stats.input_to_state);
     pp_printf(5, 2, "| " BOLD("sm:") "         %ld", fctx.stats.simple_math);
     pp_printf(6, 2, "| " BOLD("rbf:") "        %ld",
@@ -174,14 +185,16 @@ static inline void print_status(unsigned long current_query,
                   fctx.stats.arith64_sum_LE + fctx.stats.arith64_sum_BE +
                   fctx.stats.arith64_sub_LE + fctx.stats.arith64_sub_BE);
     pp_printf(10, 2, "| " BOLD("multigoal:") "  %ld", fctx.stats.multigoal);
-    pp_print_string(11, 2, "| ");
+    pp_printf(11, 2, "| " BOLD("eq chain:") "   %ld",
+              fctx.stats.equality_chain);
     pp_printf(12, 2, "| " BOLD("# confl:") "          %ld",
               fctx.stats.num_conflicting);
     pp_printf(13, 2, "| " BOLD("confl cache size:") " %ld",
               m_stats.conflicting_ast_size);
     pp_printf(14, 2, "| " BOLD("num timeouts:") "     %ld",
               fctx.stats.num_timeouts);
-    pp_printf(15, 2, "| ");
+    pp_printf(15, 2, "| " BOLD("skipped eval:") "  %ld",
+              fctx.stats.num_invalid_eval);
     pp_printf(16, 2, "| " BOLD("avg eval time:") " %.03lf usec",
               fctx.stats.avg_time_for_eval);
 
@@ -211,6 +224,7 @@ static inline void print_status(unsigned long current_query,
               fctx.stats.conflicting_fallbacks_same_inputs,
               fctx.stats.conflicting_fallbacks_no_true);
     pp_print_string(10, 64, "|");
+    pp_printf(11, 30, BOLD("dictionary:") " %ld", fctx.stats.dictionary);
     pp_print_string(11, 64, "|");
     pp_printf(12, 30, BOLD("# univ def:") "          %ld",
               fctx.stats.num_univocally_defined);
@@ -221,33 +235,57 @@ static inline void print_status(unsigned long current_query,
     pp_printf(14, 30, BOLD("ast info cache hits:") " %ld",
               fctx.stats.ast_info_cache_hits);
     pp_print_string(14, 64, "|");
+    pp_printf(15, 30, BOLD("gd eval/sat:") " %.01lf",
+              fctx.stats.gradient_descend == 0
+                  ? 0.0
+                  : (double)fctx.stats.gd_evaluate /
+                        fctx.stats.gradient_descend);
     pp_print_string(15, 64, "|");
+    pp_printf(16, 30, BOLD("linear math:") " %ld", fctx.stats.linear_math);
     pp_print_string(16, 64, "|");
 
+    // evaluations / successes of each variant of the gd optimizer
+    pp_printf(17, 2, "| " BOLD("gd bisect:") "  %ld/%ld",
+              fctx.stats.gd_bisect_evaluate, fctx.stats.gd_bisect_sat);
+    pp_printf(17, 30, BOLD("gd momentum:") " %ld/%ld",
+              fctx.stats.gd_momentum_evaluate, fctx.stats.gd_momentum_sat);
+    pp_print_string(17, 64, "|");
+    pp_printf(18, 2, "| " BOLD("gd restart:") " %ld/%ld",
+              fctx.stats.gd_restart_evaluate, fctx.stats.gd_restart_sat);
+    pp_print_string(18, 64, "|");
+
     pp_print_string(
-        17, 2,
+        19, 2,
         "o-------------------------------------------------------------o");
 
     pp_set_col(0);
-    pp_set_line(18);
+    pp_set_line(20);
 }
 
 static char g_sat_queries_path[500] = {0};
 static char g_proof_path[500]       = {0};
 
-static int g_no_tui            = 0;
-static int g_dump_sat_queries  = 0;
-static int g_dump_proofs       = 0;
-static int g_check_consistency = 1;
+static int      g_no_tui            = 0;
+static int      g_dump_sat_queries  = 0;
+static int      g_dump_proofs       = 0;
+static int      g_archive_proofs    = 0;
+static int      g_check_consistency = 1;
+static unsigned g_jobs              = 0;
 
-static const char*   short_opt  = "hq:s:o:";
+static char*            g_output_dir       = NULL;
+static FILE*            g_sat_queries_file = NULL;
+static proof_archive_t* g_proof_archive    = NULL;
+
+static const char*   short_opt  = "hq:s:o:j:";
 static struct option long_opt[] = {
     {"help", no_argument, NULL, 'h'},
     {"query", required_argument, NULL, 'q'},
     {"seed", required_argument, NULL, 's'},
     {"out", required_argument, NULL, 'o'},
+    {"jobs", required_argument, NULL, 'j'},
     {"dsat", no_argument, &g_dump_sat_queries, 1},
     {"dproofs", no_argument, &g_dump_proofs, 1},
+    {"aproofs", no_argument, &g_archive_proofs, 1},
     {"notui", no_argument, &g_no_tui, 1},
     {NULL, 0, NULL, 0}};
 
@@ -259,14 +297,272 @@ static inline void usage(char* filename)
             "  -q, --query               SMT2 query filename (required)\n"
             "  -s, --seed                binary seed file (required)\n"
             "  -o, --out                 output directory\n"
+            "  -j, --jobs                notify the path constraints once,\n"
+            "                            solve up to N queries at a time in\n"
+            "                            workers forked after notifying them\n"
             "\n"
             "  --dsat                    dump sat queries\n"
             "  --dproofs                 dump sat proofs\n"
+            "  --aproofs                 append sat proofs to the archive\n"
+            "                            proofs.fpa (read it with\n"
+            "                            proof-archive-extract)\n"
             "  --notui                   no text UI\n"
             "\n",
             filename);
 }
 
+static void report_sat_query(Z3_context ctx, Z3_ast query, unsigned i,
+                             unsigned char const* proof,
+                             unsigned long        proof_size)
+{
+    int n;
+    if (g_dump_proofs) {
+        n = snprintf(g_proof_path, sizeof(g_proof_path), "%s/proof_%02u.bin",
+                     g_output_dir, i);
+        assert(n > 0 && n < sizeof(g_proof_path) && "unable to dump proof");
+
+        z3fuzz_dump_proof(&fctx, g_proof_path, proof, proof_size);
+    }
+
+    if (g_archive_proofs) {
+        if (g_jobs > 0) {
+            // the proof comes from a worker, diff it against the seed
+            proof_archive_add_proof(g_proof_archive, i, proof);
+        } else {
+            fuzzy_patch_t const* patches;
+            unsigned long        n_patches =
+                z3fuzz_get_proof_patch(&fctx, &patches);
+            proof_archive_add_patch(g_proof_archive, i, patches, n_patches);
+        }
+    }
+
+    if (g_dump_sat_queries) {
+        fprintf(g_sat_queries_file, "(assert\n%s\n)\n",
+                Z3_ast_to_string(ctx, query));
+    }
+
+    if (g_check_consistency) {
+        testcase_t*   curr_t    = &fctx.testcases.data[0];
+        uint64_t*     tmp_proof = malloc(sizeof(uint64_t) * proof_size);
+        unsigned long j;
+        for (j = 0; j < proof_size; ++j)
+            tmp_proof[j] = proof[j];
+        assert(Z3_eval(ctx, query, tmp_proof, curr_t->value_sizes,
+                       proof_size) &&
+               "Invalid solution!");
+        free(tmp_proof);
+    }
+}
+
+// ************* fork server *************
+typedef struct fs_query_t {
+    Z3_ast         query;
+    Z3_ast         query_no_branch;
+    Z3_ast         branch_condition;
+    Z3_ast*        assertions;
+    unsigned       n_assertions;
+    int            is_sat;
+    unsigned long  time_msec;
+    unsigned char* proof;
+    unsigned long  proof_size;
+} fs_query_t;
+
+typedef struct fs_result_t {
+    uint32_t idx;
+    int32_t  is_sat;
+    uint64_t time_msec;
+    uint64_t proof_size;
+} fs_result_t;
+
+static int fs_read(int fd, void* buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t r = read(fd, (char*)buf + done, size - done);
+        if (r <= 0)
+            return 0;
+        done += r;
+    }
+    return 1;
+}
+
+static int fs_write(int fd, const void* buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t r = write(fd, (const char*)buf + done, size - done);
+        if (r <= 0)
+            return 0;
+        done += r;
+    }
+    return 1;
+}
+
+// a worker solves a single query. It is forked once the parent has notified
+// the path constraints up to that query, so it reads their learned state
+// copy-on-write
+static void fs_worker(fs_query_t* q, uint32_t idx, int out_fd)
+{
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    struct timeval       stop, start;
+
+    gettimeofday(&start, NULL);
+    int is_sat = z3fuzz_query_check(&fctx, q->query_no_branch,
+                                    q->branch_condition, &proof, &proof_size);
+    gettimeofday(&stop, NULL);
+
+    fs_result_t res = {
+        .idx        = idx,
+        .is_sat     = is_sat,
+        .time_msec  = compute_time_msec(&start, &stop),
+        .proof_size = is_sat == Z3FUZZ_SAT ? proof_size : 0};
+    if (fs_write(out_fd, &res, sizeof(res)))
+        fs_write(out_fd, proof, res.proof_size);
+    _exit(0);
+}
+
+// collect the results of the workers that answered and free their slots.
+// Returns the number of freed slots
+static unsigned fs_wait_workers(fs_query_t* queries, struct pollfd* workers,
+                                pid_t* pids)
+{
+    unsigned w, freed = 0;
+    if (poll(workers, g_jobs, -1) <= 0) {
+        perror("poll");
+        exit(1);
+    }
+    for (w = 0; w < g_jobs; ++w) {
+        if (workers[w].fd < 0 || !workers[w].revents)
+            continue;
+
+        fs_result_t res;
+        if (!fs_read(workers[w].fd, &res, sizeof(res))) {
+            fprintf(stderr, "ERROR: worker %u died\n", w);
+            exit(1);
+        }
+        fs_query_t* q = &queries[res.idx];
+        q->is_sat     = res.is_sat;
+        q->time_msec += res.time_msec;
+        q->proof_size = res.proof_size;
+        if (res.proof_size > 0) {
+            q->proof = (unsigned char*)malloc(res.proof_size);
+            if (!fs_read(workers[w].fd, q->proof, res.proof_size)) {
+                fprintf(stderr, "ERROR: worker %u died\n", w);
+                exit(1);
+            }
+        }
+        close(workers[w].fd);
+        waitpid(pids[w], NULL, 0);
+        workers[w].fd = -1;
+        freed++;
+    }
+    return freed;
+}
+
+// the parent notifies the path constraints of each query once, in order, and
+// then forks a worker that solves the query on that state. Up to g_jobs
+// workers run at the same time. Returns the number of sat queries
+static unsigned long run_fork_server(Z3_context ctx, Z3_ast_vector queries,
+                                     Z3_ast* str_symbols,
+                                     unsigned long* elapsed_time)
+{
+    unsigned long num_queries = Z3_ast_vector_size(ctx, queries);
+    fs_query_t*   fs_queries =
+        (fs_query_t*)calloc(num_queries, sizeof(fs_query_t));
+    unsigned long i;
+    unsigned      j, w;
+
+    struct timeval stop, start, notify_start;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < num_queries; ++i) {
+        Z3_ast query = Z3_ast_vector_get(ctx, queries, i);
+        query = Z3_substitute(ctx, query, fctx.n_symbols, str_symbols,
+                              fctx.symbols);
+        Z3_ast*  assertions;
+        unsigned n_assertions;
+        divide_query_in_assertions(query, &assertions, &n_assertions);
+
+        fs_queries[i].query            = query;
+        fs_queries[i].branch_condition = find_branch_condition(query);
+        fs_queries[i].query_no_branch =
+            n_assertions > 0 ? Z3_mk_and(ctx, n_assertions, assertions)
+                             : Z3_mk_true(ctx);
+        fs_queries[i].assertions   = assertions;
+        fs_queries[i].n_assertions = n_assertions;
+    }
+
+    struct pollfd* workers =
+        (struct pollfd*)malloc(sizeof(struct pollfd) * g_jobs);
+    pid_t* pids = (pid_t*)malloc(sizeof(pid_t) * g_jobs);
+    for (w = 0; w < g_jobs; ++w) {
+        workers[w].fd     = -1;
+        workers[w].events = POLLIN;
+    }
+
+    unsigned busy = 0;
+    for (i = 0; i < num_queries; ++i) {
+        // the time of a query includes the notification of its constraints,
+        // as in the sequential mode
+        gettimeofday(&notify_start, NULL);
+        for (j = 0; j < fs_queries[i].n_assertions; ++j)
+            z3fuzz_notify_constraint(&fctx, fs_queries[i].assertions[j]);
+        gettimeofday(&stop, NULL);
+        fs_queries[i].time_msec = compute_time_msec(&notify_start, &stop);
+
+        while (busy == g_jobs)
+            busy -= fs_wait_workers(fs_queries, workers, pids);
+        for (w = 0; workers[w].fd >= 0; ++w)
+            ;
+
+        int res[2];
+        if (pipe(res) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+        z3fuzz_prepare_snapshot(&fctx);
+        fflush(NULL);
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pids[w] == 0) {
+            close(res[0]);
+            for (j = 0; j < g_jobs; ++j)
+                if (workers[j].fd >= 0)
+                    close(workers[j].fd);
+            fs_worker(&fs_queries[i], i, res[1]);
+        }
+        close(res[1]);
+        workers[w].fd = res[0];
+        busy++;
+    }
+    while (busy > 0)
+        busy -= fs_wait_workers(fs_queries, workers, pids);
+    gettimeofday(&stop, NULL);
+    *elapsed_time += compute_time_msec(&start, &stop);
+
+    unsigned long sat_queries = 0;
+    for (i = 0; i < num_queries; ++i) {
+        fs_query_t* q = &fs_queries[i];
+        if (q->is_sat == Z3FUZZ_SAT) {
+            sat_queries++;
+            report_sat_query(ctx, q->query, i, q->proof, q->proof_size);
+        }
+        fprintf(stdout, "%s, %.3lf\n", check_res_string(q->is_sat),
+                (double)q->time_msec / 1000);
+        free(q->proof);
+        free(q->assertions);
+    }
+
+    free(pids);
+    free(workers);
+    free(fs_queries);
+    return sat_queries;
+}
+// ***************************************
+
 int main(int argc, char* argv[])
 {
     char* query_filename = NULL;
@@ -293,6 +589,9 @@ int main(int argc, char* argv[])
             case 'o':
                 output_dir = optarg;
                 break;
+            case 'j':
+                g_jobs = atoi(optarg);
+                break;
             default:
                 usage(argv[0]);
         }
@@ -303,10 +602,11 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    if ((g_dump_sat_queries || g_dump_proofs) && output_dir == NULL) {
+    if ((g_dump_sat_queries || g_dump_proofs || g_archive_proofs) &&
+        output_dir == NULL) {
         fprintf(stderr,
-                "ERROR: if dsat or dproofs is set, an output directory must "
-                "be specified\n");
+                "ERROR: if dsat, dproofs or aproofs is set, an output "
+                "directory must be specified\n");
         exit(1);
     }
 
@@ -346,12 +646,34 @@ int main(int argc, char* argv[])
         str_symbols[i] = s_bv;
     }
 
-    FILE* sat_queries_file = NULL;
+    g_output_dir = output_dir;
     if (g_dump_sat_queries) {
-        sat_queries_file = fopen(g_sat_queries_path, "w");
-        setvbuf(sat_queries_file, NULL, _IONBF, 0);
+        g_sat_queries_file = fopen(g_sat_queries_path, "w");
+        setvbuf(g_sat_queries_file, NULL, _IONBF, 0);
     }
 
+    if (g_archive_proofs) {
+        testcase_t*    seed_t = &fctx.testcases.data[0];
+        unsigned char* seed   = (unsigned char*)malloc(seed_t->testcase_len);
+        for (i = 0; i < seed_t->testcase_len; ++i)
+            seed[i] = (unsigned char)seed_t->values[i];
+
+        n = snprintf(g_proof_path, sizeof(g_proof_path), "%s/proofs.fpa",
+                     output_dir);
+        assert(n > 0 && n < sizeof(g_proof_path) &&
+               "snprintf failed (aproofs)");
+        g_proof_archive =
+            proof_archive_create(g_proof_path, seed, seed_t->testcase_len);
+        if (g_proof_archive == NULL) {
+            fprintf(stderr, "ERROR: unable to create %s\n", g_proof_path);
+            exit(1);
+        }
+        free(seed);
+    }
+
+    if (g_jobs > 0)
+        g_no_tui = 1; // the stats live in the workers
+
     if (!g_no_tui) {
         pp_init();
     }
@@ -369,70 +691,52 @@ int main(int argc, char* argv[])
 
     unsigned long num_queries = 0, sat_queries = 0;
     num_queries = Z3_ast_vector_size(ctx, queries);
-    for (i = 0; i < num_queries; ++i) {
-        Z3_ast query = Z3_ast_vector_get(ctx, queries, i);
-        query        = Z3_substitute(ctx, query, fctx.n_symbols, str_symbols,
-                              fctx.symbols);
-        Z3_ast   branch_condition = find_branch_condition(query);
-        Z3_ast*  assertions;
-        unsigned n_assertions;
-
-        Z3_ast query_no_branch;
-        divide_query_in_assertions(query, &assertions, &n_assertions);
-        if (n_assertions > 0)
-            query_no_branch = Z3_mk_and(fctx.z3_ctx, n_assertions, assertions);
-        else
-            query_no_branch = Z3_mk_true(fctx.z3_ctx);
-
-        gettimeofday(&start, NULL);
-        int j;
-        for (j = 0; j < n_assertions; ++j) {
-            assert(assertions[j] != NULL && "null assertion!");
-            z3fuzz_notify_constraint(&fctx, assertions[j]);
-        }
-        int is_sat = z3fuzz_query_check_light(
-            &fctx, query_no_branch, branch_condition, &proof, &proof_size);
-        gettimeofday(&stop, NULL);
-        elapsed_time += compute_time_msec(&start, &stop);
-
-        if (is_sat) {
-            sat_queries += 1;
-            elapsed_time_fast_sat += compute_time_msec(&start, &stop);
-
-            if (g_dump_proofs) {
-                n = snprintf(g_proof_path, sizeof(g_proof_path),
-                             "%s/proof_%02u.bin", output_dir, i);
-                assert(n > 0 && n < sizeof(g_proof_path) &&
-                       "unable to dump proof");
+    if (g_jobs > 0) {
+        sat_queries =
+            run_fork_server(ctx, queries, str_symbols, &elapsed_time);
+    } else {
+        for (i = 0; i < num_queries; ++i) {
+            Z3_ast query = Z3_ast_vector_get(ctx, queries, i);
+            query        = Z3_substitute(ctx, query, fctx.n_symbols,
+                                  str_symbols, fctx.symbols);
+            Z3_ast   branch_condition = find_branch_condition(query);
+            Z3_ast*  assertions;
+            unsigned n_assertions;
+
+            Z3_ast query_no_branch;
+            divide_query_in_assertions(query, &assertions, &n_assertions);
+            if (n_assertions > 0)
+                query_no_branch =
+                    Z3_mk_and(fctx.z3_ctx, n_assertions, assertions);
+            else
+                query_no_branch = Z3_mk_true(fctx.z3_ctx);
 
-                z3fuzz_dump_proof(&fctx, g_proof_path, proof, proof_size);
+            gettimeofday(&start, NULL);
+            int j;
+            for (j = 0; j < n_assertions; ++j) {
+                assert(assertions[j] != NULL && "null assertion!");
+                z3fuzz_notify_constraint(&fctx, assertions[j]);
             }
-
-            if (g_dump_sat_queries) {
-                fprintf(sat_queries_file, "(assert\n%s\n)\n",
-                        Z3_ast_to_string(ctx, query));
+            int is_sat = z3fuzz_query_check(
+                &fctx, query_no_branch, branch_condition, &proof, &proof_size);
+            gettimeofday(&stop, NULL);
+            elapsed_time += compute_time_msec(&start, &stop);
+
+            if (is_sat == Z3FUZZ_SAT) {
+                sat_queries += 1;
+                elapsed_time_fast_sat += compute_time_msec(&start, &stop);
+                report_sat_query(ctx, query, i, proof, proof_size);
             }
-
-            if (g_check_consistency) {
-                testcase_t* curr_t    = &fctx.testcases.data[0];
-                uint64_t*   tmp_proof = malloc(sizeof(uint64_t) * proof_size);
-                for (j = 0; j < proof_size; ++j)
-                    tmp_proof[j] = proof[j];
-                assert(Z3_eval(ctx, query, tmp_proof, curr_t->value_sizes,
-                               proof_size) &&
-                       "Invalid solution!");
-                free(tmp_proof);
+            free(assertions);
+
+            if (!g_no_tui) {
+                print_status(i, num_queries);
+            } else {
+                unsigned long qtime = compute_time_msec(&start, &stop);
+                fprintf(stdout, "%s, %.3lf\n", check_res_string(is_sat),
+                        (double)qtime / 1000);
             }
         }
-        free(assertions);
-
-        if (!g_no_tui) {
-            print_status(i, num_queries);
-        } else {
-            unsigned long qtime = compute_time_msec(&start, &stop);
-            fprintf(stdout, "%s, %.3lf\n", is_sat ? "SAT" : "UNKNOWN",
-                    (double)qtime / 1000);
-        }
     }
 
     if (!g_no_tui) {
@@ -459,7 +763,11 @@ int main(int argc, char* argv[])
     Z3_del_context(ctx);
 
     if (g_dump_sat_queries) {
-        fclose(sat_queries_file);
+        fclose(g_sat_queries_file);
+    }
+    if (g_archive_proofs && proof_archive_close(g_proof_archive) != 0) {
+        fprintf(stderr, "ERROR: unable to write the proof archive\n");
+        return 1;
     }
     return 0;
 }
@@ -67,10 +67,10 @@ static inline void divide_query_in_assertions(Z3_ast query, Z3_ast** assertions,
 static inline void dump_flip_info()
 {
     fprintf(flip_info_file,
-            "%ld," // input to state
+            "%ld," // input to state (+ equality chains)
             "%ld," // extended input to state
             "%ld," // interval analysis (brute force + range brute force + range
-                   // brute force opt + simple math)
+                   // brute force opt + simple math + linear math)
             "%ld," // gradient descent
             "%ld," // flips
             "%ld," // arithms
@@ -79,9 +79,11 @@ static inline void dump_flip_info()
             "%ld," // multigoal
             "%ld" // sat in seed
             ,
-            fctx.stats.input_to_state, fctx.stats.input_to_state_ext,
+            fctx.stats.input_to_state + fctx.stats.equality_chain,
+            fctx.stats.input_to_state_ext,
             fctx.stats.brute_force + fctx.stats.range_brute_force +
-                fctx.stats.range_brute_force_opt + fctx.stats.simple_math,
+                fctx.stats.range_brute_force_opt + fctx.stats.simple_math +
+                fctx.stats.linear_math,
             fctx.stats.gradient_descend,
             fctx.stats.flip1 + fctx.stats.flip2 + fctx.stats.flip4 +
                 fctx.stats.flip8 + fctx.stats.flip16 + fctx.stats.flip32 +
@@ -110,6 +110,16 @@ print_stats_on_file(const char* query_name, unsigned long num_queries,
             fctx.stats.input_to_state_ext);
     fprintf(logfile, ";;;brute_force;%ld\n", fctx.stats.brute_force);
     fprintf(logfile, ";;;gradient_descend;%ld\n", fctx.stats.gradient_descend);
+    fprintf(logfile, ";;;gd_evaluate;%ld\n", fctx.stats.gd_evaluate);
+    fprintf(logfile, ";;;gd_bisect_evaluate;%ld\n",
+            fctx.stats.gd_bisect_evaluate);
+    fprintf(logfile, ";;;gd_bisect_sat;%ld\n", fctx.stats.gd_bisect_sat);
+    fprintf(logfile, ";;;gd_momentum_evaluate;%ld\n",
+            fctx.stats.gd_momentum_evaluate);
+    fprintf(logfile, ";;;gd_momentum_sat;%ld\n", fctx.stats.gd_momentum_sat);
+    fprintf(logfile, ";;;gd_restart_evaluate;%ld\n",
+            fctx.stats.gd_restart_evaluate);
+    fprintf(logfile, ";;;gd_restart_sat;%ld\n", fctx.stats.gd_restart_sat);
     fprintf(logfile, ";;;flip1;%ld\n", fctx.stats.flip1);
     fprintf(logfile, ";;;flip2;%ld\n", fctx.stats.flip2);
     fprintf(logfile, ";;;flip4;%ld\n", fctx.stats.flip4);
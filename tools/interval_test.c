@@ -29,4 +29,34 @@ int main()
     wi_update_cmp(&wi3, 0xbbbbbbbb, OP_ULT);
     wi_update_sub(&wi3, 0xaaaaaaaa);
     wi_print(&wi3);
+
+    // x != 0 && x != 10
+    wrapped_interval_set_t wis1 = wis_init(8);
+    wrapped_interval_t     ne   = wi_init(8);
+    wi_update_cmp(&ne, 0, OP_NE);
+    wis_intersect(&wis1, &ne);
+    ne = wi_init(8);
+    wi_update_cmp(&ne, 10, OP_NE);
+    wis_intersect(&wis1, &ne);
+    wis_print(&wis1);
+    printf("contains %d ? %d\n", 10, wis_contains_element(&wis1, 10));
+    printf("contains %d ? %d\n", 11, wis_contains_element(&wis1, 11));
+
+    // x < 5 || x > 200
+    wrapped_interval_t lt = wi_init(8);
+    wrapped_interval_t gt = wi_init(8);
+    wi_update_cmp(&lt, 5, OP_ULT);
+    wi_update_cmp(&gt, 200, OP_UGT);
+    wrapped_interval_set_t wis2    = wis_from_interval(&lt);
+    wrapped_interval_set_t wis2_gt = wis_from_interval(&gt);
+    wis_union(&wis2, &wis2_gt);
+    wis_intersect_set(&wis2, &wis1);
+    wis_print(&wis2);
+
+    unsigned long           n  = 0;
+    uint64_t                v;
+    wrapped_interval_iter_t it = wis_init_iter_values(&wis2);
+    while (wi_iter_get_next(&it, &v))
+        n++;
+    printf("range %lu, iterated %lu\n", wis_get_range(&wis2) + 1, n);
 }
\ No newline at end of file
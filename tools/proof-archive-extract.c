@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "proof-archive.h"
+
+static const char*   short_opt  = "hlq:o:";
+static struct option long_opt[] = {{"help", no_argument, NULL, 'h'},
+                                   {"list", no_argument, NULL, 'l'},
+                                   {"query", required_argument, NULL, 'q'},
+                                   {"out", required_argument, NULL, 'o'},
+                                   {NULL, 0, NULL, 0}};
+
+static inline void usage(char* filename)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS] archive\n"
+            "  -h, --help                print this help and exit\n"
+            "  -l, --list                list the queries in the archive\n"
+            "  -q, --query               extract the proof of a query\n"
+            "  -o, --out                 output file of the proof (default:\n"
+            "                            proof_<query>.bin)\n"
+            "\n",
+            filename);
+}
+
+static int dump_proof(const char* filename, unsigned char const* proof,
+                      unsigned long proof_size)
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL)
+        return 0;
+
+    size_t n = fwrite(proof, sizeof(char), proof_size, fp);
+    fclose(fp);
+    return n == proof_size;
+}
+
+int main(int argc, char* argv[])
+{
+    char*         out_filename = NULL;
+    int           list         = 0;
+    int           has_query    = 0;
+    unsigned long query        = 0;
+    int           opt;
+    int           option_index = 0;
+
+    while ((opt = getopt_long(argc, argv, short_opt, long_opt,
+                              &option_index)) != -1) {
+        switch (opt) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'l':
+                list = 1;
+                break;
+            case 'q':
+                query     = strtoul(optarg, NULL, 10);
+                has_query = 1;
+                break;
+            case 'o':
+                out_filename = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (optind != argc - 1 || (!list && !has_query)) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    proof_archive_reader_t r;
+    if (proof_archive_map(&r, argv[optind]) != 0) {
+        fprintf(stderr, "ERROR: %s is not a valid proof archive\n",
+                argv[optind]);
+        exit(1);
+    }
+
+    if (list) {
+        unsigned long i;
+        printf("seed size: %lu, proofs: %lu\n", (unsigned long)r.seed_len,
+               (unsigned long)r.n_entries);
+        for (i = 0; i < r.n_entries; ++i)
+            printf("%lu\n", (unsigned long)r.index[i].query);
+    }
+
+    int res = 0;
+    if (has_query) {
+        char           default_filename[128];
+        unsigned char* proof = (unsigned char*)malloc(r.seed_len + 1);
+        int            found = proof_archive_extract(&r, query, proof);
+        if (found == 0) {
+            fprintf(stderr, "ERROR: no proof for query %lu\n", query);
+            res = 1;
+        } else if (found < 0) {
+            fprintf(stderr, "ERROR: corrupted proof for query %lu\n", query);
+            res = 1;
+        } else {
+            if (out_filename == NULL) {
+                snprintf(default_filename, sizeof(default_filename),
+                         "proof_%02lu.bin", query);
+                out_filename = default_filename;
+            }
+            if (!dump_proof(out_filename, proof, r.seed_len)) {
+                fprintf(stderr, "ERROR: unable to write %s\n", out_filename);
+                res = 1;
+            }
+        }
+        free(proof);
+    }
+
+    proof_archive_unmap(&r);
+    return res;
+}
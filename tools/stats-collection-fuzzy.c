@@ -66,21 +66,29 @@ static inline void divide_query_in_assertions(Z3_ast query, Z3_ast** assertions,
 static inline void dump_flip_info()
 {
     fprintf(flip_info_file,
-            "%ld," // input to state
+            "%ld," // input to state (+ equality chains)
             "%ld," // extended input to state
             "%ld," // interval analysis (brute force + range brute force + range
-                   // brute force opt + simple math)
+                   // brute force opt + simple math + linear math)
             "%ld," // gradient descent
             "%ld," // flips
             "%ld," // arithms
             "%ld," // interesting
             "%ld," // havoc
             "%ld," // multigoal
-            "%ld"  // sat in seed
+            "%ld," // sat in seed
+            "%ld," // gd bisection evaluations
+            "%ld," // gd bisection sat
+            "%ld," // gd momentum evaluations
+            "%ld," // gd momentum sat
+            "%ld," // gd restart evaluations
+            "%ld"  // gd restart sat
             ,
-            fctx.stats.input_to_state, fctx.stats.input_to_state_ext,
+            fctx.stats.input_to_state + fctx.stats.equality_chain,
+            fctx.stats.input_to_state_ext,
             fctx.stats.brute_force + fctx.stats.range_brute_force +
-                fctx.stats.range_brute_force_opt + fctx.stats.simple_math,
+                fctx.stats.range_brute_force_opt + fctx.stats.simple_math +
+                fctx.stats.linear_math,
             fctx.stats.gradient_descend,
             fctx.stats.flip1 + fctx.stats.flip2 + fctx.stats.flip4 +
                 fctx.stats.flip8 + fctx.stats.flip16 + fctx.stats.flip32 +
@@ -94,7 +102,10 @@ static inline void dump_flip_info()
                 fctx.stats.arith64_sub_LE + fctx.stats.arith64_sub_BE,
             fctx.stats.int8 + fctx.stats.int16 + fctx.stats.int32 +
                 fctx.stats.int64,
-            fctx.stats.havoc, fctx.stats.multigoal, fctx.stats.sat_in_seed);
+            fctx.stats.havoc, fctx.stats.multigoal, fctx.stats.sat_in_seed,
+            fctx.stats.gd_bisect_evaluate, fctx.stats.gd_bisect_sat,
+            fctx.stats.gd_momentum_evaluate, fctx.stats.gd_momentum_sat,
+            fctx.stats.gd_restart_evaluate, fctx.stats.gd_restart_sat);
 }
 
 static inline void usage(char* filename)
@@ -199,7 +210,12 @@ int main(int argc, char* argv[])
 
     pp_printf(2, 1, "cumulative fuzzy  %.03lf msec", cumulative_fuzzy);
     pp_printf(3, 1, "sat fuzzy         %ld", fuzzy_sat);
-    pp_set_line(5);
+    pp_printf(4, 1, "gd eval/sat       bisect %ld/%ld, momentum %ld/%ld, "
+                    "restart %ld/%ld",
+              fctx.stats.gd_bisect_evaluate, fctx.stats.gd_bisect_sat,
+              fctx.stats.gd_momentum_evaluate, fctx.stats.gd_momentum_sat,
+              fctx.stats.gd_restart_evaluate, fctx.stats.gd_restart_sat);
+    pp_set_line(6);
     puts("");
 
     Z3_ast_vector_dec_ref(ctx, queries);